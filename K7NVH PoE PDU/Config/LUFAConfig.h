@@ -67,7 +67,9 @@
 
 		/* USB Device Mode Driver Related Tokens: */
 //		#define USE_RAM_DESCRIPTORS
-		#define USE_FLASH_DESCRIPTORS
+		// Descriptors are in FLASH, except the PDU name string which is built in RAM, so
+		// CALLBACK_USB_GetDescriptor reports the memory space of each.
+//		#define USE_FLASH_DESCRIPTORS
 //		#define USE_EEPROM_DESCRIPTORS
 //		#define NO_INTERNAL_SERIAL
 		#define FIXED_CONTROL_ENDPOINT_SIZE      8
@@ -35,6 +35,8 @@
  *  the device's capabilities and functions.
  */
 
+#include <util/atomic.h>
+
 #include "Descriptors.h"
 
 
@@ -100,7 +102,7 @@ const USB_Descriptor_Configuration_t PROGMEM ConfigurationDescriptor =
 			.SubClass               = CDC_CSCP_ACMSubclass,
 			.Protocol               = CDC_CSCP_ATCommandProtocol,
 
-			.InterfaceStrIndex      = NO_DESCRIPTOR
+			.InterfaceStrIndex      = STRING_ID_Name
 		},
 
 	.CDC_Functional_Header =
@@ -193,6 +195,34 @@ const USB_Descriptor_String_t PROGMEM ManufacturerString = USB_STRING_DESCRIPTOR
  */
 const USB_Descriptor_String_t PROGMEM ProductString = USB_STRING_DESCRIPTOR(L"PoE PDU V1.1");
 
+/** PDU name descriptor string. This is built in RAM from the user set PDU name, and given as the string for the CDC
+ *  control interface, so that hosts can tell PDUs apart (e.g. in udev rules) without opening them.
+ */
+static struct
+{
+	USB_Descriptor_Header_t Header;
+	uint16_t                UnicodeString[NAME_STRING_LEN];
+} NameString = {.Header = {.Size = USB_STRING_LEN(0), .Type = DTYPE_String}};
+
+/** Rebuilds the PDU name descriptor string. Hosts read the string at enumeration, so a new name is seen the next
+ *  time the PDU is connected.
+ */
+void USB_Set_Name_String(const char *name)
+{
+	uint8_t Length = 0;
+
+	// Control requests are serviced from the USB interrupt, so don't let one see a half written string
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		while (Length < NAME_STRING_LEN && name[Length])
+		{
+			NameString.UnicodeString[Length] = (uint8_t)name[Length];
+			Length++;
+		}
+		NameString.Header.Size = USB_STRING_LEN(Length);
+	}
+}
+
 /** This function is called by the library when in device mode, and must be overridden (see library "USB Descriptors"
  *  documentation) by the application code so that the address and size of a requested descriptor can be given
  *  to the USB library. When the device receives a Get Descriptor request on the control endpoint, this function
@@ -201,7 +231,8 @@ const USB_Descriptor_String_t PROGMEM ProductString = USB_STRING_DESCRIPTOR(L"Po
  */
 uint16_t CALLBACK_USB_GetDescriptor(const uint16_t wValue,
                                     const uint8_t wIndex,
-                                    const void** const DescriptorAddress)
+                                    const void** const DescriptorAddress,
+                                    uint8_t* const DescriptorMemorySpace)
 {
 	const uint8_t  DescriptorType   = (wValue >> 8);
 	const uint8_t  DescriptorNumber = (wValue & 0xFF);
@@ -209,6 +240,8 @@ uint16_t CALLBACK_USB_GetDescriptor(const uint16_t wValue,
 	const void* Address = NULL;
 	uint16_t    Size    = NO_DESCRIPTOR;
 
+	*DescriptorMemorySpace = MEMSPACE_FLASH;
+
 	switch (DescriptorType)
 	{
 		case DTYPE_Device:
@@ -234,6 +267,11 @@ uint16_t CALLBACK_USB_GetDescriptor(const uint16_t wValue,
 					Address = &ProductString;
 					Size    = pgm_read_byte(&ProductString.Header.Size);
 					break;
+				case STRING_ID_Name:
+					Address = &NameString;
+					Size    = NameString.Header.Size;
+					*DescriptorMemorySpace = MEMSPACE_RAM;
+					break;
 			}
 
 			break;
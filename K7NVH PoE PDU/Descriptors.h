@@ -98,13 +98,19 @@
 			STRING_ID_Language     = 0, /**< Supported Languages string descriptor ID (must be zero) */
 			STRING_ID_Manufacturer = 1, /**< Manufacturer string ID */
 			STRING_ID_Product      = 2, /**< Product string ID */
+			STRING_ID_Name         = 3, /**< PDU name string ID */
 		};
 
+		/** Longest PDU name, in characters, that the name string descriptor can hold. */
+		#define NAME_STRING_LEN 15
+
 	/* Function Prototypes: */
 		uint16_t CALLBACK_USB_GetDescriptor(const uint16_t wValue,
 		                                    const uint8_t wIndex,
-		                                    const void** const DescriptorAddress)
+		                                    const void** const DescriptorAddress,
+		                                    uint8_t* const DescriptorMemorySpace)
 		                                    ATTR_WARN_UNUSED_RESULT ATTR_NON_NULL_PTR_ARG(3);
+		void USB_Set_Name_String(const char *name);
 
 #endif
 
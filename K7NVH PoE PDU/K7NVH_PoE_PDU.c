@@ -9,16 +9,40 @@
 // Main Scheduling Interrupt
 ISR(TIMER1_COMPA_vect){
 	timer++;
+	CLOCK_MS += TICK_MS;
+	if (CLOCK_MS >= 1000) {
+		CLOCK_MS -= 1000;
+		CLOCK_SECONDS++;
+	}
 
-	if ((timer) % VCTL_DELAY == 0){ schedule_check_voltage = 1; }
-	if ((timer) % ICTL_DELAY == 0){ schedule_check_current = 1; }
+	for (uint8_t i = 0; i < TASK_CNT; i++) {
+		if (--TASK_WAIT[i] == 0) {
+			TASK_WAIT[i] = TASK_TICKS[i];
+#ifdef ENABLETASKS
+			// Still waiting from last time, so the main loop has fallen behind
+			if (TASK_DUE & (1 << i)) TASK_MISSED[i]++;
+#endif
+			TASK_DUE |= (1 << i);
+		}
+	}
 	if (cycle_ports > 0) {
 		cycle_timer--;
 		if (cycle_timer == 0) {
 			schedule_port_cycle = 1;
 		}
 	}
-	if ((timer) % IRST_DELAY == 0){ schedule_reset_current = 1; }
+	if (--TEMP_WAIT == 0) {
+		TEMP_WAIT = TEMP_SAMPLE_TICKS;
+		ADCSRA |= (1<<ADSC); // Start a temperature conversion
+	}
+}
+
+// Temperature conversion complete
+ISR(ADC_vect){
+	int16_t sample = ((int16_t)ADCW - 273) * 16;
+	
+	TEMP_FILTERED += (sample - TEMP_FILTERED) / TEMP_FILTER;
+	TEMP_NEW = 1;
 }
 
 #ifdef DEBUG
@@ -27,6 +51,21 @@ int freeMemory() {
 	char top;
 	return __brkval ? &top - __brkval : &top - __malloc_heap_start;
 }
+
+// Fill the free RAM above the heap with STACK_CANARY, so the stack's deepest reach can be
+// found later. Run with interrupts off, before anything else is on the stack.
+static inline void STACK_Paint(void) {
+	uint8_t *p = (uint8_t *)(__brkval ? __brkval : __malloc_heap_start);
+	while (p < (uint8_t *)SP) *p++ = STACK_CANARY;
+}
+
+// Count the painted bytes the stack has never grown down into
+static inline uint16_t STACK_Unused(void) {
+	uint8_t *p = (uint8_t *)(__brkval ? __brkval : __malloc_heap_start);
+	uint16_t unused = 0;
+	while (p < (uint8_t *)SP && *p++ == STACK_CANARY) unused++;
+	return unused;
+}
 #endif
 
 // Main program entry point.
@@ -38,27 +77,37 @@ int main(void) {
 
 	// Initialize some variables
 	int16_t BYTE_IN = -1;
+	int16_t BYTE_LAST = -1;
+	uint8_t command_done;
 	DATA_IN = malloc(DATA_BUFF_LEN);
 	DATA_IN_START = DATA_IN;
-	for(uint8_t i = 0; i < PORT_CNT; i++){
-		PORT_HIGH_WATER[i] = 0;
-	}
+#ifdef DEBUG
+	STACK_Paint();
+#endif
 	
 	Watchdog_Disable();
 	wdt_reset();
 	Watchdog_Enable();
 
-	// Set up timer 1 for 0.25s interrupts
+	// Set up timer 1 for 10ms interrupts
 	TCCR1A = 0b00000000; // No pin changes on compare match
 	TCCR1B = 0b00001010; // Clear timer on compare match, clock /8
 	TCCR1C = 0b00000000; // No forced output compare
-	OCR1A = 31250; // Set timer clear at this count value
+	OCR1A = TICK_COUNTS - 1; // Set timer clear at this count value (1249)
 	TCNT1 = 0;
 	TIMSK1 = 0b00000010; // Enable interrupts on the A compare match
 
 	// Divide 16MHz crystal down to 1MHz for CPU clock.
 	clock_prescale_set(clock_div_16);
 
+	// Cache the PDU name for the prompt and the USB name string, which the
+	// host may ask for as soon as we're on the bus
+	EEPROM_Read_Port_Name(-1, PDU_NAME);
+	USB_Set_Name_String(PDU_NAME);
+
+	// Load the task periods before the timer starts counting them down
+	TASK_Init();
+
 	// Init USB hardware and create a regular character stream for the
 	// USB interface so that it can be used with the stdio.h functions
 	USB_Init();
@@ -84,17 +133,31 @@ int main(void) {
 
 	// Enable the ADC
 	ADCSRA = (1<<ADEN) | (1<<ADPS2) | (1<<ADPS1) | (1<<ADPS0); // Enable ADC, clocked by /128 divider
+	ADC_Init_Temperature();
+	
+	// Turn off the peripherals we don't use
+	POWER_Init();
 
 	// Port control pins are currently inputs, set what we want them to be, then set them as outputs
 	// This avoids a blip turning ports off before re-enabling.
 	// Read in stored port on/off states, and turn them on/off to match
+	pd_set boot_on = 0;
 	for (uint8_t i = 0; i < PORT_CNT; i++) {
 		PORT_BOOT_STATE[i] = EEPROM_Read_Port_Boot_State(i);
-		if (PORT_BOOT_STATE[i] & 0b00000001) { PORT_CTL(i, 1); } else { PORT_CTL(i, 0); } // Enable port if set
+		if (PORT_BOOT_STATE[i] & 0b00000001) { boot_on |= (1 << i); } // Enable port if set
 		if (PORT_BOOT_STATE[i] & 0b00000010) { PORT_STATE[i] |= 0b00000100; } // Enable VCTL if set
 		if (PORT_BOOT_STATE[i] & 0b00000100) { PORT_STATE[i] |= 0b00010000; } // Port is on AUX bus (used for power calculations)
 		if (PORT_BOOT_STATE[i] & 0b00001000) { PORT_STATE[i] |= 0b00100000; } // Port is locked
 	}
+	PORT_Write_Set(~boot_on & ((1 << PORT_CNT) - 1), 0);
+	PORT_Write_Set(boot_on, 1);
+	VCTL_Load();
+#ifdef ENABLESCRIPT
+	if (EEPROM_Read_Script_Auto()) SCRIPT_Start();
+#endif
+#ifdef ENABLEPEAKS
+	if (EEPROM_Read_Peak_Save()) EEPROM_Read_Peaks();
+#endif
 	// Set up control pins
 	DDRD |= (1 << P1EN)|(1 << P2EN)|(1 << P3EN)|(1 << P4EN)|(1 << P5EN)|(1 << P6EN)|(1 << P7EN)|(1 << P8EN);
 	DDRB |= (1 << P9EN)|(1 << P10EN)|(1 << P11EN);
@@ -109,19 +172,30 @@ int main(void) {
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
 	for (;;) {
-		// Read a byte from the USB serial stream
-		BYTE_IN = CDC_Device_ReceiveByte(&VirtualSerial_CDC_Interface);
+		// Pull everything the host has sent so far into the receive buffer
+		INPUT_Receive();
+
+		// Work through buffered input until a complete command has been run. Pipelined
+		// commands then execute in order, with the control tasks below run between them.
+		command_done = 0;
+		while (RX_COUNT > 0 && !command_done) {
+			BYTE_IN = INPUT_Read();
+			
+			// A CR LF pair only ends one command
+			if (BYTE_IN == '\n' && BYTE_LAST == '\r') {
+				BYTE_LAST = BYTE_IN;
+				continue;
+			}
+			BYTE_LAST = BYTE_IN;
 
-		// USB Serial stream will return <0 if no bytes are available.
-		if (BYTE_IN >= 0) {
 			// We've gotten a char, so lets blink the status LED onboard. This LED will 
 			// remain lit while the board is processing commands. This is most evident 
 			// during a PCYCLE.
 			LED_CTL(0, 1);
 			
 			// Echo the char we just received back out the serial stream so the user's 
-			// console will display it.
-			fputc(BYTE_IN, &USBSerialStream);
+			// console will display it. Scripted clients in quiet mode don't want it.
+			if (!SESSION_QUIET) fputc(BYTE_IN, &USBSerialStream);
 
 			// Switch on the input byte to determine what is is and what to do.
 			switch (BYTE_IN) {
@@ -131,7 +205,7 @@ int main(void) {
 					if (DATA_IN_POS > 0){
 						DATA_IN_POS--;
 						DATA_IN[DATA_IN_POS] = 0;
-						printPGMStr(STR_Backspace);
+						if (!SESSION_QUIET) printPGMStr(STR_Backspace);
 					}
 					break;
 
@@ -147,6 +221,7 @@ int main(void) {
 #endif
 					INPUT_Parse();
 					INPUT_Clear();
+					command_done = 1;
 					break;
 
 				case 3:
@@ -157,6 +232,12 @@ int main(void) {
 				case 29:
 					// Ctrl-] reset all eeprom values
 					EEPROM_Reset();
+					VCTL_Load();
+#ifdef ENABLESCRIPT
+					SCRIPT_STATE = SCRIPT_STOPPED;
+#endif
+					EEPROM_Read_Port_Name(-1, PDU_NAME);
+					USB_Set_Name_String(PDU_NAME);
 					INPUT_Clear();
 					break;
 					
@@ -165,6 +246,10 @@ int main(void) {
 					// Timer interrupts will mess with the bootloader
 					TIMSK0 = 0b00000000;
 					TIMSK1 = 0b00000000;
+					ADCSRA &= ~(1<<ADIE);
+					// Hand over all of the peripherals
+					PRR0 = 0;
+					PRR1 = 0;
 					 
 					// Disable the watchdog timer
 					Watchdog_Disable();
@@ -190,46 +275,49 @@ int main(void) {
 		// Turn the status LED back off again
 		LED_CTL(0, 0);
 		
-		// Check for above threshold current usage
-		if (schedule_check_current) {
-			Check_Current_Limits();
-			schedule_check_current = 0;
-		}
-		
-		// Timer interval, check voltage control
-		if (schedule_check_voltage) {
-			Check_Voltage_Cutoff();
-			schedule_check_voltage = 0;
-		}
+		// Run any scheduled tasks that have come due
+		TASK_Yield();
 		
 		// Handle port cycles
 		if (schedule_port_cycle) {
-			PORT_Set_Ctl(&cycle_ports, 1);
+			pd_set cycled = 0;
+			for (uint8_t i = 0; i < PORT_CNT; i++) {
+				// Locked ports were never turned off, so leave them be, and ports latched off or
+				// shed while cycling stay off.
+				if ((cycle_ports & (1 << i)) && !(PORT_STATE[i] & 0b11100000)) {
+					cycled |= (1 << i);
+					EVENT_Queue(EVENT_CYCLE, i);
+				}
+			}
+			PORT_Write_Set(cycled, 1);
 			
-			cycle_ports = 0;
-			cycle_timer = 0;
+			ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+				cycle_ports = 0;
+				cycle_timer = 0;
+			}
 			schedule_port_cycle = 0;
-			
-			INPUT_Clear();
 		}
 		
-		// Reset overloaded ports
-		if (schedule_reset_current) {
-			schedule_reset_current = 0;
-			for (uint8_t i = 0; i < PORT_CNT; i++) {
-				// Port was overloaded, try re-enabling.
-				if ((PORT_STATE[i] & 0x02) > 0) {
-					PORT_CTL(i, 1);
-					PORT_STATE[i] &= 0b11111101;
-				}
-			}		
+		// Report any queued port events, but don't trample a partially typed command.
+		if (EVENT_COUNT > 0 && DATA_IN_POS == 0) {
+			EVENT_Flush();
+			// Scripted clients get a delimiter only in response to a command, but the
+			// last event line still needs ending so it can be read straight away
+			if (!SESSION_QUIET) INPUT_Clear();
+			else printPGMStr(PSTR("\r\n"));
 		}
 		
+		// Signal any new events to the host, if it's ready for it
+		EVENT_Notify();
+		
 		// Keep the LUFA USB stuff fed regularly.
 		run_lufa();
 		
 		// Reset the watchdog
 		wdt_reset();
+		
+		// Sleep until the next interrupt if there's nothing left to do
+		POWER_Idle();
 	}
 }
 
@@ -237,6 +325,31 @@ int main(void) {
 // ~~ Command Parsing Functions
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
+// Drain the CDC OUT endpoint into the receive buffer. Anything that doesn't fit is left
+// in the endpoint, which holds the host off until we catch up rather than dropping bytes.
+static inline void INPUT_Receive(void) {
+	uint16_t available = CDC_Device_BytesReceived(&VirtualSerial_CDC_Interface);
+	
+	while (available > 0 && RX_COUNT < RX_BUFF_LEN) {
+		int16_t byte = CDC_Device_ReceiveByte(&VirtualSerial_CDC_Interface);
+		if (byte < 0) break;
+		
+		RX_BUFF[(RX_HEAD + RX_COUNT) % RX_BUFF_LEN] = byte;
+		RX_COUNT++;
+		available--;
+	}
+}
+
+// Take the next byte out of the receive buffer. Check RX_COUNT first.
+static inline uint8_t INPUT_Read(void) {
+	uint8_t byte = RX_BUFF[RX_HEAD];
+	
+	RX_HEAD = (RX_HEAD + 1) % RX_BUFF_LEN;
+	RX_COUNT--;
+	
+	return byte;
+}
+
 // Flush out our data input buffer, reset our position variable, and print a new prompt.
 static inline void INPUT_Clear(void) {
 	// Reset the DATA_IN pointer to the start position, as we advance it during parsing
@@ -246,37 +359,48 @@ static inline void INPUT_Clear(void) {
 	// Reset our position counter to 0
 	DATA_IN_POS = 0;
 	
-	// Read PDU name
-	char temp_name[16];
-	EEPROM_Read_Port_Name(-1, temp_name);
+	// Scripted clients get a fixed delimiter instead of a prompt
+	if (SESSION_QUIET) {
+		printPGMStr(PSTR(QUIET_DELIM));
+		return;
+	}
 	
 #ifdef ENABLECOLORS
-	fprintf(&USBSerialStream, "\r\n\r\n#\x1b[32m%s \x1b[36m>\x1b[0m ", temp_name);
+	fprintf_P(&USBSerialStream, PSTR("\r\n\r\n#\x1b[32m%s \x1b[36m>\x1b[0m "), PDU_NAME);
 #else
-	fprintf(&USBSerialStream, "\r\n\r\n#%s > ", temp_name);
+	fprintf_P(&USBSerialStream, PSTR("\r\n\r\n#%s > "), PDU_NAME);
 #endif
 }
 
 // Parse command arguments and return pd_set bitmap with relevant port
-// bits set.
+// bits set. Arguments are port numbers, A for all ports, or group names.
 static inline void INPUT_Parse_args(pd_set *pd, char *str) {
 	*pd = 0;
-	uint8_t temp = 0;
 	
 	while (*str != 0 && str < (DATA_IN + DATA_BUFF_LEN)) {
-		if (*str == 'A' || *str == 'a') {
-			*pd = 0b1111111111111111;
-		} else if (*str >= '0' && *str <= '9') {
-			if (temp > 0) temp = temp * 10;
-			temp = temp + (*str - '0');
-		} else if (temp >= 1 && temp <= 12) {
-			*pd = *pd | (1 << (temp - 1));
-			temp = 0;
+		if (*str >= '0' && *str <= '9') {
+			uint8_t temp = 0;
+			while (*str >= '0' && *str <= '9') {
+				if (temp <= PORT_CNT) temp = temp * 10 + (*str - '0');
+				str++;
+			}
+			if (temp >= 1 && temp <= 12) {
+				*pd = *pd | (1 << (temp - 1));
+			}
+		} else if (INPUT_Name_Char(*str)) {
+			char *name = str;
+			while (INPUT_Name_Char(*str)) str++;
+			if (str - name == 1 && (*name == 'A' || *name == 'a')) {
+				*pd = 0b1111111111111111;
+#ifdef ENABLEGROUPS
+			} else {
+				int8_t group = INPUT_Find_Group(name, str - name);
+				if (group >= 0) *pd = *pd | EEPROM_Read_Group(group, NULL);
+#endif
+			}
+		} else {
+			str++;
 		}
-		str++;
-	}
-	if (temp >= 1 && temp <= 12) {
-		*pd = *pd | (1 << (temp - 1));
 	}
 }
 
@@ -301,6 +425,52 @@ static inline int8_t INPUT_Parse_port() {
 	return -1;
 }
 
+#if defined(ENABLESCHEDULE) || defined(ENABLERULES)
+// Parse out an ON, OFF or CYCLE argument. Returns ACTION_NONE if there isn't one.
+static inline uint8_t INPUT_Parse_action(void) {
+	while (*DATA_IN == ' ' || *DATA_IN == '\t') DATA_IN++;
+	for (uint8_t i = ACTION_OFF; i <= ACTION_CYCLE; i++) {
+		PGM_P name = (PGM_P)pgm_read_word(&STR_Actions[i]);
+		if (strncasecmp_P(DATA_IN, name, strlen_P(name)) == 0) {
+			DATA_IN += strlen_P(name);
+			return i;
+		}
+	}
+	
+	return ACTION_NONE;
+}
+#endif
+
+// Whether a character can be part of a group name
+static inline uint8_t INPUT_Name_Char(char c) {
+	return ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_');
+}
+
+#ifdef ENABLEGROUPS
+// Find a port group by name, ignoring case. Returns -1 if there isn't one.
+static inline int8_t INPUT_Find_Group(char *name, uint8_t len) {
+	char stored[GROUP_NAME_LEN + 1];
+	
+	if (len == 0 || len > GROUP_NAME_LEN) return -1;
+	for (uint8_t i = 0; i < GROUP_CNT; i++) {
+		EEPROM_Read_Group(i, stored);
+		if (stored[0] != 0 && stored[len] == 0 && strncasecmp(stored, name, len) == 0) return i;
+	}
+	
+	return -1;
+}
+#endif
+
+#ifdef ENABLESCRIPT
+// The value of a hex digit, or -1 if it isn't one
+static inline int8_t INPUT_Hex_Digit(char c) {
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	return -1;
+}
+#endif
+
 // We've gotten a new command, parse out what they want.
 static inline void INPUT_Parse(void) {
 	pd_set pd; // Port descriptor bitmap
@@ -320,6 +490,13 @@ static inline void INPUT_Parse(void) {
 		PRINT_Status_Prog();
 		return;
 	}
+#ifdef ENABLEJSON
+	// JSTATUS - Print a status summary as a JSON document
+	if (strncasecmp_P(DATA_IN, STR_Command_JSTATUS, 7) == 0) {
+		PRINT_Status_JSON();
+		return;
+	}
+#endif
 	// DEBUG - Print a report of debugging information, including EEPROM variables
 	if (strncasecmp_P(DATA_IN, STR_Command_DEBUG, 10) == 0) {
 		DEBUG_Dump();
@@ -349,8 +526,10 @@ static inline void INPUT_Parse(void) {
 			printPGMStr(STR_Unrecognized);
 		} else {
 			PORT_Set_Ctl(&pd, 0);
-			cycle_ports = pd;
-			cycle_timer = EEPROM_Read_PCycle_Time() * TICKS_PER_SECOND;
+			ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+				cycle_ports = pd;
+				cycle_timer = EEPROM_Read_PCycle_Time() * TICKS_PER_SECOND;
+			}
 		}
 		
 		return;
@@ -448,20 +627,64 @@ static inline void INPUT_Parse(void) {
 			portid = INPUT_Parse_port();
 			while (*DATA_IN == ' ' || *DATA_IN == '\t') DATA_IN++;
 			if (portid > 0 && portid <= PORT_CNT) {
-				uint16_t temp_set_voltage = atoi(DATA_IN);
-				if ((float)(temp_set_voltage/100) <= VMAX){
+				char *end;
+				uint32_t temp_set_voltage = strtoul(DATA_IN, &end, 10);
+				// Thresholds in percent are against the bus's battery state of charge
+				uint8_t soc = (*end == '%');
+				uint8_t soc_bit = setting ? 0b00100000 : 0b00010000;
+				uint8_t valid = soc ? (temp_set_voltage <= 100) : ((float)(temp_set_voltage/100) <= VMAX);
+#ifndef ENABLEBATTERY
+				// which is only estimated with the battery feature
+				if (soc) valid = 0;
+#endif
+				if (valid){
+					if (soc) {
+						temp_set_voltage *= 100;
+						PORT_BOOT_STATE[portid - 1] |= soc_bit;
+					} else {
+						PORT_BOOT_STATE[portid - 1] &= ~soc_bit;
+					}
+					EEPROM_Write_Port_Boot_State((portid - 1), PORT_BOOT_STATE[portid - 1]);
 					if (setting == 1) {
 						EEPROM_Write_Port_CutOn((portid - 1), temp_set_voltage);
 					} else {
 						EEPROM_Write_Port_CutOff((portid - 1), temp_set_voltage);
 					}
+					VCTL_Load();
 					printPGMStr(STR_Port_VCTL);
-					fprintf(&USBSerialStream, "%.2fV", (float)temp_set_voltage/100);
+					if (soc) {
+						fprintf_P(&USBSerialStream, PSTR("%lu%%"), temp_set_voltage / 100);
+					} else {
+						fprintf(&USBSerialStream, "%.2fV", (float)temp_set_voltage/100);
+					}
 					return;
 				}
 			}
 		}
 	}
+	// SETDEBOUNCE - Set the VCTL samples a port's bus must stay past each threshold before it is switched
+	if (strncasecmp_P(DATA_IN, STR_Command_SETDEBOUNCE, 11) == 0) {
+		DATA_IN += 11;
+		int8_t portid = INPUT_Parse_port();
+		
+		if (portid > 0 && portid <= PORT_CNT) {
+			char *start = DATA_IN;
+			char *end;
+			uint32_t off_count = strtoul(start, &end, 10);
+			uint8_t fields = (end != start);
+			uint32_t on_count = strtoul(start = end, &end, 10);
+			fields += (end != start);
+			
+			if (fields == 2 && off_count >= 1 && off_count <= VCTL_COUNT_MAX && on_count >= 1 && on_count <= VCTL_COUNT_MAX) {
+				EEPROM_Write_VCTL_Off_Count((portid - 1), off_count);
+				EEPROM_Write_VCTL_On_Count((portid - 1), on_count);
+				VCTL_Load();
+				printPGMStr(STR_Port_Debounce);
+				fprintf_P(&USBSerialStream, PSTR("%lu,%lu"), off_count, on_count);
+				return;
+			}
+		}
+	}
 	// SETNAME - Set the name for a given port.
 	if (strncasecmp_P(DATA_IN, STR_Command_SETNAME, 7) == 0) {
 		int8_t portid;
@@ -479,6 +702,8 @@ static inline void INPUT_Parse(void) {
 			return;
 		} else if (portid == 'P') {
 			EEPROM_Write_Port_Name(-1, DATA_IN);
+			EEPROM_Read_Port_Name(-1, PDU_NAME);
+			USB_Set_Name_String(PDU_NAME);
 			return;
 		}
 	}
@@ -500,6 +725,243 @@ static inline void INPUT_Parse(void) {
 			}
 		}
 	}
+#ifdef ENABLERETRY
+	// SETRETRY - Set the overload retry policy for a given port
+	if (strncasecmp_P(DATA_IN, STR_Command_SETRETRY, 8) == 0) {
+		DATA_IN += 8;
+		int8_t portid = INPUT_Parse_port();
+		
+		if (portid > 0 && portid <= PORT_CNT) {
+			// <delay> <attempts> <window>, all required
+			char *start = DATA_IN;
+			char *end;
+			uint32_t delay = strtoul(start, &end, 10);
+			uint8_t fields = (end != start);
+			uint32_t attempts = strtoul(start = end, &end, 10);
+			fields += (end != start);
+			uint32_t window = strtoul(start = end, &end, 10);
+			fields += (end != start);
+			
+			if (fields == 3 && delay >= 1 && delay <= RETRY_DELAY_MAX && attempts <= RETRY_ATTEMPTS_MAX && window <= RETRY_WINDOW_MAX) {
+				EEPROM_Write_Retry_Delay((portid - 1), delay);
+				EEPROM_Write_Retry_Attempts((portid - 1), attempts);
+				EEPROM_Write_Retry_Window((portid - 1), window);
+				printPGMStr(STR_Port_Retry);
+				fprintf_P(&USBSerialStream, PSTR("%lus,%lu,%lus"), delay, attempts, window);
+				return;
+			}
+		}
+	}
+#endif
+#ifdef ENABLEINRUSH
+	// SETINRUSH - Set a port's inrush window in ms, and the transient limit in mA that applies during it
+	if (strncasecmp_P(DATA_IN, STR_Command_SETINRUSH, 9) == 0) {
+		DATA_IN += 9;
+		int8_t portid = INPUT_Parse_port();
+		
+		if (portid > 0 && portid <= PORT_CNT) {
+			char *start = DATA_IN;
+			char *end;
+			uint32_t window = strtoul(start, &end, 10);
+			uint8_t fields = (end != start);
+			uint32_t limit = strtoul(start = end, &end, 10) / 100;
+			fields += (end != start);
+			
+			if (fields == 2 && window <= INRUSH_WINDOW_MAX && limit <= LIMIT_MAX) {
+				EEPROM_Write_Inrush_Window((portid - 1), window);
+				EEPROM_Write_Inrush_Limit((portid - 1), limit);
+				printPGMStr(STR_Port_Inrush);
+				fprintf_P(&USBSerialStream, PSTR("%lums,%.1fA"), window, (float)limit / 10);
+				return;
+			}
+		}
+	}
+	// INRUSH - Print the last inrush capture for each port
+	if (strncasecmp_P(DATA_IN, STR_Command_INRUSH, 6) == 0) {
+		PRINT_Inrush();
+		return;
+	}
+#endif
+#ifdef ENABLEBUDGET
+	// SETPRIORITY - Set a port's priority for load shedding, 1 (highest) to PRIORITY_MAX
+	if (strncasecmp_P(DATA_IN, STR_Command_SETPRIORITY, 11) == 0) {
+		DATA_IN += 11;
+		int8_t portid = INPUT_Parse_port();
+		
+		if (portid > 0 && portid <= PORT_CNT) {
+			uint8_t priority = atoi(DATA_IN);
+			if (priority >= 1 && priority <= PRIORITY_MAX) {
+				EEPROM_Write_Port_Priority((portid - 1), priority);
+				printPGMStr(STR_Port_Priority);
+				fprintf_P(&USBSerialStream, PSTR("%i"), priority);
+				return;
+			}
+		}
+	}
+	// SETBUDGET - Set the power budget for a bus in watts, 0 for none
+	if (strncasecmp_P(DATA_IN, STR_Command_SETBUDGET, 9) == 0) {
+		DATA_IN += 9;
+		while (*DATA_IN == ' ' || *DATA_IN == '\t') DATA_IN++;
+		uint8_t bus = 255;
+		if (strncasecmp_P(DATA_IN, STR_MAIN, 4) == 0) {
+			bus = 0;
+			DATA_IN += 4;
+		}
+		if (strncasecmp_P(DATA_IN, STR_ALT, 3) == 0) {
+			bus = 1;
+			DATA_IN += 3;
+		}
+		char *end;
+		uint32_t budget = strtoul(DATA_IN, &end, 10);
+		if (bus <= 1 && end != DATA_IN && budget <= BUDGET_MAX) {
+			EEPROM_Write_Bus_Budget(bus, budget);
+			printPGMStr(STR_Bus_Budget);
+			printPGMStr(bus ? STR_ALT : STR_MAIN);
+			fprintf_P(&USBSerialStream, PSTR(" %luW"), budget);
+			return;
+		}
+	}
+#endif
+#ifdef ENABLEBATTERY
+	// SETBATTERY - Set a bus's battery capacity in Ah, empty and full resting voltages, and resistance
+	if (strncasecmp_P(DATA_IN, STR_Command_SETBATTERY, 10) == 0) {
+		DATA_IN += 10;
+		while (*DATA_IN == ' ' || *DATA_IN == '\t') DATA_IN++;
+		uint8_t bus = 255;
+		if (strncasecmp_P(DATA_IN, STR_MAIN, 4) == 0) {
+			bus = 0;
+			DATA_IN += 4;
+		}
+		if (strncasecmp_P(DATA_IN, STR_ALT, 3) == 0) {
+			bus = 1;
+			DATA_IN += 3;
+		}
+		char *start = DATA_IN;
+		char *end;
+		uint32_t value[4];
+		uint8_t fields = 0;
+		for (uint8_t i = 0; i < 4; i++) {
+			value[i] = strtoul(start, &end, 10);
+			fields += (end != start);
+			start = end;
+		}
+		
+		if (bus <= 1 && fields == 4 && value[BATTERY_CAPACITY] <= BATTERY_CAPACITY_MAX && \
+			value[BATTERY_EMPTY] < value[BATTERY_FULL] && value[BATTERY_FULL] <= VMAX * 100 && \
+			value[BATTERY_RESISTANCE] <= BATTERY_RESISTANCE_MAX) {
+			for (uint8_t i = 0; i < 4; i++) EEPROM_Write_Battery(bus, i, value[i]);
+			// Start the estimate over from the bus voltage
+			BUS_SOC_VALID &= ~(1 << bus);
+			printPGMStr(STR_Bus_Battery);
+			printPGMStr(bus ? STR_ALT : STR_MAIN);
+			fprintf_P(&USBSerialStream, PSTR(" %luAh,%.2fV-%.2fV,%lumOhm"), value[BATTERY_CAPACITY], \
+				value[BATTERY_EMPTY] / 100.0, value[BATTERY_FULL] / 100.0, value[BATTERY_RESISTANCE]);
+			return;
+		}
+	}
+	// BATTERY - Print the state of charge estimate for each bus
+	if (strncasecmp_P(DATA_IN, STR_Command_BATTERY, 7) == 0) {
+		PRINT_Battery();
+		return;
+	}
+#endif
+#ifdef ENABLETRIGGERS
+	// SETTRIG - Set an EXT input trigger, as <EXT1|EXT2><<|>><level> <port> <ON|OFF> [samples], or NONE
+	if (strncasecmp_P(DATA_IN, STR_Command_SETTRIG, 7) == 0) {
+		DATA_IN += 7;
+		char *end;
+		uint32_t trigger = strtoul(DATA_IN, &end, 10);
+		DATA_IN = end;
+		while (*DATA_IN == ' ' || *DATA_IN == '\t') DATA_IN++;
+		
+		if (trigger >= 1 && trigger <= TRIGGER_CNT && strncasecmp_P(DATA_IN, PSTR("NONE"), 4) == 0) {
+			EEPROM_Write_Trigger((trigger - 1), TRIGGER_NONE, 0, 0, 0);
+			TRIGGER_FIRED &= ~(1 << (trigger - 1));
+			printPGMStr(STR_Trigger);
+			fprintf_P(&USBSerialStream, PSTR("%lu NONE"), trigger);
+			return;
+		}
+		
+		// Only step over each of EXT, 1|2 and <|> once it has matched, so a short command can't
+		// take DATA_IN past its end
+		uint8_t flags = 0;
+		uint8_t valid = (trigger >= 1 && trigger <= TRIGGER_CNT && strncasecmp_P(DATA_IN, STR_EXT, 3) == 0);
+		if (valid) {
+			DATA_IN += 3;
+			if (*DATA_IN == '2') flags |= TRIGGER_EXT2;
+			valid = (*DATA_IN == '1' || *DATA_IN == '2');
+		}
+		if (valid) {
+			DATA_IN++;
+			if (*DATA_IN == '>') flags |= TRIGGER_ABOVE;
+			valid = (*DATA_IN == '<' || *DATA_IN == '>');
+		}
+		if (!valid) {
+			printPGMStr(STR_Unrecognized);
+			return;
+		}
+		DATA_IN++;
+		
+		char *start = DATA_IN;
+		uint32_t level = strtoul(start, &end, 10);
+		valid = (end != start && level <= 0xFFFF);
+		DATA_IN = end;
+		int8_t portid = INPUT_Parse_port();
+		while (*DATA_IN == ' ' || *DATA_IN == '\t') DATA_IN++;
+		if (strncasecmp_P(DATA_IN, PSTR("ON"), 2) == 0) {
+			flags |= TRIGGER_ON;
+			DATA_IN += 2;
+		} else if (strncasecmp_P(DATA_IN, PSTR("OFF"), 3) == 0) {
+			DATA_IN += 3;
+		} else {
+			valid = 0;
+		}
+		uint32_t count = strtoul(start = DATA_IN, &end, 10);
+		if (end == start) count = VCTL_COUNT;
+		
+		if (valid && portid > 0 && portid <= PORT_CNT && count >= 1 && count <= VCTL_COUNT_MAX) {
+			EEPROM_Write_Trigger((trigger - 1), (portid - 1), flags, level, count);
+			TRIGGER_SAMPLES[trigger - 1] = 0;
+			TRIGGER_FIRED &= ~(1 << (trigger - 1));
+			printPGMStr(STR_Trigger);
+			fprintf_P(&USBSerialStream, PSTR("%lu EXT%c%c%.2fV PORT %i %s %lu"), trigger, (flags & TRIGGER_EXT2) ? '2' : '1', \
+				(flags & TRIGGER_ABOVE) ? '>' : '<', level / 100.0, portid, (flags & TRIGGER_ON) ? "ON" : "OFF", count);
+			return;
+		}
+		printPGMStr(STR_Unrecognized);
+		return;
+	}
+	// TRIGGERS - Print the EXT input triggers
+	if (strncasecmp_P(DATA_IN, STR_Command_TRIGGERS, 8) == 0) {
+		PRINT_Triggers();
+		return;
+	}
+#endif
+#ifdef ENABLETEMP
+	// SETTEMP - Set the temperatures in C to derate port limits, and to shed ports, 0 for never
+	if (strncasecmp_P(DATA_IN, STR_Command_SETTEMP, 7) == 0) {
+		DATA_IN += 7;
+		char *start = DATA_IN;
+		char *end;
+		uint32_t derate = strtoul(start, &end, 10);
+		uint8_t fields = (end != start);
+		uint32_t shed = strtoul(start = end, &end, 10);
+		fields += (end != start);
+		
+		if (fields == 2 && derate <= TEMP_MAX && shed <= TEMP_MAX) {
+			EEPROM_Write_Temp(0, derate);
+			EEPROM_Write_Temp(1, shed);
+			printPGMStr(STR_Temp);
+			fprintf_P(&USBSerialStream, PSTR("DERATE %luC, SHED %luC"), derate, shed);
+			return;
+		}
+	}
+	// TEMP - Print the temperature, thermal derating, and temperature history
+	if (strncasecmp_P(DATA_IN, STR_Command_TEMP, 4) == 0) {
+		PRINT_Temperature();
+		return;
+	}
+#endif
 	// SETVREF - Set the VREF voltage and store in EEPROM to correct voltage readings.
 	if (strncasecmp_P(DATA_IN, STR_Command_SETVREF, 7) == 0) {
 		DATA_IN += 7;
@@ -539,6 +1001,23 @@ static inline void INPUT_Parse(void) {
 			}
 		}
 	}
+	// SETEXTCAL - Set the divider ratio of an EXT input and store in EEPROM to correct its readings.
+	if (strncasecmp_P(DATA_IN, STR_Command_SETEXTCAL, 9) == 0) {
+		DATA_IN += 9;
+		char *start = DATA_IN;
+		char *end;
+		uint32_t ext = strtoul(start, &end, 10);
+		uint8_t fields = (end != start);
+		uint32_t temp_set_div = strtoul(start = end, &end, 10);
+		fields += (end != start);
+		
+		if (fields == 2 && ext >= 1 && ext <= 2 && temp_set_div >= EXTCAL_MIN && temp_set_div <= EXTCAL_MAX) {
+			EEPROM_Write_EXT_CAL((ext - 1), temp_set_div / 100.0);
+			printPGMStr(STR_EXTCAL);
+			fprintf_P(&USBSerialStream, PSTR("EXT%lu %.2f"), ext, temp_set_div / 100.0);
+			return;
+		}
+	}
 	// SETICAL - Set the current calibration for a given port and store in EEPROM to 
 	// correct current readings.
 	if (strncasecmp_P(DATA_IN, STR_Command_SETICAL, 7) == 0) {
@@ -642,60 +1121,395 @@ static inline void INPUT_Parse(void) {
 			return;
 		}
 	}
-	
-	// If none of the above commands were recognized, print a generic error.
-	printPGMStr(STR_Unrecognized);
-#ifdef DEBUG
-	fprintf(&USBSerialStream, "\r\nSTR: %s\t", DATA_IN);
-	fprintf(&USBSerialStream, "%i\r\n", DATA_IN_POS);
-#endif
-}
-
-// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-// ~~ Printing Functions
-// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-
-// Print a summary of all ports status'
-static inline void PRINT_Status(void) {
-	float main_voltage, alt_voltage, current, power;
-	
-	// Voltage
-	main_voltage = ADC_Read_Main_Voltage();
-	printPGMStr(PSTR("\r\nMain Voltage: "));
-	fprintf(&USBSerialStream, "%.2fV", main_voltage);
-	alt_voltage = ADC_Read_Alt_Voltage();
-	printPGMStr(PSTR("\r\nAlt Voltage: "));
-	fprintf(&USBSerialStream, "%.2fV", alt_voltage);
+	// TIME - Print the reported time and the time since boot
+	if (strncasecmp_P(DATA_IN, STR_Command_TIME, 4) == 0) {
+		printPGMStr(STR_Time);
+		CLOCK_Print_Time(NULL);
+		printPGMStr(STR_Uptime);
+		fprintf_P(&USBSerialStream, PSTR("%lu"), CLOCK_Millis());
+		return;
+	}
+	// SETTIME - Set the reported time, as <seconds>[.<ms>], e.g. Unix time
+	if (strncasecmp_P(DATA_IN, STR_Command_SETTIME, 7) == 0) {
+		DATA_IN += 7;
+		char *end;
+		uint32_t seconds = strtoul(DATA_IN, &end, 10);
+		uint16_t ms = 0;
+		if (end != DATA_IN) {
+			if (*end == '.') {
+				// Take up to three digits of fraction
+				end++;
+				for (uint8_t i = 0; i < 3; i++) {
+					ms = ms * 10;
+					if (*end >= '0' && *end <= '9') ms += *end++ - '0';
+				}
+			}
+			CLOCK_Set(seconds, ms);
+			printPGMStr(STR_Time);
+			CLOCK_Print_Time(NULL);
+			return;
+		}
+	}
+#ifdef ENABLESCHEDULE
+	// SETSCHED - Set a time of day port schedule entry, and store in EEPROM
+	if (strncasecmp_P(DATA_IN, STR_Command_SETSCHED, 8) == 0) {
+		DATA_IN += 8;
+		char *end;
+		uint32_t entry = strtoul(DATA_IN, &end, 10);
+		DATA_IN = end;
+		while (*DATA_IN == ' ' || *DATA_IN == '\t') DATA_IN++;
+		uint8_t valid = (entry >= 1 && entry <= SCHED_CNT);
 		
-	// Temperature
-	printPGMStr(PSTR("\tTemperature: "));
-	fprintf(&USBSerialStream, "%dC", ADC_Read_Temperature());
-	
-	float ext1_voltage = ADC_Read_EXT_Voltage(0);
-	float ext2_voltage = ADC_Read_EXT_Voltage(1);
-	printPGMStr(PSTR("\r\nEXT1: "));
-	fprintf(&USBSerialStream, "%.2fV", ext1_voltage);
-	printPGMStr(PSTR("\tEXT2: "));
-	fprintf(&USBSerialStream, "%.2fV", ext2_voltage);
-	
-	// Ports
-	for(uint8_t i = 0; i < PORT_CNT; i++) {
-		// PORT
-		printPGMStr(STR_NR_Port);
+		if (valid && strncasecmp_P(DATA_IN, PSTR("NONE"), 4) == 0) {
+			EEPROM_Write_Schedule((entry - 1), SCHED_NONE, 0, 0, 0);
+			printPGMStr(STR_Schedule);
+			PRINT_Schedule_Entry(entry - 1);
+			return;
+		}
 		
-		// Number and Name
-		char temp_name[16];
-		EEPROM_Read_Port_Name(i, temp_name);
-		fprintf(&USBSerialStream, "%i\t\"%s\":\t", i+1, temp_name);
+		// Days are * for every day, or a character a day from Sunday, - for off, e.g. -MTWTF-
+		uint8_t days = 0;
+		if (*DATA_IN == '*') {
+			days = SCHED_DAYS_ALL;
+			DATA_IN++;
+		} else {
+			for (uint8_t i = 0; i < 7; i++) {
+				if (*DATA_IN == 0 || *DATA_IN == ' ' || *DATA_IN == '\t') {
+					valid = 0;
+					break;
+				}
+				if (*DATA_IN++ != '-') days |= (1 << i);
+			}
+		}
 		
-		// Enabled/Disabled
-		if (PORT_STATE[i] & 0b00000001) { printPGMStr(STR_Enabled); } else { printPGMStr(STR_Disabled); }
+		// HH:MM, then the action and ports
+		char *start = DATA_IN;
+		uint32_t hours = strtoul(start, &end, 10);
+		uint32_t minutes = 60;
+		if (end != start && *end == ':') minutes = strtoul(start = end + 1, &end, 10);
+		if (end == start || hours > 23 || minutes > 59) valid = 0;
+		DATA_IN = end;
+		uint8_t action = INPUT_Parse_action();
+		INPUT_Parse_args(&pd, DATA_IN);
+		pd &= (1 << PORT_CNT) - 1;
 		
-		// Current reading
-		current = ADC_Read_Port_Current(i);
-		printPGMStr(PSTR("\t\tCurrent: "));
-		fprintf(&USBSerialStream, "%.2fA", current);
-		// Power reading
+		if (valid && days != 0 && action != ACTION_NONE && pd != 0) {
+			EEPROM_Write_Schedule((entry - 1), action, days, (hours * 60) + minutes, pd);
+			printPGMStr(STR_Schedule);
+			PRINT_Schedule_Entry(entry - 1);
+			return;
+		}
+	}
+	// SCHEDULE - Print the clock's day and time, and the port schedule
+	if (strncasecmp_P(DATA_IN, STR_Command_SCHEDULE, 8) == 0) {
+		PRINT_Schedule();
+		return;
+	}
+#endif
+#ifdef ENABLERULES
+	// SETRULE - Set a rule that acts on ports once a reading has been past a level for a time
+	if (strncasecmp_P(DATA_IN, STR_Command_SETRULE, 7) == 0) {
+		DATA_IN += 7;
+		char *end;
+		uint32_t rule = strtoul(DATA_IN, &end, 10);
+		DATA_IN = end;
+		while (*DATA_IN == ' ' || *DATA_IN == '\t') DATA_IN++;
+		uint8_t valid = (rule >= 1 && rule <= RULE_CNT);
+		
+		if (valid && strncasecmp_P(DATA_IN, PSTR("NONE"), 4) == 0) {
+			EEPROM_Write_Rule((rule - 1), RULE_NONE, 0, 0, 0, 0, 0);
+			RULE_HELD &= ~(1 << (rule - 1));
+			printPGMStr(STR_Rule);
+			PRINT_Rule(rule - 1);
+			return;
+		}
+		
+		// The reading is P<port> for a port's current, or MAIN, ALT, EXT1, EXT2 or TEMP
+		uint8_t reading = RULE_NONE;
+		uint32_t port = 1;
+		if ((*DATA_IN == 'P' || *DATA_IN == 'p') && DATA_IN[1] >= '0' && DATA_IN[1] <= '9') {
+			port = strtoul(DATA_IN + 1, &end, 10);
+			DATA_IN = end;
+			if (port >= 1 && port <= PORT_CNT) reading = READ_CURRENT;
+		} else {
+			for (uint8_t i = READ_MAIN; i <= READ_TEMP; i++) {
+				PGM_P name = (PGM_P)pgm_read_word(&STR_Readings[i]);
+				if (strncasecmp_P(DATA_IN, name, strlen_P(name)) == 0) {
+					reading = i;
+					DATA_IN += strlen_P(name);
+					break;
+				}
+			}
+		}
+		uint8_t flags = (reading == READ_CURRENT) ? (port - 1) : 0;
+		if (*DATA_IN == '>') flags |= RULE_ABOVE;
+		if (*DATA_IN == '<' || *DATA_IN == '>') {
+			DATA_IN++;
+		} else {
+			valid = 0;
+		}
+		
+		// <level> <seconds>, then the action and ports
+		char *start = DATA_IN;
+		int32_t level = strtol(start, &end, 10);
+		if (end == start || level < INT16_MIN || level > INT16_MAX) valid = 0;
+		uint32_t seconds = strtoul(start = end, &end, 10);
+		if (end == start || seconds > UINT16_MAX) valid = 0;
+		DATA_IN = end;
+		uint8_t action = INPUT_Parse_action();
+		INPUT_Parse_args(&pd, DATA_IN);
+		pd &= (1 << PORT_CNT) - 1;
+		
+		if (valid && reading != RULE_NONE && action != ACTION_NONE && pd != 0) {
+			EEPROM_Write_Rule((rule - 1), reading, flags, level, seconds, action, pd);
+			RULE_HELD &= ~(1 << (rule - 1));
+			printPGMStr(STR_Rule);
+			PRINT_Rule(rule - 1);
+			return;
+		}
+	}
+	// RULES - Print the rules
+	if (strncasecmp_P(DATA_IN, STR_Command_RULES, 5) == 0) {
+		for (uint8_t i = 0; i < RULE_CNT; i++) {
+			printPGMStr(PSTR("\r\n"));
+			PRINT_Rule(i);
+		}
+		return;
+	}
+#endif
+#ifdef ENABLESCRIPT
+	// SETSCRIPT - Write compiled script code to EEPROM, as <offset> <hex bytes>
+	if (strncasecmp_P(DATA_IN, STR_Command_SETSCRIPT, 9) == 0) {
+		DATA_IN += 9;
+		char *start = DATA_IN;
+		char *end;
+		uint32_t offset = strtoul(start, &end, 10);
+		uint8_t valid = (end != start);
+		DATA_IN = end;
+		while (*DATA_IN == ' ' || *DATA_IN == '\t') DATA_IN++;
+		
+		uint8_t code[DATA_BUFF_LEN / 2];
+		uint8_t len = 0;
+		while (len < sizeof(code) && INPUT_Hex_Digit(DATA_IN[0]) >= 0 && INPUT_Hex_Digit(DATA_IN[1]) >= 0) {
+			code[len++] = (INPUT_Hex_Digit(DATA_IN[0]) << 4) | INPUT_Hex_Digit(DATA_IN[1]);
+			DATA_IN += 2;
+		}
+		
+		if (valid && len > 0 && *DATA_IN == 0 && offset + len <= SCRIPT_LEN) {
+			// Don't run code that's half written
+			SCRIPT_STATE = SCRIPT_STOPPED;
+			EEPROM_Write_Script(offset, code, len);
+			printPGMStr(STR_Script);
+			fprintf_P(&USBSerialStream, PSTR("%u BYTES AT %lu"), len, offset);
+			return;
+		}
+	}
+	// SCRIPT - Run or stop the script, or set whether it runs at boot, then print its state
+	if (strncasecmp_P(DATA_IN, STR_Command_SCRIPT, 6) == 0) {
+		DATA_IN += 6;
+		while (*DATA_IN == ' ' || *DATA_IN == '\t') DATA_IN++;
+		uint8_t valid = 1;
+		
+		if (strncasecmp_P(DATA_IN, PSTR("RUN"), 3) == 0) {
+			SCRIPT_Start();
+		} else if (strncasecmp_P(DATA_IN, PSTR("STOP"), 4) == 0) {
+			SCRIPT_STATE = SCRIPT_STOPPED;
+		} else if (strncasecmp_P(DATA_IN, PSTR("BOOT ON"), 7) == 0) {
+			EEPROM_Write_Script_Auto(1);
+		} else if (strncasecmp_P(DATA_IN, PSTR("BOOT OFF"), 8) == 0) {
+			EEPROM_Write_Script_Auto(0);
+		} else if (*DATA_IN != 0) {
+			valid = 0;
+		}
+		
+		if (valid) {
+			PRINT_Script();
+			return;
+		}
+	}
+#endif
+#ifdef ENABLEGROUPS
+	// SETGROUP - Name a group of ports, to use in place of a list of ports
+	if (strncasecmp_P(DATA_IN, STR_Command_SETGROUP, 8) == 0) {
+		DATA_IN += 8;
+		while (*DATA_IN == ' ' || *DATA_IN == '\t') DATA_IN++;
+		char *name = DATA_IN;
+		while (INPUT_Name_Char(*DATA_IN)) DATA_IN++;
+		uint8_t len = DATA_IN - name;
+		int8_t group = INPUT_Find_Group(name, len);
+		while (*DATA_IN == ' ' || *DATA_IN == '\t') DATA_IN++;
+		
+		// Names start with a letter, and A already means all ports
+		uint8_t valid = (len >= 1 && len <= GROUP_NAME_LEN && !(*name >= '0' && *name <= '9') && *name != '_');
+		if (len == 1 && (*name == 'A' || *name == 'a')) valid = 0;
+		
+		if (group >= 0 && strncasecmp_P(DATA_IN, PSTR("NONE"), 4) == 0) {
+			EEPROM_Write_Group(group, name, 0, 0);
+			printPGMStr(STR_Group);
+			PRINT_Group(group);
+			return;
+		}
+		
+		// Replace a group of the same name, or take the first free one
+		for (uint8_t i = 0; i < GROUP_CNT && group < 0; i++) {
+			char stored[GROUP_NAME_LEN + 1];
+			EEPROM_Read_Group(i, stored);
+			if (stored[0] == 0) group = i;
+		}
+		INPUT_Parse_args(&pd, DATA_IN);
+		pd &= (1 << PORT_CNT) - 1;
+		
+		if (valid && group >= 0 && pd != 0) {
+			EEPROM_Write_Group(group, name, len, pd);
+			printPGMStr(STR_Group);
+			PRINT_Group(group);
+			return;
+		}
+	}
+	// GROUPS - Print the port groups
+	if (strncasecmp_P(DATA_IN, STR_Command_GROUPS, 6) == 0) {
+		for (uint8_t i = 0; i < GROUP_CNT; i++) {
+			printPGMStr(PSTR("\r\n"));
+			PRINT_Group(i);
+		}
+		return;
+	}
+#endif
+#ifdef ENABLEPEAKS
+	// PEAKS - Print the peak currents, clear them, or set whether they're saved to EEPROM
+	if (strncasecmp_P(DATA_IN, STR_Command_PEAKS, 5) == 0) {
+		DATA_IN += 5;
+		while (*DATA_IN == ' ' || *DATA_IN == '\t') DATA_IN++;
+		uint8_t valid = 1;
+		
+		if (strncasecmp_P(DATA_IN, PSTR("CLEAR"), 5) == 0) {
+			PORT_Clear_Peaks();
+		} else if (strncasecmp_P(DATA_IN, PSTR("SAVE ON"), 7) == 0) {
+			EEPROM_Write_Peak_Save(1);
+			EEPROM_Write_Peaks();
+		} else if (strncasecmp_P(DATA_IN, PSTR("SAVE OFF"), 8) == 0) {
+			EEPROM_Write_Peak_Save(0);
+		} else if (*DATA_IN != 0) {
+			valid = 0;
+		}
+		
+		if (valid) {
+			PRINT_Peaks();
+			return;
+		}
+	}
+#endif
+#ifdef ENABLEFAULT
+	// FAULT - Print the samples captured around an overload trip, or clear them to capture the next
+	if (strncasecmp_P(DATA_IN, STR_Command_FAULT, 5) == 0) {
+		DATA_IN += 5;
+		while (*DATA_IN == ' ' || *DATA_IN == '\t') DATA_IN++;
+		
+		if (strncasecmp_P(DATA_IN, PSTR("CLEAR"), 5) == 0) {
+			FAULT_POST_LEFT = 0;
+			FAULT_PORT = FAULT_NONE;
+			PRINT_Fault();
+			return;
+		}
+		if (*DATA_IN == 0) {
+			PRINT_Fault();
+			return;
+		}
+	}
+#endif
+#ifdef ENABLETASKS
+	// TASKS - Print task scheduling statistics
+	if (strncasecmp_P(DATA_IN, STR_Command_TASKS, 5) == 0) {
+		PRINT_Tasks();
+		return;
+	}
+	// SETPERIOD - Set how often a task runs, in ms, and store in EEPROM
+	if (strncasecmp_P(DATA_IN, STR_Command_SETPERIOD, 9) == 0) {
+		DATA_IN += 9;
+		while (*DATA_IN == ' ' || *DATA_IN == '\t') DATA_IN++;
+		for (uint8_t i = 0; i < TASK_STORED_CNT; i++) {
+			if (strncasecmp_P(DATA_IN, (PGM_P)pgm_read_word(&STR_Tasks[i]), 4) == 0) {
+				char *end;
+				uint32_t period = strtoul(DATA_IN + 4, &end, 10);
+				if (end == DATA_IN + 4 || period < TICK_MS || period > TASK_PERIOD_MAX) break;
+				
+				EEPROM_Write_Task_Period(i, period);
+				TASK_Set_Period(i, period);
+				printPGMStr(STR_Period);
+				printPGMStr((PGM_P)pgm_read_word(&STR_Tasks[i]));
+				fprintf_P(&USBSerialStream, PSTR(": %lums"), TASK_TICKS[i] * TICK_MS);
+				return;
+			}
+		}
+	}
+#endif
+	// QUIET - Enable/Disable quiet mode for scripted clients
+	if (strncasecmp_P(DATA_IN, STR_Command_QUIET, 5) == 0) {
+		DATA_IN += 5;
+		while (*DATA_IN == ' ' || *DATA_IN == '\t') DATA_IN++;
+		if (strncasecmp_P(DATA_IN, PSTR("ON"), 2) == 0) {
+			SESSION_QUIET = 1;
+			return;
+		}
+		if (strncasecmp_P(DATA_IN, PSTR("OFF"), 3) == 0) {
+			SESSION_QUIET = 0;
+			return;
+		}
+	}
+	
+	// If none of the above commands were recognized, print a generic error.
+	printPGMStr(STR_Unrecognized);
+#ifdef DEBUG
+	fprintf(&USBSerialStream, "\r\nSTR: %s\t", DATA_IN);
+	fprintf(&USBSerialStream, "%i\r\n", DATA_IN_POS);
+#endif
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~ Printing Functions
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// Print a summary of all ports status'
+static inline void PRINT_Status(void) {
+	float main_voltage, alt_voltage, current, power;
+	
+	// Voltage
+	main_voltage = ADC_Read_Main_Voltage();
+	printPGMStr(PSTR("\r\nMain Voltage: "));
+	fprintf(&USBSerialStream, "%.2fV", main_voltage);
+	alt_voltage = ADC_Read_Alt_Voltage();
+	printPGMStr(PSTR("\r\nAlt Voltage: "));
+	fprintf(&USBSerialStream, "%.2fV", alt_voltage);
+		
+	// Temperature
+	printPGMStr(PSTR("\tTemperature: "));
+	fprintf(&USBSerialStream, "%dC", ADC_Read_Temperature());
+	
+	float ext1_voltage = ADC_Read_EXT_Voltage(0);
+	float ext2_voltage = ADC_Read_EXT_Voltage(1);
+	printPGMStr(PSTR("\r\nEXT1: "));
+	fprintf(&USBSerialStream, "%.2fV", ext1_voltage);
+	printPGMStr(PSTR("\tEXT2: "));
+	fprintf(&USBSerialStream, "%.2fV", ext2_voltage);
+	
+	// Ports
+	for(uint8_t i = 0; i < PORT_CNT; i++) {
+		// PORT
+		printPGMStr(STR_NR_Port);
+		
+		// Number and Name
+		char temp_name[16];
+		EEPROM_Read_Port_Name(i, temp_name);
+		fprintf(&USBSerialStream, "%i\t\"%s\":\t", i+1, temp_name);
+		
+		// Enabled/Disabled
+		if (PORT_STATE[i] & 0b00000001) { printPGMStr(STR_Enabled); } else { printPGMStr(STR_Disabled); }
+		
+		// Current reading
+		current = ADC_Read_Port_Current(i);
+		printPGMStr(PSTR("\t\tCurrent: "));
+		fprintf(&USBSerialStream, "%.2fA", current);
+		// Power reading
 		printPGMStr(PSTR("\tPower: "));
 		if (PORT_STATE[i] & 0b00010000) {
 			power = alt_voltage * current;
@@ -712,12 +1526,16 @@ static inline void PRINT_Status(void) {
 		
 		// Overload?
 		if (PORT_STATE[i] & 0b00000010) { printPGMStr(STR_Overload); }
+		if (PORT_STATE[i] & 0b01000000) { printPGMStr(STR_Lockout); }
+		if (PORT_STATE[i] & 0b10000000) { printPGMStr(STR_Shed); }
 		
 		// Voltage Control?
 		if (PORT_STATE[i] & 0b00000100) { printPGMStr(STR_VCTL); }
 		
 		// Locked?
 		if (PORT_STATE[i] & 0b00100000) { printPGMStr(STR_Locked); }
+		
+		TASK_Yield();
 	}
 }
 
@@ -731,12 +1549,12 @@ static inline void PRINT_Status_Prog(void){
 	float power;
 	
 	// Device Description,Software version,Unit Name
-	EEPROM_Read_Port_Name(-1, temp_name); //PDU Name
 	printPGMStr(PSTR(SOFTWARE_STR));
-	fprintf(&USBSerialStream, ",%s,%s", SOFTWARE_VERS, temp_name);
+	fprintf_P(&USBSerialStream, PSTR(",%s,%s"), SOFTWARE_VERS, PDU_NAME);
 	
 	// Input Voltage,Temperature
-	fprintf(&USBSerialStream, "\r\n%.2f,%.2f,%d,%.2f,%.2f", main_voltage, alt_voltage, ADC_Read_Temperature(), ext1_voltage, ext2_voltage);
+	fprintf_P(&USBSerialStream, PSTR("\r\n%.2f,%.2f,%d,%.2f,%.2f,"), main_voltage, alt_voltage, ADC_Read_Temperature(), ext1_voltage, ext2_voltage);
+	CLOCK_Print_Time(NULL);
 	
 	// Port Number,Port Name,Enabled?,Current,Power,Overload,AltBus?
 	for (uint8_t i = 0; i < PORT_CNT; i++) {
@@ -757,201 +1575,1458 @@ static inline void PRINT_Status_Prog(void){
 		
 		fprintf(&USBSerialStream, "\r\n%i,%s,%i,%.2f,%.1f,%i,%i,%i,%i", i+1, temp_name, port_state, \
 			current, power, port_overload, port_vctl, port_altbus, port_locked);
+		
+		TASK_Yield();
 	}
 }
 
-// Print a quick help command
-static inline void PRINT_Help(void) {
-	printPGMStr(STR_Help_Info);
+#ifdef ENABLEJSON
+// Print status as a single JSON document, for HTTP/JSON based monitoring via a host bridge
+static inline void PRINT_Status_JSON(void){
+	char temp_name[16];
+	float main_voltage = ADC_Read_Main_Voltage();
+	float alt_voltage = ADC_Read_Alt_Voltage();
+	float power;
+	
+	printPGMStr(PSTR("\r\n{\"name\":"));
+	PRINT_JSON_Str(PDU_NAME);
+	fprintf_P(&USBSerialStream, PSTR(",\"version\":\"%s\",\"time\":"), SOFTWARE_VERS);
+	CLOCK_Print_Time(NULL);
+	fprintf_P(&USBSerialStream, PSTR(",\"main\":%.2f,\"alt\":%.2f,\"temp\":%d,\"ext1\":%.2f,\"ext2\":%.2f"), \
+		main_voltage, alt_voltage, ADC_Read_Temperature(), ADC_Read_EXT_Voltage(0), ADC_Read_EXT_Voltage(1));
+	for (uint8_t bus = 0; bus <= 1; bus++) {
+		printPGMStr(bus ? PSTR(",\"alt_soc\":") : PSTR(",\"main_soc\":"));
+#ifdef ENABLEBATTERY
+		if (BUS_SOC_VALID & (1 << bus)) {
+			fprintf_P(&USBSerialStream, PSTR("%.1f"), BUS_SOC[bus]);
+			continue;
+		}
+#endif
+		printPGMStr(PSTR("null"));
+	}
+	printPGMStr(PSTR(",\"temp_history\":["));
+#ifdef ENABLETEMP
+	for (uint8_t i = 0; i < TEMP_HISTORY_COUNT; i++) {
+		uint8_t entry = (TEMP_HISTORY_HEAD + TEMP_HISTORY_LEN - TEMP_HISTORY_COUNT + i) % TEMP_HISTORY_LEN;
+		fprintf_P(&USBSerialStream, PSTR("%s%d"), (i ? "," : ""), TEMP_HISTORY[entry]);
+	}
+#endif
+	printPGMStr(PSTR("],\"ports\":["));
+	
+	for (uint8_t i = 0; i < PORT_CNT; i++) {
+		EEPROM_Read_Port_Name(i, temp_name);
+		
+		float current = ADC_Read_Port_Current(i);
+		if (PORT_STATE[i] & 0b00010000) {
+			power = alt_voltage * current;
+		} else {
+			power = main_voltage * current;
+		}
+		
+		fprintf_P(&USBSerialStream, PSTR("%s{\"port\":%i,\"name\":"), (i ? "," : ""), i+1);
+		PRINT_JSON_Str(temp_name);
+		fprintf_P(&USBSerialStream, PSTR(",\"enabled\":%i,\"current\":%.2f,\"power\":%.1f,\"overload\":%i,\"vctl\":%i,\"altbus\":%i,\"locked\":%i,\"latched\":%i,\"shed\":%i}"), \
+			(PORT_STATE[i] & 0b00000001), current, power, (PORT_STATE[i] & 0b00000010) >> 1, \
+			(PORT_STATE[i] & 0b00000100) >> 2, (PORT_STATE[i] & 0b00010000) >> 4, (PORT_STATE[i] & 0b00100000) >> 5, \
+			(PORT_STATE[i] & 0b01000000) >> 6, (PORT_STATE[i] & 0b10000000) >> 7);
+		
+		TASK_Yield();
+	}
+	printPGMStr(PSTR("]}"));
 }
+#endif
 
-// Print a PGM stored string
-static inline void printPGMStr(PGM_P s) {
-	char c;
-	while((c = pgm_read_byte(s++)) != 0) fputc(c, &USBSerialStream);
+#ifdef ENABLETASKS
+// Print the scheduled tasks, one per line, as
+// name,period ms,runs,average us,max us,budget us,overruns,missed periods
+static inline void PRINT_Tasks(void) {
+	for (uint8_t i = 0; i < TASK_CNT; i++) {
+		printPGMStr(PSTR("\r\n"));
+		printPGMStr((PGM_P)pgm_read_word(&STR_Tasks[i]));
+		fprintf_P(&USBSerialStream, PSTR(",%lu,%lu,%lu,%lu,%lu,%u,%u"), TASK_TICKS[i] * TICK_MS, TASK_RUNS[i], \
+			TASK_RUNS[i] ? (TASK_TIME[i] / TASK_RUNS[i]) * 8 : 0, (uint32_t)TASK_MAX[i] * 8, \
+			(uint32_t)pgm_read_word(&TASK_Budget[i]) * 1000, TASK_OVERRUN[i], TASK_MISSED[i]);
+	}
 }
+#endif
 
-// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-// ~~ Port/LED Control Functions
-// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#ifdef ENABLEINRUSH
+// Print the last inrush capture and inrush settings for each port, one per line, as
+// port,peak A,settle ms (- if not yet settled),window ms,transient limit A
+static inline void PRINT_Inrush(void) {
+	for (uint8_t i = 0; i < PORT_CNT; i++) {
+		fprintf_P(&USBSerialStream, PSTR("\r\n%i,%.2f,"), i+1, PORT_INRUSH_PEAK[i] / 1000.0);
+		if (PORT_INRUSH_SETTLE[i] == INRUSH_UNSETTLED) {
+			fputc('-', &USBSerialStream);
+		} else {
+			fprintf_P(&USBSerialStream, PSTR("%u"), PORT_INRUSH_SETTLE[i]);
+		}
+		fprintf_P(&USBSerialStream, PSTR(",%u,%.1f"), EEPROM_Read_Inrush_Window(i), EEPROM_Read_Inrush_Limit(i) / 10.0);
+	}
+}
+#endif
+
+#ifdef ENABLETRIGGERS
+// Print the EXT input triggers, one per line, as
+// trigger,input,< or >,level V,port,ON or OFF,samples,input V,fired (1 or 0), or trigger,NONE
+static inline void PRINT_Triggers(void) {
+	uint8_t flags;
+	uint16_t level;
+	uint8_t count;
+	
+	for (uint8_t i = 0; i < TRIGGER_CNT; i++) {
+		uint8_t port = EEPROM_Read_Trigger(i, &flags, &level, &count);
+		fprintf_P(&USBSerialStream, PSTR("\r\n%i,"), i+1);
+		if (port == TRIGGER_NONE) {
+			printPGMStr(PSTR("NONE"));
+			continue;
+		}
+		fprintf_P(&USBSerialStream, PSTR("EXT%c,%c,%.2f,%i,%s,%u,%.2f,%i"), (flags & TRIGGER_EXT2) ? '2' : '1', \
+			(flags & TRIGGER_ABOVE) ? '>' : '<', level / 100.0, port+1, (flags & TRIGGER_ON) ? "ON" : "OFF", count, \
+			EXT_VOLTAGE[(flags & TRIGGER_EXT2) ? 1 : 0], (TRIGGER_FIRED >> i) & 1);
+	}
+}
+#endif
+
+#ifdef ENABLETEMP
+// Print the temperature, the percent of their limits the ports are held to, the derate and
+// shed points, and the ports shed, then the hottest temperature each minute, oldest first
+static inline void PRINT_Temperature(void) {
+	printPGMStr(STR_Temp);
+	fprintf_P(&USBSerialStream, PSTR("%d,%u,%u,%u,%u"), ADC_Read_Temperature(), TEMP_DERATE_PCT, EEPROM_Read_Temp(0), \
+		EEPROM_Read_Temp(1), TEMP_SHED_PORTS);
+	printPGMStr(PSTR("\r\nHISTORY:"));
+	for (uint8_t i = 0; i < TEMP_HISTORY_COUNT; i++) {
+		uint8_t entry = (TEMP_HISTORY_HEAD + TEMP_HISTORY_LEN - TEMP_HISTORY_COUNT + i) % TEMP_HISTORY_LEN;
+		fprintf_P(&USBSerialStream, PSTR(" %d"), TEMP_HISTORY[entry]);
+	}
+}
+#endif
+
+#ifdef ENABLESCHEDULE
+// Print the day and time of the reported time, or NOT SET, then the port schedule, one
+// entry per line
+static inline void PRINT_Schedule(void) {
+	printPGMStr(STR_Clock);
+	if (CLOCK_VALID) {
+		uint32_t seconds;
+		uint16_t ms;
+		CLOCK_Read_Time(&seconds, &ms);
+		uint32_t minute = seconds / 60;
+		uint8_t day = ((minute / MINUTES_PER_DAY) + 4) % 7; // 1 Jan 1970 was a Thursday
+		uint16_t time = minute % MINUTES_PER_DAY;
+		
+		for (uint8_t i = 0; i < 3; i++) fputc(pgm_read_byte(&STR_Days[(day * 3) + i]), &USBSerialStream);
+		fprintf_P(&USBSerialStream, PSTR(" %02u:%02u"), time / 60, time % 60);
+	} else {
+		printPGMStr(PSTR("NOT SET"));
+	}
+	for (uint8_t i = 0; i < SCHED_CNT; i++) {
+		printPGMStr(PSTR("\r\n"));
+		PRINT_Schedule_Entry(i);
+	}
+}
+
+// Print a port schedule entry as entry,days,HH:MM,action,ports or entry,NONE. Days are a
+// character a day from Sunday, - for off, and ports are separated by spaces.
+static inline void PRINT_Schedule_Entry(uint8_t entry) {
+	uint8_t days;
+	uint16_t minute;
+	pd_set ports;
+	uint8_t action = EEPROM_Read_Schedule(entry, &days, &minute, &ports);
+	
+	fprintf_P(&USBSerialStream, PSTR("%i,"), entry+1);
+	if (action == SCHED_NONE) {
+		printPGMStr(PSTR("NONE"));
+		return;
+	}
+	for (uint8_t i = 0; i < 7; i++) {
+		fputc((days & (1 << i)) ? pgm_read_byte(&STR_Day_Letters[i]) : '-', &USBSerialStream);
+	}
+	fprintf_P(&USBSerialStream, PSTR(",%02u:%02u,"), minute / 60, minute % 60);
+	printPGMStr((PGM_P)pgm_read_word(&STR_Actions[action]));
+	fputc(',', &USBSerialStream);
+	PRINT_Ports(ports);
+}
+#endif
+
+#ifdef ENABLERULES
+// Print a rule as rule,reading,< or >,level,seconds,action,ports,held seconds (- if the
+// reading isn't past the level), or rule,NONE
+static inline void PRINT_Rule(uint8_t rule) {
+	uint8_t flags;
+	int16_t level;
+	uint16_t seconds;
+	uint8_t action;
+	pd_set ports;
+	uint8_t reading = EEPROM_Read_Rule(rule, &flags, &level, &seconds, &action, &ports);
+	
+	fprintf_P(&USBSerialStream, PSTR("%i,"), rule+1);
+	if (reading == RULE_NONE) {
+		printPGMStr(PSTR("NONE"));
+		return;
+	}
+	printPGMStr((PGM_P)pgm_read_word(&STR_Readings[reading]));
+	if (reading == READ_CURRENT) fprintf_P(&USBSerialStream, PSTR("%i"), (flags & RULE_PORT) + 1);
+	fprintf_P(&USBSerialStream, PSTR(",%c,%d,%u,"), (flags & RULE_ABOVE) ? '>' : '<', level, seconds);
+	printPGMStr((PGM_P)pgm_read_word(&STR_Actions[action]));
+	fputc(',', &USBSerialStream);
+	PRINT_Ports(ports);
+	if (RULE_HELD & (1 << rule)) {
+		fprintf_P(&USBSerialStream, PSTR(",%lu"), (CLOCK_Millis() - RULE_START[rule]) / 1000);
+	} else {
+		printPGMStr(PSTR(",-"));
+	}
+}
+#endif
+
+#ifdef ENABLESCRIPT
+// Print the script's state, the next (or faulting) instruction, instructions run, and
+// whether it runs at boot
+static inline void PRINT_Script(void) {
+	printPGMStr(STR_Script);
+	printPGMStr((PGM_P)pgm_read_word(&STR_Script_States[SCRIPT_STATE]));
+	fprintf_P(&USBSerialStream, PSTR(",%u,%lu,%u"), SCRIPT_PC, SCRIPT_STEPS, EEPROM_Read_Script_Auto());
+}
+#endif
+
+#ifdef ENABLEGROUPS
+// Print a port group as group,name,ports, or group,NONE
+static inline void PRINT_Group(uint8_t group) {
+	char name[GROUP_NAME_LEN + 1];
+	pd_set ports = EEPROM_Read_Group(group, name);
+	
+	fprintf_P(&USBSerialStream, PSTR("%i,"), group+1);
+	if (name[0] == 0) {
+		printPGMStr(PSTR("NONE"));
+		return;
+	}
+	fprintf_P(&USBSerialStream, PSTR("%s,"), name);
+	PRINT_Ports(ports);
+}
+#endif
+
+#ifdef ENABLEPEAKS
+// Print when the peak window started and whether peaks are saved, then each port's peak as
+// port,peak A,time,bus volts. Peaks saved before boot have no time or voltage, shown as -.
+static inline void PRINT_Peaks(void) {
+	printPGMStr(STR_Peaks);
+	CLOCK_Print_Time(&PEAK_START);
+	fprintf_P(&USBSerialStream, PSTR(",%u"), EEPROM_Read_Peak_Save());
+	for (uint8_t i = 0; i < PORT_CNT; i++) {
+		fprintf_P(&USBSerialStream, PSTR("\r\n%i,%.3f,"), i+1, PORT_PEAK[i] / 1000.0);
+		if ((PEAK_RESTORED & (1 << i)) || PORT_PEAK[i] == 0) {
+			printPGMStr(PSTR("-,-"));
+		} else {
+			CLOCK_Print_Time(&PORT_PEAK_TIME[i]);
+			fprintf_P(&USBSerialStream, PSTR(",%.2f"), PORT_PEAK_VOLTAGE[i] / 100.0);
+		}
+	}
+}
+#endif
+
+#ifdef ENABLEFAULT
+// Print the fault capture as port,trip time,samples, then one sample per line as ms from the
+// trip,current A. Or NONE, if no port has tripped since it was cleared.
+static inline void PRINT_Fault(void) {
+	printPGMStr(STR_Fault);
+	if (FAULT_PORT == FAULT_NONE) {
+		printPGMStr(PSTR("NONE"));
+		return;
+	}
+	fprintf_P(&USBSerialStream, PSTR("%i,"), FAULT_PORT+1);
+	CLOCK_Print_Time(&FAULT_TIME);
+	fprintf_P(&USBSerialStream, PSTR(",%u"), FAULT_COUNT);
+	for (uint8_t i = 0; i < FAULT_COUNT; i++) {
+		fprintf_P(&USBSerialStream, PSTR("\r\n%d,%.1f"), FAULT_SAMPLE_TIME[i], FAULT_SAMPLES[i] / 10.0);
+	}
+}
+#endif
+
+// Print the ports in a set, separated by spaces
+static inline void PRINT_Ports(pd_set ports) {
+	uint8_t first = 1;
+	for (uint8_t i = 0; i < PORT_CNT; i++) {
+		if (!(ports & (1 << i))) continue;
+		fprintf_P(&USBSerialStream, first ? PSTR("%i") : PSTR(" %i"), i+1);
+		first = 0;
+	}
+}
+
+#ifdef ENABLEBATTERY
+// Print the battery state of charge estimate and battery settings for each bus, one per line, as
+// bus,state of charge % (- without a battery),capacity Ah,empty V,full V,resistance mOhm
+static inline void PRINT_Battery(void) {
+	for (uint8_t bus = 0; bus <= 1; bus++) {
+		printPGMStr(PSTR("\r\n"));
+		printPGMStr(bus ? STR_ALT : STR_MAIN);
+		if (BUS_SOC_VALID & (1 << bus)) {
+			fprintf_P(&USBSerialStream, PSTR(",%.1f"), BUS_SOC[bus]);
+		} else {
+			printPGMStr(PSTR(",-"));
+		}
+		fprintf_P(&USBSerialStream, PSTR(",%u,%.2f,%.2f,%u"), EEPROM_Read_Battery(bus, BATTERY_CAPACITY), \
+			EEPROM_Read_Battery(bus, BATTERY_EMPTY) / 100.0, EEPROM_Read_Battery(bus, BATTERY_FULL) / 100.0, \
+			EEPROM_Read_Battery(bus, BATTERY_RESISTANCE));
+	}
+}
+#endif
+
+#ifdef ENABLEJSON
+// Print a string as a quoted JSON string, escaping quotes and backslashes
+static inline void PRINT_JSON_Str(char *str) {
+	fputc('"', &USBSerialStream);
+	while (*str != 0) {
+		if (*str == '"' || *str == '\\') fputc('\\', &USBSerialStream);
+		fputc(*str, &USBSerialStream);
+		str++;
+	}
+	fputc('"', &USBSerialStream);
+}
+#endif
+
+// Print a quick help command
+static inline void PRINT_Help(void) {
+	printPGMStr(STR_Help_Info);
+}
+
+// Print a PGM stored string
+static inline void printPGMStr(PGM_P s) {
+	char c;
+	while((c = pgm_read_byte(s++)) != 0) {
+		// In quiet mode, skip over ANSI escape sequences (ESC, '[', parameters, final byte)
+		if (c == 0x1b && SESSION_QUIET) {
+			s++;
+			while ((c = pgm_read_byte(s++)) != 0 && c < 0x40);
+			if (c == 0) break;
+			continue;
+		}
+		fputc(c, &USBSerialStream);
+	}
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~ Port/LED Control Functions
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// Set all ports in a port descriptor set to a state, switching them together, then print
+// what was done
+static inline void PORT_Set_Ctl(pd_set *pd, uint8_t state) {
+	pd_set ports = 0;
+	
+	for (uint8_t i = 0; i < PORT_CNT; i++) {
+		// Locked ports are left alone
+		if ((*pd & (1 << i)) && !(PORT_STATE[i] & 0b00100000)) {
+			PORT_Release(i);
+			ports |= (1 << i);
+			
+			// If a port is controlled manually, make sure that voltage control gets disabled
+			// Does not disable voltage control settings stored in EEPROM
+			PORT_STATE[i] &= 0b11111011;
+		}
+	}
+	PORT_Write_Set(ports, state);
+	
+	for (uint8_t i = 0; i < PORT_CNT; i++) {
+		if (ports & (1 << i)) {
+			printPGMStr(STR_NR_Port);
+			fprintf(&USBSerialStream, "%i ", i+1);
+			printPGMStr(state ? STR_Enabled : STR_Disabled);
+		} else if (*pd & (1 << i)) {
+			fprintf(&USBSerialStream, "\r\n%i ", i+1);
+			printPGMStr(STR_Locked);
+		}
+	}
+}
+
+// Switch ports as PON, POFF or PCYCLE would, but silently, reporting each switched port with
+// an event. Used by triggers, schedules, rules and scripts. Locked ports are left alone, and ports latched
+// off after overloads or shed aren't turned on, as only PON releases them. A cycle of ports not
+// already cycling joins any cycle in progress, and they all end together.
+static inline void PORT_Action(uint8_t action, pd_set ports, uint8_t event) {
+	uint8_t state = (action == ACTION_ON);
+	pd_set cycle = 0;
+	pd_set switched = 0;
+	
+	for (uint8_t i = 0; i < PORT_CNT; i++) {
+		if (!(ports & (1 << i)) || (PORT_STATE[i] & 0b00100000)) continue;
+		if (action != ACTION_OFF && (PORT_STATE[i] & 0b11000000)) continue;
+		if (state != (PORT_STATE[i] & 0b00000001)) {
+			switched |= (1 << i);
+			EVENT_Queue(event, i);
+		}
+		if (action == ACTION_CYCLE) cycle |= (1 << i);
+	}
+	PORT_Write_Set(switched, state);
+	if (cycle & ~cycle_ports) {
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			cycle_ports |= cycle;
+			cycle_timer = EEPROM_Read_PCycle_Time() * TICKS_PER_SECOND;
+		}
+	}
+}
+
+// Manual control starts the overload retries afresh, and releases a latched or shed port
+static inline void PORT_Release(uint8_t port) {
+	PORT_RETRIES[port] = 0;
+	PORT_STATE[port] &= 0b00111111;
+#ifdef ENABLETEMP
+	TEMP_SHED_PORTS &= ~(1 << port);
+#endif
+}
+
+// Turn a port ON (state == 1) or OFF (state == 0) without printing anything. Used by
+// automatic controls, which report through the event queue instead.
+static inline void PORT_Write(uint8_t port, uint8_t state) {
+	PORT_Write_Set((1 << port), state);
+}
+
+// Turn a set of ports ON (state == 1) or OFF (state == 0) without printing anything. The
+// pins are gathered up so that each GPIO port is written once, and the ports switch together.
+static inline void PORT_Write_Set(pd_set ports, uint8_t state) {
+	uint8_t pins[GPIO_CNT] = {0, 0, 0};
+	
+	for (uint8_t port = 0; port < PORT_CNT; port++) {
+		if (!(ports & (1 << port))) continue;
+		
+		// A switched port starts counting VCTL samples again
+		if (state != (PORT_STATE[port] & 0b00000001)) PORT_VCTL_SAMPLES[port] = 0;
+		
+		// Start an inrush capture when a port comes on, and fresh fault samples
+		if (state == 1 && !(PORT_STATE[port] & 0b00000001)) {
+#ifdef ENABLEFAULT
+			FAULT_Forget(port);
+#endif
+#ifdef ENABLEINRUSH
+			PORT_ON_TIME[port] = CLOCK_Millis();
+			PORT_INRUSH_PEAK[port] = 0;
+			PORT_INRUSH_SETTLE[port] = INRUSH_UNSETTLED;
+			PORT_INRUSH_LAST[port] = 0;
+			INRUSH_PORTS |= (1 << port);
+			INRUSH_WINDOW_PORTS |= (1 << port);
+#endif
+		}
+#ifdef ENABLEINRUSH
+		if (state == 0) INRUSH_WINDOW_PORTS &= ~(1 << port);
+#endif
+		
+		pins[Ports_GPIO[port]] |= Ports_Masks[port];
+		if (state == 1) {
+			PORT_STATE[port] |= 0b00000001;
+		} else {
+			PORT_STATE[port] &= 0b11111110;
+		}
+		
+		// Clear any overload marks since we're manually setting this port
+		PORT_STATE[port] &= 0b11111101;
+	}
+	
+	// Nothing may run between the writes, so the ports switch within a few cycles of each other
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		if (state == 1) {
+			if (pins[GPIO_D]) PORTD |= pins[GPIO_D];
+			if (pins[GPIO_B]) PORTB |= pins[GPIO_B];
+			if (pins[GPIO_C]) PORTC |= pins[GPIO_C];
+		} else {
+			if (pins[GPIO_D]) PORTD &= ~pins[GPIO_D];
+			if (pins[GPIO_B]) PORTB &= ~pins[GPIO_B];
+			if (pins[GPIO_C]) PORTC &= ~pins[GPIO_C];
+		}
+	}
+}
+
+// Turn a LED ON (state == 1) or OFF (state == 0)
+// LED 0 == Green, LED 1 == Red
+static inline void LED_CTL(uint8_t led, uint8_t state) {
+#ifndef TESTBOARD
+	if (state == 1) {
+		if (led == 1) {
+			PORTF |= (1 << LED2);
+		} else {
+			PORTF |= (1 << LED1);
+		}
+	} else {
+		if (led == 1) {
+			PORTF &= ~(1 << LED2);
+		} else {
+			PORTF &= ~(1 << LED1);
+		}
+	}
+#else
+	if (state == 1) {
+		if (led == 1) {
+			PORTB |= (1 << LED2);
+		} else {
+			PORTB |= (1 << LED1);
+		}
+	} else {
+		if (led == 1) {
+			PORTB &= ~(1 << LED2);
+		} else {
+			PORTB &= ~(1 << LED1);
+		}
+	}
+#endif
+}
+
+// Check all ports for exceeding current limits, disable the port, and set the RED led.
+static inline void Check_Current_Limits(void){
+	// Run through all the ports
+	for (uint8_t i = 0; i < PORT_CNT; i++) {
+		// Only check ports that are actually enabled
+		if ((PORT_STATE[i] & 0x01) > 0) {
+			// Check the ports against configured current limits
+			if (PORT_Check_Current_Limit(i)) {
+				// If this port has already overloaded, don't repeat the message.
+				if ((PORT_STATE[i] & 0x02) > 0) break;
+				
+				PORT_Overload(i);
+			}
+		}
+	}
+		
+	// If no ports are listed as overload anymore, disable the error led.
+	uint8_t error = 0;
+	for (uint8_t i = 0; i < PORT_CNT; i++) {
+		if ((PORT_STATE[i] & 0x02) > 0) error++;
+	}
+	if (error == 0) LED_CTL(1, 0);
+}
+
+// Turn off a port that has exceeded its current limit
+static inline void PORT_Overload(uint8_t port){
+#ifdef ENABLEFAULT
+	// Keep the samples leading up to the trip
+	FAULT_Trigger(port);
+#endif
+	
+	// Disable the port
+	PORT_Write(port, 0);
+	
+	// Mark the overload bit for this port
+	PORT_STATE[port] |= 0b00000010;
+	
+	// If a port overloads, make sure that voltage control gets disabled
+	// Does not disable voltage control settings stored in EEPROM
+	PORT_STATE[port] &= 0b11111011;
+	
+	// Turn the error LED on.
+	LED_CTL(1, 1);
+	
+	// Current is above threshold. Let the host know.
+	EVENT_Queue(EVENT_OVERLOAD, port);
+	
+	// Retry later, or give up on the port
+	PORT_Retry_Schedule(port);
+}
+
+// Checks a port against the stored current limit, or its transient limit while it's
+// within the inrush window after turning on. Returns 0 if below limits, and 1 if the
+// port has exceeded current limits.
+static inline uint8_t PORT_Check_Current_Limit(uint8_t port){
+	float current = ADC_Read_Port_Current(port);
+	
+	// Keep the reading for the power budget check
+	PORT_CURRENT[port] = current * 1000;
+	PORT_Peak(port, PORT_CURRENT[port]);
+#ifdef ENABLEFAULT
+	FAULT_Sample(port, PORT_CURRENT[port]);
+#endif
+	
+	// Check for above threshold current flow, and return 1.
+#ifdef ENABLEINRUSH
+	uint8_t limit = PORT_In_Inrush(port) ? EEPROM_Read_Inrush_Limit(port) : EEPROM_Read_Port_Limit(port);
+#else
+	uint8_t limit = EEPROM_Read_Port_Limit(port);
+#endif
+	if (current > ((float)limit * TEMP_DERATE_PCT / 1000.0)) { return 1; }
+	
+	// Else return 0;
+	return 0;
+}
+
+// Keep a port's peak current, when it happened, and its bus voltage at the time. Called by the
+// current samplers, so reading a port's current for a status report doesn't move its peak.
+static inline void PORT_Peak(uint8_t port, uint16_t current) {
+	if (current <= PORT_PEAK[port]) return;
+	
+	PORT_PEAK[port] = current;
+#ifdef ENABLEPEAKS
+	PORT_PEAK_TIME[port] = CLOCK_Millis();
+	PORT_PEAK_VOLTAGE[port] = BUS_Read_Voltage((PORT_STATE[port] & 0b00010000) ? 1 : 0) * 100;
+	PEAK_RESTORED &= ~(1 << port);
+#endif
+}
+
+#ifdef ENABLEFAULT
+// Current in mA as fault capture deci-amps, rounded and held at the most a byte can store
+static inline uint8_t FAULT_Deciamps(uint16_t current) {
+	current = (current + 50) / 100;
+	return (current > 255) ? 255 : current;
+}
+
+// Keep a sample in the shared rolling fault samples. Called by the current samplers. Idle ports
+// would crowd the loaded ones out of the ring, so samples under 0.1A aren't kept.
+static inline void FAULT_Sample(uint8_t port, uint16_t current) {
+	uint8_t deciamps = FAULT_Deciamps(current);
+	if (deciamps == 0) return;
+	
+	FAULT_RING[FAULT_RING_HEAD] = deciamps;
+	FAULT_RING_PORT[FAULT_RING_HEAD] = port;
+	FAULT_RING_TIME[FAULT_RING_HEAD] = CLOCK_Millis();
+	FAULT_RING_HEAD = (FAULT_RING_HEAD + 1) % FAULT_RING_CNT;
+}
+
+// Drop a port's fault samples, so a port turned back on only captures samples of its own
+static inline void FAULT_Forget(uint8_t port) {
+	for (uint8_t i = 0; i < FAULT_RING_CNT; i++) {
+		if (FAULT_RING_PORT[i] == port) FAULT_RING_PORT[i] = FAULT_NONE;
+	}
+}
+
+// Freeze a port's last few fault samples at an overload trip, and start taking the samples after
+// it, unless a capture is already held
+static inline void FAULT_Trigger(uint8_t port) {
+	if (FAULT_PORT != FAULT_NONE) return;
+	
+	FAULT_PORT = port;
+	FAULT_TIME = CLOCK_Millis();
+	FAULT_COUNT = 0;
+	FAULT_POST_LEFT = FAULT_POST;
+	
+	// Count the port's recent samples, to skip all but the last FAULT_PRE of them
+	uint8_t found = 0;
+	for (uint8_t i = 0; i < FAULT_RING_CNT; i++) {
+		if (FAULT_RING_PORT[i] == port && (uint16_t)((uint16_t)FAULT_TIME - FAULT_RING_TIME[i]) <= FAULT_AGE_MAX) found++;
+	}
+	uint8_t skip = (found > FAULT_PRE) ? found - FAULT_PRE : 0;
+	
+	// Oldest first, from the head of the ring
+	for (uint8_t i = 0; i < FAULT_RING_CNT; i++) {
+		uint8_t at = (FAULT_RING_HEAD + i) % FAULT_RING_CNT;
+		uint16_t age = (uint16_t)FAULT_TIME - FAULT_RING_TIME[at];
+		if (FAULT_RING_PORT[at] != port || age > FAULT_AGE_MAX) continue;
+		if (skip) { skip--; continue; }
+		FAULT_SAMPLES[FAULT_COUNT] = FAULT_RING[at];
+		FAULT_SAMPLE_TIME[FAULT_COUNT++] = -(int16_t)age;
+	}
+}
+
+// Sample the tripped port each INRS period until the capture is complete
+static inline void Check_Fault_Capture(void) {
+	if (FAULT_POST_LEFT == 0) return;
+	
+	FAULT_SAMPLES[FAULT_COUNT] = FAULT_Deciamps(ADC_Read_Port_Current(FAULT_PORT) * 1000);
+	FAULT_SAMPLE_TIME[FAULT_COUNT++] = CLOCK_Millis() - FAULT_TIME;
+	FAULT_POST_LEFT--;
+}
+#endif
+
+#ifdef ENABLEPEAKS
+// Start a new peak window
+static inline void PORT_Clear_Peaks(void) {
+	for (uint8_t i = 0; i < PORT_CNT; i++) PORT_PEAK[i] = 0;
+	PEAK_RESTORED = 0;
+	PEAK_START = CLOCK_Millis();
+	if (EEPROM_Read_Peak_Save()) EEPROM_Write_Peaks();
+}
+#endif
+
+// Load the voltage control thresholds and debounce counts into RAM, after they change
+static inline void VCTL_Load(void){
+	for (uint8_t i = 0; i < PORT_CNT; i++) {
+		if (PORT_BOOT_STATE[i] & 0b00010000) {
+			PORT_CUTOFF[i] = EEPROM_Read_Port_CutOff_SoC(i);
+		} else {
+			PORT_CUTOFF[i] = EEPROM_Read_Port_CutOff(i) * 100 + 0.5;
+		}
+		if (PORT_BOOT_STATE[i] & 0b00100000) {
+			PORT_CUTON[i] = EEPROM_Read_Port_CutOn_SoC(i);
+		} else {
+			PORT_CUTON[i] = EEPROM_Read_Port_CutOn(i) * 100 + 0.5;
+		}
+		PORT_VCTL_OFF_COUNT[i] = EEPROM_Read_VCTL_Off_Count(i);
+		PORT_VCTL_ON_COUNT[i] = EEPROM_Read_VCTL_On_Count(i);
+	}
+}
+
+// Checks the disable voltage setting for each port and disables the port once its bus
+// has been below the cutoff threshold for the port's off count of samples, and re-enables
+// it once the bus has been above the cuton threshold for its on count. Thresholds set in
+// percent are checked against the bus's battery state of charge instead.
+static inline void Check_Voltage_Cutoff(void){
+	for (uint8_t i = 0; i < PORT_CNT; i++) {
+		if (!(PORT_STATE[i] & 0b00000100)) {
+			PORT_VCTL_SAMPLES[i] = 0;
+			continue;
+		}
+		
+		// Check the voltage as appropriate for the bus this port is on.
+		uint8_t bus = (PORT_STATE[i] & 0b00010000) ? 1 : 0;
+		uint16_t off_level = BUS_Read_Voltage(bus) * 100;
+		uint16_t on_level = off_level;
+		uint8_t count;
+		
+		// Without an estimate, state of charge thresholds hold the port as it is
+#ifdef ENABLEBATTERY
+		if (PORT_BOOT_STATE[i] & 0b00010000) off_level = (BUS_SOC_VALID & (1 << bus)) ? BUS_SOC[bus] * 100 : 0xFFFF;
+		if (PORT_BOOT_STATE[i] & 0b00100000) on_level = (BUS_SOC_VALID & (1 << bus)) ? BUS_SOC[bus] * 100 : 0;
+#else
+		if (PORT_BOOT_STATE[i] & 0b00010000) off_level = 0xFFFF;
+		if (PORT_BOOT_STATE[i] & 0b00100000) on_level = 0;
+#endif
+		
+		if ((PORT_STATE[i] & 0b00000001) && off_level < PORT_CUTOFF[i]) {
+			count = PORT_VCTL_OFF_COUNT[i];
+		// Shed ports wait for the power budget to restore them
+		} else if (!(PORT_STATE[i] & 0b10000001) && on_level > PORT_CUTON[i]) {
+			count = PORT_VCTL_ON_COUNT[i];
+		} else {
+			// Back within the thresholds, so start counting again
+			PORT_VCTL_SAMPLES[i] = 0;
+			PORT_STATE[i] &= 0b11110111;
+			continue;
+		}
+		
+		// Set the VCTL debouncing bit until the bus has been past the threshold long enough
+		if (++PORT_VCTL_SAMPLES[i] < count) {
+			PORT_STATE[i] |= 0b00001000;
+			continue;
+		}
+		if (PORT_STATE[i] & 0b00000001) {
+			PORT_Write(i, 0);
+			EVENT_Queue(EVENT_VCTL_OFF, i);
+		} else {
+			PORT_Write(i, 1);
+			EVENT_Queue(EVENT_VCTL_ON, i);
+		}
+		PORT_STATE[i] &= 0b11110111;
+	}
+}
+
+#ifdef ENABLEBUDGET
+// Whether a port under voltage control has its bus below the cutoff, so it would be turned
+// off if it were on. Thresholds in percent are held as they are without an estimate.
+static inline uint8_t VCTL_Past_Cutoff(uint8_t port) {
+	if (!(PORT_STATE[port] & 0b00000100)) return 0;
+	
+	uint8_t bus = (PORT_STATE[port] & 0b00010000) ? 1 : 0;
+	uint16_t off_level = BUS_Read_Voltage(bus) * 100;
+#ifdef ENABLEBATTERY
+	if (PORT_BOOT_STATE[port] & 0b00010000) off_level = (BUS_SOC_VALID & (1 << bus)) ? BUS_SOC[bus] * 100 : 0xFFFF;
+#else
+	if (PORT_BOOT_STATE[port] & 0b00010000) off_level = 0xFFFF;
+#endif
+	return off_level < PORT_CUTOFF[port];
+}
+#endif
+
+#ifdef ENABLEBATTERY
+// Estimate the state of charge of each bus's battery, where one is configured. Charge is
+// counted out of the battery with the port currents read by Check_Current_Limits, and
+// the estimate is drawn towards the one given by the bus voltage, corrected for the sag
+// under that load, over BATTERY_TAU. The PDU can't see charging current, so the voltage
+// is what brings the estimate back up as the battery recharges.
+static inline void Check_Battery(void){
+	uint32_t now = CLOCK_Millis();
+	
+	for (uint8_t bus = 0; bus <= 1; bus++) {
+		uint16_t capacity = EEPROM_Read_Battery(bus, BATTERY_CAPACITY);
+		uint16_t empty = EEPROM_Read_Battery(bus, BATTERY_EMPTY);
+		uint16_t full = EEPROM_Read_Battery(bus, BATTERY_FULL);
+		uint8_t bus_bit = bus ? 0b00010000 : 0;
+		
+		if (capacity == 0 || full <= empty) {
+			BUS_SOC_VALID &= ~(1 << bus);
+			continue;
+		}
+		
+		uint32_t load = 0; // mA
+		for (uint8_t i = 0; i < PORT_CNT; i++) {
+			if ((PORT_STATE[i] & 0b00010001) == (bus_bit | 0b00000001)) load += PORT_CURRENT[i];
+		}
+		
+		// Resting voltage, in volts*100, and the state of charge it suggests
+		float rest = BUS_Read_Voltage(bus) * 100 + load * EEPROM_Read_Battery(bus, BATTERY_RESISTANCE) / 10000.0;
+		float soc = (rest - empty) * 100 / (full - empty);
+		if (soc < 0) soc = 0;
+		if (soc > 100) soc = 100;
+		
+		if (!(BUS_SOC_VALID & (1 << bus))) {
+			BUS_SOC[bus] = soc;
+			BUS_SOC_TIME[bus] = now;
+			BUS_SOC_VALID |= (1 << bus);
+			continue;
+		}
+		
+		uint32_t elapsed = now - BUS_SOC_TIME[bus];
+		BUS_SOC_TIME[bus] = now;
+		if (elapsed > BATTERY_TAU * 1000UL) elapsed = BATTERY_TAU * 1000UL;
+		
+		// mA*ms drawn, against 3.6e7 mA*ms per percent of each Ah
+		BUS_SOC[bus] -= (float)load * elapsed / (capacity * 36000000.0);
+		BUS_SOC[bus] += (soc - BUS_SOC[bus]) * elapsed / (BATTERY_TAU * 1000.0);
+		if (BUS_SOC[bus] < 0) BUS_SOC[bus] = 0;
+		if (BUS_SOC[bus] > 100) BUS_SOC[bus] = 100;
+	}
+}
+#endif
+
+#ifdef ENABLETRIGGERS
+// Sample the EXT inputs, and switch the port of any trigger whose input has been past its
+// level for the trigger's count of samples. Each trigger fires once, and is armed again
+// once its input comes back, so the port can still be switched by hand in between.
+static inline void Check_Triggers(void){
+	uint8_t flags;
+	uint16_t level;
+	uint8_t count;
+	
+	EXT_VOLTAGE[0] = ADC_Read_EXT_Voltage(0);
+	EXT_VOLTAGE[1] = ADC_Read_EXT_Voltage(1);
+	
+	for (uint8_t i = 0; i < TRIGGER_CNT; i++) {
+		uint8_t port = EEPROM_Read_Trigger(i, &flags, &level, &count);
+		if (port == TRIGGER_NONE) continue;
+		
+		uint16_t voltage = EXT_VOLTAGE[(flags & TRIGGER_EXT2) ? 1 : 0] * 100;
+		uint8_t past = (flags & TRIGGER_ABOVE) ? (voltage > level) : (voltage < level);
+		if (!past) {
+			TRIGGER_SAMPLES[i] = 0;
+			TRIGGER_FIRED &= ~(1 << i);
+			continue;
+		}
+		if (TRIGGER_FIRED & (1 << i)) continue;
+		if (++TRIGGER_SAMPLES[i] < count) continue;
+		
+		TRIGGER_FIRED |= (1 << i);
+		TRIGGER_SAMPLES[i] = 0;
+		// As schedules and rules do, leaving locked, latched off and shed ports alone
+		PORT_Action((flags & TRIGGER_ON) ? ACTION_ON : ACTION_OFF, (1 << port), EVENT_TRIGGER);
+	}
+}
+#endif
+
+#ifdef ENABLESCHEDULE
+// Run the port schedule entries for this minute of the reported time. The task only comes
+// due on the minute, so the schedule costs nothing in between. Nothing runs until the host
+// has set the time, and minutes skipped by setting the time forward aren't caught up.
+static inline void Check_Schedule(void){
+	uint8_t days;
+	uint16_t at;
+	pd_set ports;
+	
+	if (!CLOCK_VALID) return;
+	
+	uint32_t seconds;
+	uint16_t ms;
+	CLOCK_Read_Time(&seconds, &ms);
+	// Round off the task running a little early or late
+	uint32_t minute = (seconds + 30) / 60;
+	// Only run each minute once, however early or late the task runs
+	if (minute == SCHED_LAST) return;
+	SCHED_LAST = minute;
+	
+	uint8_t day = ((minute / MINUTES_PER_DAY) + 4) % 7; // 1 Jan 1970 was a Thursday
+	uint16_t time = minute % MINUTES_PER_DAY;
+	for (uint8_t i = 0; i < SCHED_CNT; i++) {
+		uint8_t action = EEPROM_Read_Schedule(i, &days, &at, &ports);
+		if (action == SCHED_NONE || at != time || !(days & (1 << day))) continue;
+		PORT_Action(action, ports, EVENT_SCHEDULE);
+	}
+}
+#endif
+
+// A reading, as rules and scripts see it, from the readings the control tasks have already
+// taken. Port currents are 0 while the port is off.
+static inline int32_t READ_Value(uint8_t reading, uint8_t port) {
+	switch (reading) {
+		case READ_CURRENT: return (PORT_STATE[port] & 0b00000001) ? PORT_CURRENT[port] : 0;
+		case READ_MAIN: return BUS_Read_Voltage(0) * 100;
+		case READ_ALT: return BUS_Read_Voltage(1) * 100;
+#ifdef ENABLETRIGGERS
+		case READ_EXT1: return EXT_VOLTAGE[0] * 100;
+		case READ_EXT2: return EXT_VOLTAGE[1] * 100;
+#else
+		case READ_EXT1: return ADC_Read_EXT_Voltage(0) * 100;
+		case READ_EXT2: return ADC_Read_EXT_Voltage(1) * 100;
+#endif
+		default: return ADC_Read_Temperature();
+	}
+}
+
+#ifdef ENABLERULES
+// Act on the ports of any rule whose reading has been past its level for the rule's time,
+// using the readings the control tasks have already taken. A rule acts again each time
+// its time passes with the reading still past the level, so a hung device keeps being
+// cycled. A port's current only counts while the port is on.
+static inline void Check_Rules(void){
+	uint8_t flags;
+	int16_t level;
+	uint16_t seconds;
+	uint8_t action;
+	pd_set ports;
+	uint32_t now = CLOCK_Millis();
+	
+	for (uint8_t i = 0; i < RULE_CNT; i++) {
+		uint8_t reading = EEPROM_Read_Rule(i, &flags, &level, &seconds, &action, &ports);
+		uint8_t port = flags & RULE_PORT;
+		if (reading == RULE_NONE) {
+			RULE_HELD &= ~(1 << i);
+			continue;
+		}
+		
+		int32_t value = READ_Value(reading, port);
+		uint8_t past = (flags & RULE_ABOVE) ? (value > level) : (value < level);
+		if (reading == READ_CURRENT && !(PORT_STATE[port] & 0b00000001)) past = 0;
+		if (!past) {
+			RULE_HELD &= ~(1 << i);
+			continue;
+		}
+		if (!(RULE_HELD & (1 << i))) {
+			RULE_HELD |= (1 << i);
+			RULE_START[i] = now;
+		}
+		if (now - RULE_START[i] < seconds * 1000UL) continue;
+		
+		RULE_START[i] = now;
+		PORT_Action(action, ports, EVENT_RULE);
+	}
+}
+#endif
+
+#ifdef ENABLETEMP
+// Act on each new temperature sample. At or over the derate point, port current limits
+// are lowered by TEMP_DERATE_STEP percent per degree. At or over the shed point, a port is
+// shed every TEMP_SHED_SAMPLES, lowest priority first, and once the temperature is
+// TEMP_HYSTERESIS under it they are restored again at the same pace, highest priority
+// first. The hottest temperature each period is kept for TEMP.
+static inline void Check_Temperature(void){
+	if (!TEMP_NEW) return;
+	TEMP_NEW = 0;
+	
+	int16_t temp = ADC_Read_Temperature();
+	uint8_t derate = EEPROM_Read_Temp(0);
+	uint8_t shed = EEPROM_Read_Temp(1);
+	
+	if (temp > TEMP_HISTORY_PEAK) TEMP_HISTORY_PEAK = temp;
+	if (++TEMP_HISTORY_WAIT >= TEMP_HISTORY_SAMPLES) {
+		TEMP_HISTORY[TEMP_HISTORY_HEAD] = TEMP_HISTORY_PEAK;
+		TEMP_HISTORY_HEAD = (TEMP_HISTORY_HEAD + 1) % TEMP_HISTORY_LEN;
+		if (TEMP_HISTORY_COUNT < TEMP_HISTORY_LEN) TEMP_HISTORY_COUNT++;
+		TEMP_HISTORY_WAIT = 0;
+		TEMP_HISTORY_PEAK = -128;
+	}
+	
+	TEMP_DERATE_PCT = 100;
+	if (derate > 0 && temp >= derate) {
+		int16_t pct = 100 - (temp - derate + 1) * TEMP_DERATE_STEP;
+		TEMP_DERATE_PCT = (pct < TEMP_DERATE_MIN) ? TEMP_DERATE_MIN : pct;
+	}
+	
+	if (TEMP_SHED_WAIT < TEMP_SHED_SAMPLES) TEMP_SHED_WAIT++;
+	if (TEMP_SHED_WAIT < TEMP_SHED_SAMPLES) return;
+	
+	if (shed > 0 && temp >= shed) {
+		// Locked ports, and ports drawing nothing, are never shed
+		int8_t port = -1;
+		for (uint8_t i = 0; i < PORT_CNT; i++) {
+			if ((PORT_STATE[i] & 0b00100001) != 0b00000001 || PORT_CURRENT[i] == 0) continue;
+			if (port < 0 || EEPROM_Read_Port_Priority(i) >= EEPROM_Read_Port_Priority(port)) port = i;
+		}
+		if (port < 0) return;
+		
+		PORT_Write(port, 0);
+		PORT_STATE[port] |= 0b10000000;
+		TEMP_SHED_PORTS |= (1 << port);
+		EVENT_Queue(EVENT_SHED, port);
+		TEMP_SHED_WAIT = 0;
+	} else if (TEMP_SHED_PORTS && (shed == 0 || temp <= shed - TEMP_HYSTERESIS)) {
+		int8_t port = -1;
+		for (uint8_t i = 0; i < PORT_CNT; i++) {
+			if (!(TEMP_SHED_PORTS & (1 << i))) continue;
+			if (port < 0 || EEPROM_Read_Port_Priority(i) < EEPROM_Read_Port_Priority(port)) port = i;
+		}
+		
+		TEMP_SHED_PORTS &= ~(1 << port);
+		PORT_STATE[port] &= 0b01111111;
+		PORT_Write(port, 1);
+		EVENT_Queue(EVENT_RESTORE, port);
+		TEMP_SHED_WAIT = 0;
+	}
+}
+#endif
+
+// Schedule the next retry of a port that has just overloaded, backing off exponentially
+// with each attempt, or latch the port off once it has used all of its attempts.
+static inline void PORT_Retry_Schedule(uint8_t port){
+	if (PORT_RETRIES[port] >= EEPROM_Read_Retry_Attempts(port)) {
+		PORT_STATE[port] |= 0b01000000;
+		EVENT_Queue(EVENT_LOCKOUT, port);
+		return;
+	}
+	
+	uint32_t delay = EEPROM_Read_Retry_Delay(port);
+	for (uint8_t i = 0; i < PORT_RETRIES[port] && delay < RETRY_BACKOFF_MAX; i++) delay *= 2;
+	if (delay > RETRY_BACKOFF_MAX) delay = RETRY_BACKOFF_MAX;
+	
+	PORT_RETRY_TIME[port] = CLOCK_Millis() + (delay * 1000);
+}
+
+// Re-enable overloaded ports whose retry is due, and forget the attempts of ports that
+// have stayed up through their window since a retry.
+static inline void Retry_Overloaded_Ports(void){
+	uint32_t now = CLOCK_Millis();
+	
+	for (uint8_t i = 0; i < PORT_CNT; i++) {
+		if ((int32_t)(now - PORT_RETRY_TIME[i]) < 0) continue;
+		
+		if ((PORT_STATE[i] & 0b01000010) == 0b00000010) {
+			// Overloaded, and not latched off
+			PORT_Write(i, 1);
+			PORT_RETRIES[i]++;
+			PORT_RETRY_TIME[i] = now + ((uint32_t)EEPROM_Read_Retry_Window(i) * 1000);
+			EVENT_Queue(EVENT_RETRY, i);
+		} else if ((PORT_STATE[i] & 0b00000011) == 0b00000001) {
+			PORT_RETRIES[i] = 0;
+		}
+	}
+}
+
+#ifdef ENABLEINRUSH
+// Returns 1 if the port was turned on recently enough for its transient limit to apply. The
+// window is closed for good the first time it is found over, as PORT_ON_TIME wraps every 65s.
+// Check_Inrush keeps sampling a port until then, so that happens well before a wrap.
+static inline uint8_t PORT_In_Inrush(uint8_t port){
+	if (!(INRUSH_WINDOW_PORTS & (1 << port))) return 0;
+	if ((uint16_t)((uint16_t)CLOCK_Millis() - PORT_ON_TIME[port]) < EEPROM_Read_Inrush_Window(port)) return 1;
+	
+	INRUSH_WINDOW_PORTS &= ~(1 << port);
+	return 0;
+}
+
+// Sample ports that have just been turned on, every INRS_PERIOD, to catch their inrush peak
+// and the time it takes the current to settle. The transient limit is enforced as they
+// go, since these samples are much closer together than the ICTL task's.
+static inline void Check_Inrush(void){
+	if (INRUSH_PORTS == 0) return;
+	
+	for (uint8_t i = 0; i < PORT_CNT; i++) {
+		if (!(INRUSH_PORTS & (1 << i))) continue;
+		
+		// Turned off before it settled
+		if (!(PORT_STATE[i] & 0b00000001)) {
+			INRUSH_PORTS &= ~(1 << i);
+			continue;
+		}
+		
+		uint16_t elapsed = (uint16_t)CLOCK_Millis() - PORT_ON_TIME[i];
+		uint16_t current = ADC_Read_Port_Current(i) * 1000;
+		if (current > PORT_INRUSH_PEAK[i]) PORT_INRUSH_PEAK[i] = current;
+		PORT_Peak(i, current);
+#ifdef ENABLEFAULT
+		FAULT_Sample(i, current);
+#endif
+		
+		// Held to the same derated limit as PORT_Check_Current_Limit. Deci-amps times percent is mA.
+		if (PORT_In_Inrush(i) && current > (uint16_t)EEPROM_Read_Inrush_Limit(i) * TEMP_DERATE_PCT) {
+			INRUSH_PORTS &= ~(1 << i);
+			PORT_Overload(i);
+			continue;
+		}
+		
+		// Settled once two samples in a row agree, timed from the first of them
+		uint16_t last = PORT_INRUSH_LAST[i];
+		uint16_t margin = last / 10;
+		if (margin < INRUSH_SETTLE_MIN) margin = INRUSH_SETTLE_MIN;
+		if (PORT_INRUSH_SETTLE[i] == INRUSH_UNSETTLED && elapsed > INRS_PERIOD && \
+		    current <= last + margin && current + margin >= last) {
+			PORT_INRUSH_SETTLE[i] = elapsed - INRS_PERIOD;
+		}
+		PORT_INRUSH_LAST[i] = current;
+		
+		// Keep sampling through the window, so the transient limit is enforced throughout
+		if ((PORT_INRUSH_SETTLE[i] != INRUSH_UNSETTLED || elapsed >= INRUSH_CAPTURE_MAX) && !PORT_In_Inrush(i)) {
+			INRUSH_PORTS &= ~(1 << i);
+		}
+	}
+}
+#endif
+
+#ifdef ENABLEBUDGET
+// Keep the power drawn from each bus within its budget, using the currents read by
+// Check_Current_Limits. Over budget, ports are shed lowest priority first (highest
+// number, then highest port) until the bus is within budget. Once there is room for a
+// shed port plus BUDGET_HYSTERESIS to spare, the highest priority one is restored.
+static inline void Check_Power_Budget(void){
+	for (uint8_t bus = 0; bus <= 1; bus++) {
+		uint16_t budget = EEPROM_Read_Bus_Budget(bus);
+		uint8_t bus_bit = bus ? 0b00010000 : 0;
+		float voltage = 0;
+		float total = 0;
+		
+		if (budget > 0) {
+			voltage = BUS_Read_Voltage(bus);
+			for (uint8_t i = 0; i < PORT_CNT; i++) {
+				if ((PORT_STATE[i] & 0b00010001) == (bus_bit | 0b00000001)) total += voltage * PORT_CURRENT[i] / 1000.0;
+			}
+		}
+		
+		// Shed until within budget. Locked ports, and ports drawing nothing, are never shed.
+		uint8_t shed_any = 0;
+		while (budget > 0 && total > budget) {
+			int8_t shed = -1;
+			for (uint8_t i = 0; i < PORT_CNT; i++) {
+				if ((PORT_STATE[i] & 0b00110001) != (bus_bit | 0b00000001) || PORT_CURRENT[i] == 0) continue;
+				if (shed < 0 || EEPROM_Read_Port_Priority(i) >= EEPROM_Read_Port_Priority(shed)) shed = i;
+			}
+			if (shed < 0) break;
+			
+			float power = voltage * PORT_CURRENT[shed] / 1000.0;
+			PORT_Write(shed, 0);
+			PORT_STATE[shed] |= 0b10000000;
+			PORT_SHED_POWER[shed] = power * 10;
+			EVENT_Queue(EVENT_SHED, shed);
+			total -= power;
+			shed_any = 1;
+		}
+		if (shed_any) continue;
+		
+		// Restore one port at a time, so each is measured before the next
+		int8_t restore = -1;
+		for (uint8_t i = 0; i < PORT_CNT; i++) {
+			// Ports shed for temperature are left to Check_Temperature
+			if ((PORT_STATE[i] & 0b10010000) != (0b10000000 | bus_bit)) continue;
+#ifdef ENABLETEMP
+			if (TEMP_SHED_PORTS & (1 << i)) continue;
+#endif
+			if (restore < 0 || EEPROM_Read_Port_Priority(i) < EEPROM_Read_Port_Priority(restore)) restore = i;
+		}
+		if (restore >= 0 && VCTL_Past_Cutoff(restore)) {
+			// Voltage control would turn it straight back off, so leave it off for VCTL to turn on
+			PORT_STATE[restore] &= 0b01111111;
+		} else if (restore >= 0 && (budget == 0 || \
+		    (total + (PORT_SHED_POWER[restore] / 10.0)) * 100 <= (float)budget * (100 - BUDGET_HYSTERESIS))) {
+			PORT_STATE[restore] &= 0b01111111;
+			PORT_Write(restore, 1);
+			EVENT_Queue(EVENT_RESTORE, restore);
+		}
+	}
+}
+#endif
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~ Task Functions
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// Load the task periods from EEPROM and start counting them down
+static inline void TASK_Init(void) {
+	for (uint8_t i = 0; i < TASK_CNT; i++) {
+		TASK_Set_Period(i, i < TASK_STORED_CNT ? EEPROM_Read_Task_Period(i) : TICK_MS);
+	}
+	TASK_Set_Period(TASK_INRS, INRS_PERIOD);
+	SCHED_Align();
+}
+
+// Set a task's period in ms, rounded up to whole ticks. The task next runs one
+// period from now.
+static inline void TASK_Set_Period(uint8_t task, uint32_t period) {
+	uint32_t ticks = (period + TICK_MS - 1) / TICK_MS;
+	if (ticks == 0) ticks = 1;
+	
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		TASK_TICKS[task] = ticks;
+		TASK_WAIT[task] = ticks;
+	}
+}
+
+// Line the schedule task up to run at the start of each minute of the reported time
+static inline void SCHED_Align(void) {
+	uint32_t seconds;
+	uint16_t ms;
+	
+	CLOCK_Read_Time(&seconds, &ms);
+	uint32_t wait = ((60 - (seconds % 60)) * 1000UL - ms + TICK_MS - 1) / TICK_MS;
+	
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		TASK_TICKS[TASK_SCHD] = 60 * TICKS_PER_SECOND;
+		TASK_WAIT[TASK_SCHD] = wait;
+	}
+}
+
+// Run due tasks, highest priority first. Long running commands call this between
+// ports, so printing never holds the control tasks up for more than a slice.
+static inline void TASK_Yield(void) {
+	uint8_t ran = 0;
+	
+	// Tasks don't yield, but a command may be run from inside one some day
+	if (TASK_ACTIVE) return;
+	TASK_ACTIVE = 1;
+	
+	// Start again from the top after each task, in case a higher priority one came due
+	// while it ran. Each task runs at most once, so an overloaded loop still gets back
+	// to USB.
+	uint8_t i = 0;
+	while (i < TASK_CNT) {
+		if ((TASK_DUE & (1 << i)) && !(ran & (1 << i))) {
+			ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { TASK_DUE &= ~(1 << i); }
+			TASK_Run(i);
+			ran |= (1 << i);
+			i = 0;
+		} else {
+			i++;
+		}
+	}
+	
+	TASK_ACTIVE = 0;
+}
+
+// Run a task, and account for the time it took
+static inline void TASK_Run(uint8_t task) {
+#ifdef ENABLETASKS
+	uint32_t start = CLOCK_Counts();
+#endif
+	
+	switch (task) {
+		case TASK_ICTL:
+#ifdef ENABLETEMP
+			Check_Temperature();
+#endif
+			Check_Current_Limits();
+#ifdef ENABLEBUDGET
+			Check_Power_Budget();
+#endif
+#ifdef ENABLEBATTERY
+			Check_Battery();
+#endif
+#ifdef ENABLERULES
+			Check_Rules();
+#endif
+			break;
+		case TASK_VCTL:
+			Check_Voltage_Cutoff();
+#ifdef ENABLETRIGGERS
+			Check_Triggers();
+#endif
+			break;
+		case TASK_IRST:
+			Retry_Overloaded_Ports();
+			break;
+		case TASK_INRS:
+#ifdef ENABLEINRUSH
+			Check_Inrush();
+#endif
+#ifdef ENABLEFAULT
+			Check_Fault_Capture();
+#endif
+			break;
+		case TASK_SCHD:
+#ifdef ENABLESCHEDULE
+			Check_Schedule();
+#endif
+#ifdef ENABLEPEAKS
+			if (EEPROM_Read_Peak_Save()) EEPROM_Write_Peaks();
+#endif
+			break;
+		case TASK_SCPT:
+#ifdef ENABLESCRIPT
+			SCRIPT_Run();
+#endif
+			break;
+	}
+	
+#ifdef ENABLETASKS
+	uint32_t elapsed = CLOCK_Counts() - start;
+	TASK_RUNS[task]++;
+	TASK_TIME[task] += elapsed;
+	if (elapsed > (uint32_t)pgm_read_word(&TASK_Budget[task]) * TIMER1_COUNTS_PER_MS) TASK_OVERRUN[task]++;
+	if (elapsed > 0xFFFF) elapsed = 0xFFFF;
+	if (elapsed > TASK_MAX[task]) TASK_MAX[task] = elapsed;
+#endif
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~ Event Functions
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// Queue an asynchronous port event for reporting, and have the host notified from the main
+// loop via a CDC SerialState notification. If the queue is full, the oldest event is dropped.
+static inline void EVENT_Queue(uint8_t type, uint8_t port) {
+	if (EVENT_COUNT == EVENT_QUEUE_LEN) {
+		EVENT_HEAD = (EVENT_HEAD + 1) % EVENT_QUEUE_LEN;
+		EVENT_COUNT--;
+	}
+	EVENT_QUEUE[(EVENT_HEAD + EVENT_COUNT) % EVENT_QUEUE_LEN] = (type << 4) | (port & 0x0F);
+	EVENT_TIME[(EVENT_HEAD + EVENT_COUNT) % EVENT_QUEUE_LEN] = CLOCK_Millis();
+	EVENT_COUNT++;
+	
+	// Never send from here. Protection code queues events, and mustn't wait on the host.
+	EVENT_NOTIFY_PENDING = 1;
+}
+
+// Print all queued events as tagged lines, "!EVENT,<TYPE>,<PORT>,<TIME>"
+static inline void EVENT_Flush(void) {
+	while (EVENT_COUNT > 0) {
+		ev_set event = EVENT_QUEUE[EVENT_HEAD];
+		uint32_t at = EVENT_TIME[EVENT_HEAD];
+		EVENT_HEAD = (EVENT_HEAD + 1) % EVENT_QUEUE_LEN;
+		EVENT_COUNT--;
+		
+		printPGMStr(STR_Event);
+		printPGMStr((PGM_P)pgm_read_word(&STR_Events[event >> 4]));
+		fprintf_P(&USBSerialStream, PSTR(",%i,"), (event & 0x0F) + 1);
+		CLOCK_Print_Time(&at);
+	}
+}
 
-// Set all ports in a port descriptor set to a state
-static inline void PORT_Set_Ctl(pd_set *pd, uint8_t state) {
-	for (uint8_t i = 0; i < PORT_CNT; i++) {
-		if (*pd & (1 << i)) {
-			if (PORT_STATE[i] & 0b00100000) {
-				// Port is locked
-				fprintf(&USBSerialStream, "\r\n%i ", i+1);
-				printPGMStr(STR_Locked);
-			} else {
-				PORT_CTL(i, state);
-				
-				// If a port is controlled manually, make sure that voltage control gets disabled
-				// Does not disable voltage control settings stored in EEPROM
-				PORT_STATE[i] &= 0b11111011;
+// Send a CDC SerialState notification so hosts can block on port events (TIOCMIWAIT)
+// instead of polling. RI toggles once per notification, DCD is held while any port is
+// overloaded, and DSR is held while we're running. Called from the main loop. It never
+// waits on the host: the 10 byte notification goes one packet at a time, each only once
+// the endpoint is free, so a closed tty that isn't polling it costs nothing.
+static inline void EVENT_Notify(void) {
+	if (!EVENT_NOTIFY_PENDING && !EVENT_NOTIFY_STAGE) return;
+	if (USB_DeviceState != DEVICE_STATE_Configured) return;
+	
+	uint8_t previous = Endpoint_GetCurrentEndpoint();
+	Endpoint_SelectEndpoint(VirtualSerial_CDC_Interface.Config.NotificationEndpoint.Address);
+	if (Endpoint_IsINReady()) {
+		if (!EVENT_NOTIFY_STAGE) {
+			uint16_t lines = VirtualSerial_CDC_Interface.State.ControlLineStates.DeviceToHost;
+			lines ^= CDC_CONTROL_LINE_IN_RING;
+			lines |= CDC_CONTROL_LINE_IN_DSR;
+			lines &= ~CDC_CONTROL_LINE_IN_DCD;
+			for (uint8_t i = 0; i < PORT_CNT; i++) {
+				if (PORT_STATE[i] & 0b00000010) lines |= CDC_CONTROL_LINE_IN_DCD;
 			}
+			VirtualSerial_CDC_Interface.State.ControlLineStates.DeviceToHost = lines;
+			EVENT_NOTIFY_LINES = lines;
+			EVENT_NOTIFY_PENDING = 0;
+			
+			// The request header fills the 8 byte endpoint
+			Endpoint_Write_8(REQDIR_DEVICETOHOST | REQTYPE_CLASS | REQREC_INTERFACE);
+			Endpoint_Write_8(CDC_NOTIF_SerialState);
+			Endpoint_Write_16_LE(0);
+			Endpoint_Write_16_LE(VirtualSerial_CDC_Interface.Config.ControlInterfaceNumber);
+			Endpoint_Write_16_LE(sizeof(uint16_t));
+			EVENT_NOTIFY_STAGE = 1;
+		} else {
+			Endpoint_Write_16_LE(EVENT_NOTIFY_LINES);
+			EVENT_NOTIFY_STAGE = 0;
 		}
+		Endpoint_ClearIN();
 	}
+	Endpoint_SelectEndpoint(previous);
 }
 
-// Turn a port ON (state == 1) or OFF (state == 0)
-static inline void PORT_CTL(uint8_t port, uint8_t state) {
-	printPGMStr(STR_NR_Port);
-	fprintf(&USBSerialStream, "%i ", port+1);
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~ Clock Functions
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
-	if (state == 1) {
-		if (port <= 7) {
-			PORTD |= (1 << Ports_Pins[port]);
-		} else if (port <= 10) {
-			PORTB |= (1 << Ports_Pins[port]);
-		} else if (port <= 11) {
-			PORTC |= (1 << Ports_Pins[port]);
-		}
-		printPGMStr(STR_Enabled);
-		PORT_STATE[port] |= 0b00000001;
-	} else {
-		if (port <= 7) {
-			PORTD &= ~(1 << Ports_Pins[port]);
-		} else if (port <= 10) {
-			PORTB &= ~(1 << Ports_Pins[port]);
-		} else if (port <= 11) {
-			PORTC &= ~(1 << Ports_Pins[port]);
+// Read the time since boot to the millisecond, extending the tick count with the
+// timer 1 counter.
+static inline void CLOCK_Read(uint32_t *seconds, uint16_t *ms) {
+	uint16_t count;
+	
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		*seconds = CLOCK_SECONDS;
+		*ms = CLOCK_MS;
+		count = TCNT1;
+		// If a tick is due but not yet serviced, the counter has already restarted
+		if (TIFR1 & (1 << OCF1A)) {
+			*ms += TICK_MS;
+			count = TCNT1;
 		}
-		printPGMStr(STR_Disabled);
-		PORT_STATE[port] &= 0b11111110;
 	}
 	
-	// Clear any overload marks since we're manually setting this port
-	PORT_STATE[port] &= 0b11111101;
+	*ms += count / TIMER1_COUNTS_PER_MS;
+	if (*ms >= 1000) {
+		*ms -= 1000;
+		(*seconds)++;
+	}
 }
 
-// Turn a LED ON (state == 1) or OFF (state == 0)
-// LED 0 == Green, LED 1 == Red
-static inline void LED_CTL(uint8_t led, uint8_t state) {
-#ifndef TESTBOARD
-	if (state == 1) {
-		if (led == 1) {
-			PORTF |= (1 << LED2);
-		} else {
-			PORTF |= (1 << LED1);
-		}
-	} else {
-		if (led == 1) {
-			PORTF &= ~(1 << LED2);
-		} else {
-			PORTF &= ~(1 << LED1);
-		}
-	}
-#else
-	if (state == 1) {
-		if (led == 1) {
-			PORTB |= (1 << LED2);
-		} else {
-			PORTB |= (1 << LED1);
-		}
-	} else {
-		if (led == 1) {
-			PORTB &= ~(1 << LED2);
-		} else {
-			PORTB &= ~(1 << LED1);
+// Timer 1 counts (8us) since boot, for timing short intervals. Wraps after ~9.5 hours.
+static inline uint32_t CLOCK_Counts(void) {
+	uint32_t ticks;
+	uint16_t count;
+	
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		ticks = timer;
+		count = TCNT1;
+		if (TIFR1 & (1 << OCF1A)) {
+			ticks++;
+			count = TCNT1;
 		}
 	}
-#endif
+	
+	return (ticks * TICK_COUNTS) + count;
 }
 
-// Check all ports for exceeding current limits, disable the port, and set the RED led.
-static inline void Check_Current_Limits(void){
-	// Run through all the ports
-	for (uint8_t i = 0; i < PORT_CNT; i++) {
-		// Only check ports that are actually enabled
-		if ((PORT_STATE[i] & 0x01) > 0) {
-			// Check the ports against configured current limits
-			if (PORT_Check_Current_Limit(i)) {
-				// If this port has already overloaded, don't repeat the message.
-				if ((PORT_STATE[i] & 0x02) > 0) break;
-		
-				// Current is above threshold. Print a warning message.
-				fprintf(&USBSerialStream, "\r\n");
-				printPGMStr(STR_Overload);
-						
-				// Disable the port
-				PORT_CTL(i, 0);
-			
-				// Mark the overload bit for this port
-				PORT_STATE[i] |= 0b00000010;
-				
-				// If a port overloads, make sure that voltage control gets disabled
-				// Does not disable voltage control settings stored in EEPROM
-				PORT_STATE[i] &= 0b11111011;
-				
-				// Turn the error LED on.
-				LED_CTL(1, 1);
-				
-				INPUT_Clear();
-			}
-		}
-	}
-		
-	// If no ports are listed as overload anymore, disable the error led.
-	uint8_t error = 0;
-	for (uint8_t i = 0; i < PORT_CNT; i++) {
-		if ((PORT_STATE[i] & 0x02) > 0) error++;
-	}
-	if (error == 0) LED_CTL(1, 0);
+// Milliseconds since boot, for measuring intervals. Wraps after ~49 days.
+static inline uint32_t CLOCK_Millis(void) {
+	uint32_t seconds;
+	uint16_t ms;
+	
+	CLOCK_Read(&seconds, &ms);
+	return (seconds * 1000) + ms;
 }
 
-// Checks a port against the stored current limit. Returns 0 if below limits, and 1 if
-// the port has exceeded current limits.
-static inline uint8_t PORT_Check_Current_Limit(uint8_t port){
-	// Check for above threshold current flow, and return 1.
-	if (ADC_Read_Port_Current(port) > ((float)EEPROM_Read_Port_Limit(port) / 10.0)) { return 1; }
+// Set the offset added to reported times so that now reads as the given time
+static inline void CLOCK_Set(uint32_t seconds, uint16_t ms) {
+	uint32_t now_seconds;
+	uint16_t now_ms;
 	
-	// Else return 0;
-	return 0;
+	CLOCK_Read(&now_seconds, &now_ms);
+	if (ms < now_ms) {
+		ms += 1000;
+		seconds--;
+	}
+	CLOCK_EPOCH_S = seconds - now_seconds;
+	CLOCK_EPOCH_MS = ms - now_ms;
+	CLOCK_VALID = 1;
+	
+	// Minutes now start at a different point in the tick count. Take the minute being set as
+	// already run, so setting the time doesn't fire that minute's entries straight away
+#ifdef ENABLESCHEDULE
+	SCHED_LAST = (seconds + (ms / 1000)) / 60;
+#endif
+	SCHED_Align();
 }
 
-// Checks the disable voltage setting for each port and disables the port if it has fallen 
-// below the cutoff threshold, and re-enables if it is above the cuton threshold.
-static inline void Check_Voltage_Cutoff(void){
-	float voltage;
+// Read the reported time, as set with SETTIME
+static inline void CLOCK_Read_Time(uint32_t *seconds, uint16_t *ms) {
+	CLOCK_Read(seconds, ms);
+	*seconds += CLOCK_EPOCH_S;
+	*ms += CLOCK_EPOCH_MS;
+	if (*ms >= 1000) {
+		*ms -= 1000;
+		(*seconds)++;
+	}
+}
+
+// Print the time as <seconds>.<ms>, either now or when CLOCK_Millis() returned *at. This
+// is the time since boot, or the host's time (e.g. Unix time) once set with SETTIME.
+static inline void CLOCK_Print_Time(uint32_t *at) {
+	uint32_t seconds;
+	uint16_t ms;
+	uint32_t age = 0;
 	
-	for (uint8_t i = 0; i < PORT_CNT; i++) {
-		if ((PORT_STATE[i] & 0b00000100) > 0) {
-			// Check the voltage as appropriate for the bus this port is on.
-			if (PORT_STATE[i] & 0b00010000) {
-				voltage = ADC_Read_Alt_Voltage();
-			} else {
-				voltage = ADC_Read_Main_Voltage();
-			}
-			if ((voltage < EEPROM_Read_Port_CutOff(i) && (PORT_STATE[i] & 0b00000001)) || (voltage > EEPROM_Read_Port_CutOn(i) && !(PORT_STATE[i] & 0b00000001))) {
-				// Check if this is the second time through, if so, disable the port.
-				// If it's the first time through, set the VCTL changing bit
-				if ((PORT_STATE[i] & 0b00001000) > 0) {
-					// If it's below the cutoff, turn the port off
-					// If it's above the cuton, turn the port on
-					if (voltage < EEPROM_Read_Port_CutOff(i)) {
-						// Disable the port
-						PORT_CTL(i, 0);
-					}
-					if (voltage > EEPROM_Read_Port_CutOn(i)) {
-						// Enable the port
-						PORT_CTL(i, 1);
-					}
-					
-					// Clear the VCTL changing bit
-					PORT_STATE[i] &= 0b11110111;
-					
-					INPUT_Clear();
-				} else {
-					PORT_STATE[i] |= 0b00001000;
-				}
-			// If voltage is above thresholds, reset any VCTL changing bit that was applied.
-			} else {
-				// Clear the VCTL changing bit
-				PORT_STATE[i] &= 0b11110111;
-			}
-		}
+	// Work back from the same reading, so times taken in order print in order
+	CLOCK_Read(&seconds, &ms);
+	if (at != NULL) age = ((seconds * 1000) + ms) - *at;
+	seconds += CLOCK_EPOCH_S - (age / 1000);
+	ms += CLOCK_EPOCH_MS;
+	if (ms < (age % 1000)) {
+		ms += 1000;
+		seconds--;
 	}
+	ms -= (age % 1000);
+	if (ms >= 1000) {
+		ms -= 1000;
+		seconds++;
+	}
+	
+	fprintf_P(&USBSerialStream, PSTR("%lu.%03u"), seconds, ms);
 }
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -1004,6 +3079,164 @@ static inline void EEPROM_Write_V_CAL_ALT(float div) {
 	eeprom_update_byte((uint8_t*)(EEPROM_OFFSET_V_CAL_ALT), (int)(div * 10.0));
 }
 
+// Read the stored EXT input divider from EEPROM, 0 for EXT1 or 1 for EXT2
+static inline float EEPROM_Read_EXT_CAL(uint8_t ext) {
+	uint16_t EXT_CAL = eeprom_read_word((uint16_t*)(EEPROM_OFFSET_EXT_CAL + (ext*2)));
+	if (EXT_CAL > EXTCAL_MAX || EXT_CAL < EXTCAL_MIN) EXT_CAL = EXTCAL_MIN;
+	return (float)EXT_CAL / 100.0;
+}
+// Write the EXT input divider to EEPROM
+static inline void EEPROM_Write_EXT_CAL(uint8_t ext, float div) {
+	eeprom_update_word((uint16_t*)(EEPROM_OFFSET_EXT_CAL + (ext*2)), (uint16_t)(div * 100.0 + 0.5));
+}
+
+// Temperatures in C to derate port limits (0), and to shed ports (1), or 0 if not set
+static inline uint8_t EEPROM_Read_Temp(uint8_t setting) {
+	uint8_t temp = eeprom_read_byte((uint8_t*)(EEPROM_OFFSET_TEMP + setting));
+	if (temp > TEMP_MAX) temp = 0;
+	return temp;
+}
+static inline void EEPROM_Write_Temp(uint8_t setting, uint8_t temp) {
+	eeprom_update_byte((uint8_t*)(EEPROM_OFFSET_TEMP + setting), temp);
+}
+
+// Read an EXT input trigger. Returns its port, or TRIGGER_NONE if it isn't set.
+static inline uint8_t EEPROM_Read_Trigger(uint8_t trigger, uint8_t *flags, uint16_t *level, uint8_t *count) {
+	uint8_t *base = (uint8_t*)(EEPROM_OFFSET_TRIGGER + (trigger*5));
+	uint8_t port = eeprom_read_byte(base + 1);
+	
+	*flags = eeprom_read_byte(base);
+	*level = eeprom_read_word((uint16_t*)(base + 2));
+	*count = eeprom_read_byte(base + 4);
+	if (*count < 1 || *count > VCTL_COUNT_MAX) *count = VCTL_COUNT;
+	if (port >= PORT_CNT) port = TRIGGER_NONE;
+	return port;
+}
+static inline void EEPROM_Write_Trigger(uint8_t trigger, uint8_t port, uint8_t flags, uint16_t level, uint8_t count) {
+	uint8_t *base = (uint8_t*)(EEPROM_OFFSET_TRIGGER + (trigger*5));
+	
+	eeprom_update_byte(base, flags);
+	eeprom_update_byte(base + 1, port);
+	eeprom_update_word((uint16_t*)(base + 2), level);
+	eeprom_update_byte(base + 4, count);
+}
+
+// Read a port schedule entry. Returns its action, or SCHED_NONE if it isn't set.
+static inline uint8_t EEPROM_Read_Schedule(uint8_t entry, uint8_t *days, uint16_t *minute, pd_set *ports) {
+	uint8_t *base = (uint8_t*)(EEPROM_OFFSET_SCHEDULE + (entry*6));
+	uint8_t action = eeprom_read_byte(base);
+	
+	*days = eeprom_read_byte(base + 1) & SCHED_DAYS_ALL;
+	*minute = eeprom_read_word((uint16_t*)(base + 2));
+	*ports = eeprom_read_word((uint16_t*)(base + 4)) & ((1 << PORT_CNT) - 1);
+	if (action > ACTION_CYCLE || *minute >= MINUTES_PER_DAY) action = SCHED_NONE;
+	return action;
+}
+static inline void EEPROM_Write_Schedule(uint8_t entry, uint8_t action, uint8_t days, uint16_t minute, pd_set ports) {
+	uint8_t *base = (uint8_t*)(EEPROM_OFFSET_SCHEDULE + (entry*6));
+	
+	eeprom_update_byte(base, action);
+	eeprom_update_byte(base + 1, days);
+	eeprom_update_word((uint16_t*)(base + 2), minute);
+	eeprom_update_word((uint16_t*)(base + 4), ports);
+}
+
+// Read whether the script runs at boot
+static inline uint8_t EEPROM_Read_Script_Auto(void) {
+	return (eeprom_read_byte((uint8_t*)EEPROM_OFFSET_SCRIPT) == 1);
+}
+static inline void EEPROM_Write_Script_Auto(uint8_t autorun) {
+	eeprom_update_byte((uint8_t*)EEPROM_OFFSET_SCRIPT, autorun);
+}
+
+// Write script code, starting at offset into the code
+static inline void EEPROM_Write_Script(uint8_t offset, uint8_t *code, uint8_t len) {
+	for (uint8_t i = 0; i < len; i++) {
+		eeprom_update_byte((uint8_t*)(EEPROM_OFFSET_SCRIPT + 1 + offset + i), code[i]);
+	}
+}
+
+// Read a rule. Returns its reading, or RULE_NONE if it isn't set.
+static inline uint8_t EEPROM_Read_Rule(uint8_t rule, uint8_t *flags, int16_t *level, uint16_t *seconds, uint8_t *action, pd_set *ports) {
+	uint8_t *base = (uint8_t*)(EEPROM_OFFSET_RULE + (rule*9));
+	uint8_t reading = eeprom_read_byte(base);
+	
+	*flags = eeprom_read_byte(base + 1);
+	*level = eeprom_read_word((uint16_t*)(base + 2));
+	*seconds = eeprom_read_word((uint16_t*)(base + 4));
+	*action = eeprom_read_byte(base + 6);
+	*ports = eeprom_read_word((uint16_t*)(base + 7)) & ((1 << PORT_CNT) - 1);
+	if (reading > READ_TEMP || *action > ACTION_CYCLE) reading = RULE_NONE;
+	if (reading == READ_CURRENT && (*flags & RULE_PORT) >= PORT_CNT) reading = RULE_NONE;
+	return reading;
+}
+static inline void EEPROM_Write_Rule(uint8_t rule, uint8_t reading, uint8_t flags, int16_t level, uint16_t seconds, uint8_t action, pd_set ports) {
+	uint8_t *base = (uint8_t*)(EEPROM_OFFSET_RULE + (rule*9));
+	
+	eeprom_update_byte(base, reading);
+	eeprom_update_byte(base + 1, flags);
+	eeprom_update_word((uint16_t*)(base + 2), level);
+	eeprom_update_word((uint16_t*)(base + 4), seconds);
+	eeprom_update_byte(base + 6, action);
+	eeprom_update_word((uint16_t*)(base + 7), ports);
+}
+
+// Read a port group's ports, and its name if name isn't NULL. An unused group has no name,
+// and no ports.
+static inline pd_set EEPROM_Read_Group(uint8_t group, char *name) {
+	uint8_t *base = (uint8_t*)(EEPROM_OFFSET_GROUP + (group*10));
+	uint8_t first = eeprom_read_byte(base);
+	
+	if (first == 0 || first == 255) {
+		if (name != NULL) name[0] = 0;
+		return 0;
+	}
+	if (name != NULL) {
+		for (uint8_t i = 0; i < GROUP_NAME_LEN; i++) name[i] = eeprom_read_byte(base + i);
+		name[GROUP_NAME_LEN] = 0;
+	}
+	return eeprom_read_word((uint16_t*)(base + GROUP_NAME_LEN));
+}
+
+// Write a port group, upper casing its name. A name of length 0 clears the group.
+static inline void EEPROM_Write_Group(uint8_t group, char *name, uint8_t len, pd_set ports) {
+	uint8_t *base = (uint8_t*)(EEPROM_OFFSET_GROUP + (group*10));
+	
+	for (uint8_t i = 0; i < GROUP_NAME_LEN; i++) {
+		char c = (i < len) ? name[i] : 0;
+		if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+		eeprom_update_byte(base + i, c);
+	}
+	eeprom_update_word((uint16_t*)(base + GROUP_NAME_LEN), ports);
+}
+
+// Read whether peak currents are saved to EEPROM
+static inline uint8_t EEPROM_Read_Peak_Save(void) {
+	return (eeprom_read_byte((uint8_t*)EEPROM_OFFSET_PEAK) == 1);
+}
+
+static inline void EEPROM_Write_Peak_Save(uint8_t save) {
+	eeprom_update_byte((uint8_t*)EEPROM_OFFSET_PEAK, save);
+}
+
+#ifdef ENABLEPEAKS
+// Restore the peak currents saved before boot
+static inline void EEPROM_Read_Peaks(void) {
+	for (uint8_t i = 0; i < PORT_CNT; i++) {
+		PORT_PEAK[i] = eeprom_read_word((uint16_t*)(EEPROM_OFFSET_PEAK + 1 + (i*2)));
+		if (PORT_PEAK[i] == 0xFFFF) PORT_PEAK[i] = 0;
+		if (PORT_PEAK[i] > 0) PEAK_RESTORED |= (1 << i);
+	}
+}
+
+// Save the peak currents. Only the ports whose peak has changed are written.
+static inline void EEPROM_Write_Peaks(void) {
+	for (uint8_t i = 0; i < PORT_CNT; i++) {
+		eeprom_update_word((uint16_t*)(EEPROM_OFFSET_PEAK + 1 + (i*2)), PORT_PEAK[i]);
+	}
+}
+#endif
+
 // Read the stored port current calibration
 static inline float EEPROM_Read_I_CAL(uint8_t port) {
 	uint16_t I_CAL = eeprom_read_word((uint16_t*)(EEPROM_OFFSET_I_CAL + (port*2)));
@@ -1027,9 +3260,101 @@ static inline void EEPROM_Write_PCycle_Time(uint8_t time) {
 	eeprom_update_byte((uint8_t*)(EEPROM_OFFSET_CYCLE_TIME), time);
 }
 
+// Read a task period from EEPROM, in ms. Unset periods fall back to the default.
+static inline uint32_t EEPROM_Read_Task_Period(uint8_t task) {
+	uint32_t period = eeprom_read_dword((uint32_t*)(EEPROM_OFFSET_TASK_PERIOD + (task*4)));
+	if (period == 0 || period > TASK_PERIOD_MAX) period = pgm_read_dword(&TASK_Default_Period[task]);
+	return period;
+}
+// Write a task period to EEPROM, in ms
+static inline void EEPROM_Write_Task_Period(uint8_t task, uint32_t period) {
+	eeprom_update_dword((uint32_t*)(EEPROM_OFFSET_TASK_PERIOD + (task*4)), period);
+}
+
+// Seconds before the first overload retry
+static inline uint16_t EEPROM_Read_Retry_Delay(uint8_t port) {
+	uint16_t delay = eeprom_read_word((uint16_t*)(EEPROM_OFFSET_RETRY_DELAY + (port*2)));
+	if (delay == 0 || delay > RETRY_DELAY_MAX) delay = RETRY_DELAY;
+	return delay;
+}
+static inline void EEPROM_Write_Retry_Delay(uint8_t port, uint16_t delay) {
+	eeprom_update_word((uint16_t*)(EEPROM_OFFSET_RETRY_DELAY + (port*2)), delay);
+}
+
+// Overload retries before the port is latched off
+static inline uint8_t EEPROM_Read_Retry_Attempts(uint8_t port) {
+	uint8_t attempts = eeprom_read_byte((uint8_t*)(EEPROM_OFFSET_RETRY_ATTEMPTS + port));
+	if (attempts > RETRY_ATTEMPTS_MAX) attempts = RETRY_ATTEMPTS;
+	return attempts;
+}
+static inline void EEPROM_Write_Retry_Attempts(uint8_t port, uint8_t attempts) {
+	eeprom_update_byte((uint8_t*)(EEPROM_OFFSET_RETRY_ATTEMPTS + port), attempts);
+}
+
+// Seconds a port must stay up after a retry for its attempts to be forgotten
+static inline uint16_t EEPROM_Read_Retry_Window(uint8_t port) {
+	uint16_t window = eeprom_read_word((uint16_t*)(EEPROM_OFFSET_RETRY_WINDOW + (port*2)));
+	if (window > RETRY_WINDOW_MAX) window = RETRY_WINDOW;
+	return window;
+}
+static inline void EEPROM_Write_Retry_Window(uint8_t port, uint16_t window) {
+	eeprom_update_word((uint16_t*)(EEPROM_OFFSET_RETRY_WINDOW + (port*2)), window);
+}
+
+// Bus power budget in watts, 0 for none. Bus 0 is MAIN, 1 is ALT.
+static inline uint16_t EEPROM_Read_Bus_Budget(uint8_t bus) {
+	uint16_t budget = eeprom_read_word((uint16_t*)(EEPROM_OFFSET_BUS_BUDGET + (bus*2)));
+	if (budget > BUDGET_MAX) budget = 0;
+	return budget;
+}
+static inline void EEPROM_Write_Bus_Budget(uint8_t bus, uint16_t budget) {
+	eeprom_update_word((uint16_t*)(EEPROM_OFFSET_BUS_BUDGET + (bus*2)), budget);
+}
+
+// Battery settings for a bus, by BATTERY_* field. Capacity in Ah, 0 for no battery, empty
+// and full resting voltages in volts*100, and internal resistance in milliohms.
+static inline uint16_t EEPROM_Read_Battery(uint8_t bus, uint8_t field) {
+	uint16_t value = eeprom_read_word((uint16_t*)(EEPROM_OFFSET_BATTERY + (bus*8) + (field*2)));
+	if (value == 0xFFFF) value = 0;
+	return value;
+}
+static inline void EEPROM_Write_Battery(uint8_t bus, uint8_t field, uint16_t value) {
+	eeprom_update_word((uint16_t*)(EEPROM_OFFSET_BATTERY + (bus*8) + (field*2)), value);
+}
+
+// Port priority for load shedding, 1 (highest) to PRIORITY_MAX
+static inline uint8_t EEPROM_Read_Port_Priority(uint8_t port) {
+	uint8_t priority = eeprom_read_byte((uint8_t*)(EEPROM_OFFSET_PRIORITY + port));
+	if (priority < 1 || priority > PRIORITY_MAX) priority = PRIORITY_DEFAULT;
+	return priority;
+}
+static inline void EEPROM_Write_Port_Priority(uint8_t port, uint8_t priority) {
+	eeprom_update_byte((uint8_t*)(EEPROM_OFFSET_PRIORITY + port), priority);
+}
+
+// ms after a port turns on that its transient limit applies
+static inline uint16_t EEPROM_Read_Inrush_Window(uint8_t port) {
+	uint16_t window = eeprom_read_word((uint16_t*)(EEPROM_OFFSET_INRUSH_WINDOW + (port*2)));
+	if (window > INRUSH_WINDOW_MAX) window = INRUSH_WINDOW;
+	return window;
+}
+static inline void EEPROM_Write_Inrush_Window(uint8_t port, uint16_t window) {
+	eeprom_update_word((uint16_t*)(EEPROM_OFFSET_INRUSH_WINDOW + (port*2)), window);
+}
+
+// Transient current limit during the inrush window. Stored as amps*10, like the port limit.
+static inline uint8_t EEPROM_Read_Inrush_Limit(uint8_t port) {
+	uint8_t limit = eeprom_read_byte((uint8_t*)(EEPROM_OFFSET_INRUSH_LIMIT + port));
+	if (limit > LIMIT_MAX) limit = LIMIT_MAX;
+	return limit;
+}
+static inline void EEPROM_Write_Inrush_Limit(uint8_t port, uint8_t limit) {
+	eeprom_update_byte((uint8_t*)(EEPROM_OFFSET_INRUSH_LIMIT + port), limit);
+}
+
 // Read the stored port name
 static inline void EEPROM_Read_Port_Name(int8_t port, char *str) {
-	char working = 0;
+	uint8_t working = 0;
 	uint8_t count = 0;
 	
 	while (1) {
@@ -1037,7 +3362,8 @@ static inline void EEPROM_Read_Port_Name(int8_t port, char *str) {
 		working = eeprom_read_byte((uint8_t*)(EEPROM_OFFSET_P0NAME+(port*16)+count));
 		
 		// If we've reached the end of the string, terminate the string, and break.
-		if (working  == 255 || working == 0) {
+		// Names are at most 15 characters, which also stops us on blank EEPROM.
+		if (working  == 255 || working == 0 || count == 15) {
 			*str = 0;
 			break;
 		}
@@ -1094,6 +3420,36 @@ static inline void EEPROM_Write_Port_CutOn(uint8_t port, uint16_t cuton) {
 	eeprom_update_word((uint16_t*)(EEPROM_OFFSET_V_CUTON+(port*2)), cuton);
 }
 
+// Reads cutoff and cuton thresholds set in percent state of charge. Percent = value/100
+static inline uint16_t EEPROM_Read_Port_CutOff_SoC(uint8_t port) {
+	uint16_t cutoff = eeprom_read_word((uint16_t*)(EEPROM_OFFSET_V_CUTOFF+(port*2)));
+	if (cutoff > SOC_MAX) { cutoff = 0; }
+	return cutoff;
+}
+static inline uint16_t EEPROM_Read_Port_CutOn_SoC(uint8_t port) {
+	uint16_t cuton = eeprom_read_word((uint16_t*)(EEPROM_OFFSET_V_CUTON+(port*2)));
+	if (cuton > SOC_MAX) { cuton = SOC_MAX; }
+	return cuton;
+}
+
+// VCTL samples past the cutoff or cuton threshold before a port is switched
+static inline uint8_t EEPROM_Read_VCTL_Off_Count(uint8_t port) {
+	uint8_t count = eeprom_read_byte((uint8_t*)(EEPROM_OFFSET_VCTL_OFF_COUNT + port));
+	if (count < 1 || count > VCTL_COUNT_MAX) count = VCTL_COUNT;
+	return count;
+}
+static inline void EEPROM_Write_VCTL_Off_Count(uint8_t port, uint8_t count) {
+	eeprom_update_byte((uint8_t*)(EEPROM_OFFSET_VCTL_OFF_COUNT + port), count);
+}
+static inline uint8_t EEPROM_Read_VCTL_On_Count(uint8_t port) {
+	uint8_t count = eeprom_read_byte((uint8_t*)(EEPROM_OFFSET_VCTL_ON_COUNT + port));
+	if (count < 1 || count > VCTL_COUNT_MAX) count = VCTL_COUNT;
+	return count;
+}
+static inline void EEPROM_Write_VCTL_On_Count(uint8_t port, uint8_t count) {
+	eeprom_update_byte((uint8_t*)(EEPROM_OFFSET_VCTL_ON_COUNT + port), count);
+}
+
 // Reads the ADC offset for the port current sense from EEPROM. Raw ADC counts.
 static inline uint8_t EEPROM_Read_I_Offset(uint8_t port) {
 	uint8_t offset = eeprom_read_byte((uint8_t*)(EEPROM_OFFSET_I_OFFSET+(port)));
@@ -1105,10 +3461,13 @@ static inline void EEPROM_Write_I_Offset(uint8_t port, uint8_t offset) {
 	eeprom_update_byte((uint16_t*)(EEPROM_OFFSET_I_OFFSET+(port)), offset);
 }
 
-// Reset all EEPROM values to 255
+// Reset all EEPROM values to 255. The control tasks don't run until it's done, as they would
+// act on half reset settings.
 static inline void EEPROM_Reset(void) {
-	for (uint16_t i = 0; i < 512; i++) {
+	for (uint16_t i = 0; i < EEPROM_OFFSET_END; i++) {
 		eeprom_update_byte((uint8_t*)(i), 255);
+		// Each write takes ~3.4ms, so the whole reset can take a few seconds
+		if ((i % 16) == 15) wdt_reset();
 	}
 }
 
@@ -1122,7 +3481,12 @@ static inline void DEBUG_Dump(void) {
 	fprintf(&USBSerialStream, "\r\nV%s,%s", HARDWARE_VERS, SOFTWARE_VERS);
 
 	// Print uptime
-	fprintf(&USBSerialStream, "\r\nUp: %lus, Rst: %i\r\n", (timer / TICKS_PER_SECOND), BOOT_RESET_VECTOR);
+	uint32_t uptime = CLOCK_Millis();
+	fprintf_P(&USBSerialStream, PSTR("\r\nUp: %lums, Rst: %i\r\n"), uptime, BOOT_RESET_VECTOR);
+	
+	// Print time asleep
+	printPGMStr(STR_Sleep);
+	fprintf_P(&USBSerialStream, PSTR("%lums (%.1f%%), Wakes: %lu\r\n"), SLEEP_MS, uptime ? SLEEP_MS * 100.0 / uptime : 0.0, SLEEP_WAKES);
 
 	// Read port state
 	printPGMStr(STR_Command_STATUS);
@@ -1143,6 +3507,10 @@ static inline void DEBUG_Dump(void) {
 	printPGMStr(STR_VCAL);
 	fprintf(&USBSerialStream, "MAIN: %i:%.1f", eeprom_read_byte((uint8_t*)(EEPROM_OFFSET_V_CAL_MAIN)), EEPROM_Read_V_CAL_MAIN());
 	fprintf(&USBSerialStream, " ALT: %i:%.1f", eeprom_read_byte((uint8_t*)(EEPROM_OFFSET_V_CAL_ALT)), EEPROM_Read_V_CAL_ALT());
+	// Read EXT_CAL
+	printPGMStr(STR_EXTCAL);
+	fprintf_P(&USBSerialStream, PSTR("EXT1: %u:%.2f"), eeprom_read_word((uint16_t*)(EEPROM_OFFSET_EXT_CAL)), EEPROM_Read_EXT_CAL(0));
+	fprintf_P(&USBSerialStream, PSTR(" EXT2: %u:%.2f"), eeprom_read_word((uint16_t*)(EEPROM_OFFSET_EXT_CAL + 2)), EEPROM_Read_EXT_CAL(1));
 	// Read I_CAL
 	printPGMStr(STR_ICAL);
 	for (uint8_t i = 0; i < PORT_CNT; i++) {
@@ -1153,17 +3521,41 @@ static inline void DEBUG_Dump(void) {
 	for (uint8_t i = 0; i < PORT_CNT; i++) {
 		fprintf(&USBSerialStream, "%i:%i:%i ", ADC_Read_Raw(i), eeprom_read_byte((uint8_t*)(EEPROM_OFFSET_I_OFFSET + i)), EEPROM_Read_I_Offset(i));
 	}
+	TASK_Yield();
 	
 	// Read Port Cycle Time
 	printPGMStr(STR_PCYCLE_Time);
 	fprintf(&USBSerialStream, "%iS", eeprom_read_byte((uint8_t*)(EEPROM_OFFSET_CYCLE_TIME)));
 	
+#ifdef ENABLETASKS
+	// Read Task Periods and execution times
+	PRINT_Tasks();
+#endif
+	TASK_Yield();
+	
 	// Read Port Limits
 	printPGMStr(STR_Port_Limit);
 	for (uint8_t i = 0; i < PORT_CNT; i++) {
 		fprintf(&USBSerialStream, "%i:%i ", eeprom_read_byte((uint8_t*)(EEPROM_OFFSET_LIMIT + i)), EEPROM_Read_Port_Limit(i));
 	}
 	
+	// Read Port Retry Policies and retries used, as delay:attempts:window:retries
+	printPGMStr(STR_Port_Retry);
+	for (uint8_t i = 0; i < PORT_CNT; i++) {
+		fprintf_P(&USBSerialStream, PSTR("%u:%u:%u:%u "), EEPROM_Read_Retry_Delay(i), EEPROM_Read_Retry_Attempts(i), \
+			EEPROM_Read_Retry_Window(i), PORT_RETRIES[i]);
+	}
+	
+#ifdef ENABLEBUDGET
+	// Read Bus Budgets and Port Priorities
+	printPGMStr(STR_Bus_Budget);
+	fprintf_P(&USBSerialStream, PSTR("%u:%u"), EEPROM_Read_Bus_Budget(0), EEPROM_Read_Bus_Budget(1));
+	printPGMStr(STR_Port_Priority);
+	for (uint8_t i = 0; i < PORT_CNT; i++) {
+		fprintf_P(&USBSerialStream, PSTR("%u "), EEPROM_Read_Port_Priority(i));
+	}
+#endif
+	
 	// Read Port Cutoffs
 	printPGMStr(STR_Port_CutOff);
 	for (uint8_t i = 0; i < PORT_CNT; i++) {
@@ -1174,6 +3566,11 @@ static inline void DEBUG_Dump(void) {
 	for (uint8_t i = 0; i < PORT_CNT; i++) {
 		fprintf(&USBSerialStream, "%u:%.1f ", eeprom_read_word((uint16_t*)(EEPROM_OFFSET_V_CUTON + i*2)), EEPROM_Read_Port_CutOn(i));
 	}
+	// Read Port Debounce Counts
+	printPGMStr(STR_Port_Debounce);
+	for (uint8_t i = 0; i < PORT_CNT; i++) {
+		fprintf_P(&USBSerialStream, PSTR("%u:%u:%u "), PORT_VCTL_OFF_COUNT[i], PORT_VCTL_ON_COUNT[i], PORT_VCTL_SAMPLES[i]);
+	}
 	
 	// Read Port Names
 	printPGMStr(PSTR("\r\nPNAMES: "));
@@ -1187,13 +3584,14 @@ static inline void DEBUG_Dump(void) {
 	// Read Port High Water Marks
 	printPGMStr(PSTR("\r\nI High Water: "));
 	for (uint8_t i = 0; i < PORT_CNT; i++) {
-		fprintf(&USBSerialStream, "%.2f ", (PORT_HIGH_WATER[i] / 100.0));
+		fprintf_P(&USBSerialStream, PSTR("%.3f "), (PORT_PEAK[i] / 1000.0));
 	}
 
 #ifdef DEBUG
 	// Free Memory (Space between Heap and Stack)
 	printPGMStr(PSTR("\r\nFree Mem: "));
 	fprintf(&USBSerialStream, "%i", freeMemory());
+	fprintf_P(&USBSerialStream, PSTR(", Stack Unused: %u"), STACK_Unused());
 #endif
 }
 
@@ -1210,27 +3608,28 @@ static inline float ADC_Read_Port_Current(uint8_t port) {
 	// Calculate the current from the voltage reading
 	float current = (raw * (EEPROM_Read_REF_V() / 1024) / EEPROM_Read_I_CAL(port)) / 0.02;
 	
-	// Check current reading against the high water mark
-	if (current > (float)(PORT_HIGH_WATER[port] / 100.0)){
-		if((current * 100) < 255){
-			PORT_HIGH_WATER[port] = (uint8_t)(current * 100);
-		} else {
-			PORT_HIGH_WATER[port] = 255;
-		}
-	}
-	
 	return current;
 }
 
 // Read temperature (die temperature, uncalibrated, +/-10C)
 static inline int16_t ADC_Read_Temperature(void) {
+	int16_t temp;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { temp = TEMP_FILTERED; }
+	return (temp + 8) >> 4;
+}
+
+// Select the temperature sensor, and take the first reading by waiting on it, so there is
+// a temperature from boot. Later conversions are started by the timer, and finished by
+// the ADC interrupt.
+static inline void ADC_Init_Temperature(void) {
 	ADMUX = 0b11000111;
 	ADCSRB = 0b00100000;
 	ADCSRA |= (1<<ADSC); // Start first conversion (throw away)
 	while (ADCSRA & (1<<ADSC)); // Wait for conversion to complete
 	ADCSRA |= (1<<ADSC); // Start second conversion (valid)
 	while (ADCSRA & (1<<ADSC)); // Wait for conversion to complete
-	return ADCW - 273;
+	TEMP_FILTERED = ((int16_t)ADCW - 273) * 16;
+	ADCSRA |= (1<<ADIF) | (1<<ADIE); // Clear the flag from polling, and enable the interrupt
 }
 
 // Read MAIN input voltage
@@ -1243,13 +3642,26 @@ static inline float ADC_Read_Alt_Voltage(void) {
 	return (ADC_Read_Raw(13) * (EEPROM_Read_REF_V() / 1024) * EEPROM_Read_V_CAL_ALT());
 }
 
-// Read EXT input voltage
-static inline float ADC_Read_EXT_Voltage(uint8_t ext) {
-	uint8_t port = 14;
-	uint16_t working = 0;
+// Read a bus voltage, 0 for MAIN or 1 for ALT. The first read in each tick samples the
+// ADC, and the rest of the tick shares it.
+static inline float BUS_Read_Voltage(uint8_t bus) {
+	unsigned long now;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { now = timer; }
 	
-	if (ext == 0) { port = 14; } else { port = 15; }
-	return (ADC_Read_Raw(port) * (EEPROM_Read_REF_V() / 1024));
+	if (now != BUS_VOLTAGE_TICK) {
+		BUS_VOLTAGE_TICK = now;
+		BUS_VOLTAGE_READ = 0;
+	}
+	if (!(BUS_VOLTAGE_READ & (1 << bus))) {
+		BUS_VOLTAGE[bus] = bus ? ADC_Read_Alt_Voltage() : ADC_Read_Main_Voltage();
+		BUS_VOLTAGE_READ |= (1 << bus);
+	}
+	return BUS_VOLTAGE[bus];
+}
+
+// Read EXT input voltage, 0 for EXT1 or 1 for EXT2, corrected for the input's divider
+static inline float ADC_Read_EXT_Voltage(uint8_t ext) {
+	return (ADC_Read_Raw(ext ? 15 : 14) * (EEPROM_Read_REF_V() / 1024) * EEPROM_Read_EXT_CAL(ext));
 }
 
 // Return raw counts from the ADC
@@ -1332,6 +3744,12 @@ void EVENT_USB_Device_ConfigurationChanged(void) {
 	// USB is ready. Act on that as desired.
 }
 
+// Event handler for the CDC line coding (baud rate, etc) changing. Hosts open a quiet
+// session by selecting QUIET_BAUD, any other rate starts a normal interactive session.
+void EVENT_CDC_Device_LineEncodingChanged(USB_ClassInfo_CDC_Device_t* const CDCInterfaceInfo) {
+	SESSION_QUIET = (CDCInterfaceInfo->State.LineEncoding.BaudRateBPS == QUIET_BAUD);
+}
+
 // Event handler for the library USB Control Request reception event.
 void EVENT_USB_Device_ControlRequest(void) {
 	CDC_Device_ProcessControlRequest(&VirtualSerial_CDC_Interface);
@@ -1380,6 +3798,189 @@ static inline uint8_t SPI_transfer(uint8_t data) {
 	return value;
 }
 
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~ Script Functions
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#ifdef ENABLESCRIPT
+// Start the script from the top, with an empty stack and variables cleared
+static inline void SCRIPT_Start(void) {
+	SCRIPT_PC = 0;
+	SCRIPT_SP = 0;
+	memset(SCRIPT_VARS, 0, sizeof(SCRIPT_VARS));
+	SCRIPT_WAITING = 0;
+	SCRIPT_STEPS = 0;
+	SCRIPT_STATE = SCRIPT_RUNNING;
+}
+
+// Run up to SCRIPT_SLICE instructions of the script, stopping early at a WAIT or YIELD.
+// Code is read from EEPROM as it runs. Anything the script can't do (a bad opcode, port,
+// or variable, running off the end of the code, the stack over or underflowing, or a
+// divide by zero) faults it, leaving SCRIPT_PC at the faulting instruction.
+static inline void SCRIPT_Run(void) {
+	if (SCRIPT_STATE != SCRIPT_RUNNING) return;
+	if (SCRIPT_WAITING) {
+		if ((int32_t)(CLOCK_Millis() - SCRIPT_WAKE) < 0) return;
+		SCRIPT_WAITING = 0;
+	}
+	
+	for (uint8_t n = 0; n < SCRIPT_SLICE && SCRIPT_STATE == SCRIPT_RUNNING && !SCRIPT_WAITING; n++) {
+		uint8_t at = SCRIPT_PC;
+		uint8_t op = SCRIPT_Fetch();
+		uint8_t arg;
+		int16_t a, b;
+		SCRIPT_STEPS++;
+		
+		switch (op) {
+			case OP_HALT: SCRIPT_STATE = SCRIPT_STOPPED; break;
+			case OP_PUSH8: SCRIPT_Push((int8_t)SCRIPT_Fetch()); break;
+			case OP_PUSH16:
+				arg = SCRIPT_Fetch();
+				SCRIPT_Push(arg | (SCRIPT_Fetch() << 8));
+				break;
+			case OP_LOAD:
+			case OP_STORE:
+				arg = SCRIPT_Fetch();
+				if (arg >= SCRIPT_VAR_CNT) {
+					SCRIPT_STATE = SCRIPT_FAULT;
+				} else if (op == OP_LOAD) {
+					SCRIPT_Push(SCRIPT_VARS[arg]);
+				} else {
+					SCRIPT_VARS[arg] = SCRIPT_Pop();
+				}
+				break;
+			case OP_DUP:
+				a = SCRIPT_Pop();
+				SCRIPT_Push(a);
+				SCRIPT_Push(a);
+				break;
+			case OP_DROP: SCRIPT_Pop(); break;
+			case OP_NEG: SCRIPT_Push(-SCRIPT_Pop()); break;
+			case OP_NOT: SCRIPT_Push(!SCRIPT_Pop()); break;
+			case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV:
+			case OP_EQ: case OP_LT: case OP_GT: case OP_AND: case OP_OR:
+				b = SCRIPT_Pop();
+				a = SCRIPT_Pop();
+				switch (op) {
+					case OP_ADD: SCRIPT_Push((uint16_t)a + (uint16_t)b); break;
+					case OP_SUB: SCRIPT_Push((uint16_t)a - (uint16_t)b); break;
+					case OP_MUL: SCRIPT_Push((int32_t)a * b); break;
+					case OP_DIV:
+						if (b == 0) {
+							SCRIPT_STATE = SCRIPT_FAULT;
+						} else {
+							SCRIPT_Push((int32_t)a / b);
+						}
+						break;
+					case OP_EQ: SCRIPT_Push(a == b); break;
+					case OP_LT: SCRIPT_Push(a < b); break;
+					case OP_GT: SCRIPT_Push(a > b); break;
+					case OP_AND: SCRIPT_Push(a && b); break;
+					case OP_OR: SCRIPT_Push(a || b); break;
+				}
+				break;
+			case OP_JMP: SCRIPT_PC = SCRIPT_Fetch(); break;
+			case OP_JZ:
+				arg = SCRIPT_Fetch();
+				if (SCRIPT_Pop() == 0) SCRIPT_PC = arg;
+				break;
+			case OP_PORTS:
+				arg = SCRIPT_Fetch();
+				a = SCRIPT_Pop();
+				if (arg > ACTION_CYCLE) SCRIPT_STATE = SCRIPT_FAULT;
+				if (SCRIPT_STATE == SCRIPT_RUNNING) PORT_Action(arg, a & ((1 << PORT_CNT) - 1), EVENT_SCRIPT);
+				break;
+			case OP_READ:
+			case OP_STATE:
+				arg = (op == OP_READ) ? SCRIPT_Fetch() : READ_CURRENT;
+				a = (arg == READ_CURRENT) ? SCRIPT_Pop() : 1;
+				if (arg > READ_TEMP || a < 1 || a > PORT_CNT) {
+					SCRIPT_STATE = SCRIPT_FAULT;
+				} else if (op == OP_STATE) {
+					SCRIPT_Push(PORT_STATE[a - 1] & 0b00000001);
+				} else {
+					int32_t value = READ_Value(arg, a - 1);
+					SCRIPT_Push(value > INT16_MAX ? INT16_MAX : (value < INT16_MIN ? INT16_MIN : value));
+				}
+				break;
+			case OP_WAIT:
+				arg = SCRIPT_Fetch();
+				SCRIPT_WAKE = CLOCK_Millis() + (arg ? (uint16_t)SCRIPT_Pop() * 1000UL : (uint16_t)SCRIPT_Pop());
+				SCRIPT_WAITING = 1;
+				break;
+			case OP_YIELD: n = SCRIPT_SLICE; break;
+			default: SCRIPT_STATE = SCRIPT_FAULT; break;
+		}
+		
+		if (SCRIPT_STATE == SCRIPT_FAULT) SCRIPT_PC = at;
+	}
+}
+
+// Read the next byte of script code. Running off the end faults the script.
+static inline uint8_t SCRIPT_Fetch(void) {
+	if (SCRIPT_PC >= SCRIPT_LEN) {
+		SCRIPT_STATE = SCRIPT_FAULT;
+		return OP_END;
+	}
+	return eeprom_read_byte((uint8_t*)(EEPROM_OFFSET_SCRIPT + 1 + SCRIPT_PC++));
+}
+
+static inline void SCRIPT_Push(int16_t value) {
+	if (SCRIPT_SP >= SCRIPT_STACK_LEN) {
+		SCRIPT_STATE = SCRIPT_FAULT;
+		return;
+	}
+	SCRIPT_STACK[SCRIPT_SP++] = value;
+}
+
+static inline int16_t SCRIPT_Pop(void) {
+	if (SCRIPT_SP == 0) {
+		SCRIPT_STATE = SCRIPT_FAULT;
+		return 0;
+	}
+	return SCRIPT_STACK[--SCRIPT_SP];
+}
+#endif
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~ Power Functions
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// Power down the peripherals we don't use. The ADC SPI bus is bit banged, and the console
+// is over USB. The ADC is kept for the temperature sensor.
+static inline void POWER_Init(void) {
+	PRR0 |= (1 << PRTWI) | (1 << PRTIM0) | (1 << PRSPI);
+	PRR1 |= (1 << PRTIM4) | (1 << PRTIM3) | (1 << PRUSART1);
+	ACSR |= (1 << ACD); // Analog comparator
+}
+
+// Idle sleep until the next interrupt, unless there is work waiting. The timer tick wakes
+// us at least every 10ms, and USB control requests are handled by interrupt, so received
+// data and due tasks are picked up within a tick.
+static inline void POWER_Idle(void) {
+	cli();
+	// Held back events wait for the command being typed, so they aren't work yet
+	if (RX_COUNT > 0 || TASK_DUE || schedule_port_cycle || (EVENT_COUNT > 0 && DATA_IN_POS == 0) || \
+		CDC_Device_BytesReceived(&VirtualSerial_CDC_Interface) > 0) {
+		sei();
+		return;
+	}
+	
+	uint32_t start = CLOCK_Counts();
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	sleep_enable();
+	sei(); // The instruction after sei always runs, so no interrupt can slip in before sleeping
+	sleep_cpu();
+	sleep_disable();
+	
+	SLEEP_COUNTS += CLOCK_Counts() - start;
+	SLEEP_WAKES++;
+	if (SLEEP_COUNTS >= TIMER1_COUNTS_PER_MS) {
+		SLEEP_MS += SLEEP_COUNTS / TIMER1_COUNTS_PER_MS;
+		SLEEP_COUNTS %= TIMER1_COUNTS_PER_MS;
+	}
+}
+
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // ~~ Watchdog Functions
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -12,6 +12,7 @@
 #include <avr/sleep.h>
 #include <avr/interrupt.h>
 #include <util/delay.h>
+#include <util/atomic.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -30,20 +31,43 @@
 // Adjust the pins used to correspond with the prototype V1.0 build
 //#define TESTBOARD
 
-// Enable some debug printing
+// Enable some debug printing, and measure the stack's headroom for DEBUG to report
 //#define DEBUG
 
 // Enable ANSI color codes to be sent. Uses a small bit of extra program space for 
 // storage of color codes/modified strings.
 #define ENABLECOLORS
 
+// Optional features. With all of them the firmware is too big for the 28KB of flash below
+// the bootloader, so enable the ones you need, and check the build with "make size". Their
+// settings stay in EEPROM either way. The host tests build the firmware with all of them.
+//#define ENABLETASKS // SETPERIOD, TASKS - Control task periods, and task run time statistics
+//#define ENABLERETRY // SETRETRY - Overload retry policy per port
+//#define ENABLEJSON // JSTATUS
+//#define ENABLEBUDGET // SETBUDGET, SETPRIORITY - Bus power budgets and load shedding
+//#define ENABLEINRUSH // SETINRUSH, INRUSH - Transient current limits and inrush capture
+//#define ENABLEBATTERY // SETBATTERY, BATTERY - State of charge, and VCTL thresholds in percent
+//#define ENABLETRIGGERS // SETTRIG, TRIGGERS - EXT input triggers
+//#define ENABLETEMP // SETTEMP, TEMP - Thermal derating and shedding, temperature history
+//#define ENABLESCHEDULE // SETSCHED, SCHEDULE - Time of day port schedules
+//#define ENABLERULES // SETRULE, RULES - Port actions on readings that stay past a level
+//#define ENABLESCRIPT // SETSCRIPT, SCRIPT - Script VM
+//#define ENABLEGROUPS // SETGROUP, GROUPS - Named port groups
+//#define ENABLEPEAKS // PEAKS - Peak time and bus voltage, cleared and saved on request
+//#define ENABLEFAULT // FAULT - Current samples captured around overload trips
+
 #define SOFTWARE_STR "\r\nK7NVH PoE PDU"
 #define HARDWARE_VERS "1.1"
 #define SOFTWARE_VERS "1.3"
 #define PORT_CNT    12
 #define INPUT_CNT	12
 #define DATA_BUFF_LEN    32
+#define RX_BUFF_LEN      64
 #define ADC_AVG_POINTS   5
+#define EVENT_QUEUE_LEN  16
+#define QUIET_DELIM "\r\n.\r\n" // Terminates each response in quiet mode
+#define QUIET_BAUD 57600 // Selecting this line coding baud rate starts a quiet session
+#define STACK_CANARY 0xC5 // Fills the free RAM under the stack, for DEBUG to find its deepest reach
 
 // SPI pins
 #ifndef TESTBOARD
@@ -102,17 +126,191 @@
 #define ICAL_MIN 480 // 48x
 #define OFFSET_MAX 100 // Raw ADC counts
 #define VMAX 50
+#define RETRY_DELAY_MAX 3600 // Seconds
+#define RETRY_ATTEMPTS_MAX 100
+#define RETRY_BACKOFF_MAX 86400 // Seconds. Longest delay after backing off
+#define RETRY_WINDOW_MAX 43200 // Seconds
+#define BUDGET_MAX 2000 // Watts
+#define PRIORITY_MAX 9 // Lowest port priority, shed first
+#define INRUSH_WINDOW_MAX 10000 // ms
+#define VCTL_COUNT_MAX 100 // VCTL samples
+#define SOC_MAX 10000 // Percent*100
+#define BATTERY_CAPACITY_MAX 2000 // Ah
+#define BATTERY_RESISTANCE_MAX 1000 // Milliohms
+#define EXTCAL_MIN 100 // 1.00x
+#define EXTCAL_MAX 10000 // 100.00x
+#define TEMP_MAX 125 // C
 
 // Timing
-#define TICKS_PER_SECOND 4
-#define VCTL_DELAY 20 // Ticks. ~5s
-#define ICTL_DELAY 1 // Ticks. ~0.25s
-#define IRST_DELAY 1200 // Ticks. ~5min
+#define TICKS_PER_SECOND 100
+#define TICK_MS (1000 / TICKS_PER_SECOND)
+#define TIMER1_COUNTS_PER_MS 125 // 1MHz CPU clock, /8
+#define TICK_COUNTS (TICK_MS * TIMER1_COUNTS_PER_MS)
+
+// Scheduled tasks, run from the main loop at periods set with SETPERIOD. Tasks are
+// numbered in priority order, so when several are due the lowest numbered runs first.
+#define TASK_CNT 6
+#define TASK_STORED_CNT 3 // Tasks with a period in EEPROM. The rest run every tick, but INRS and SCHD.
+#define TASK_ICTL 0 // Check current limits
+#define TASK_VCTL 1 // Check voltage control
+#define TASK_IRST 2 // Retry overloaded ports that are due
+#define TASK_INRS 3 // Sample ports that have just been turned on
+#define TASK_SCHD 4 // Run the port schedule, on the minute
+#define TASK_SCPT 5 // Run a slice of the script
+#define ICTL_PERIOD 250 // Default periods, ms
+#define VCTL_PERIOD 5000
+#define IRST_PERIOD 1000
+#define INRS_PERIOD 50 // Fixed. Each run reads every port that is settling over SPI
+#define TASK_PERIOD_MAX 86400000 // ms. 1 day
+#define ICTL_BUDGET 50 // Longest expected run, ms
+#define VCTL_BUDGET 50
+#define IRST_BUDGET 20
+#define INRS_BUDGET 10
+#define SCHD_BUDGET 20
+#define SCPT_BUDGET 10
+
+// Event types, reported asynchronously as "!EVENT,<TYPE>,<PORT>,<TIME>"
+#define EVENT_OVERLOAD 0
+#define EVENT_VCTL_OFF 1
+#define EVENT_VCTL_ON 2
+#define EVENT_RETRY 3
+#define EVENT_CYCLE 4
+#define EVENT_LOCKOUT 5
+#define EVENT_SHED 6
+#define EVENT_RESTORE 7
+#define EVENT_TRIGGER 8
+#define EVENT_SCHEDULE 9
+#define EVENT_RULE 10
+#define EVENT_SCRIPT 11
+
+// Actions taken on ports by schedules and rules
+#define ACTION_OFF 0
+#define ACTION_ON 1
+#define ACTION_CYCLE 2
+#define ACTION_NONE 255
+
+// Overload retry defaults
+#define RETRY_DELAY 10 // Seconds before the first retry, doubling with each attempt
+#define RETRY_ATTEMPTS 5 // Retries before the port is latched off
+#define RETRY_WINDOW 60 // Seconds a port must stay up for its attempts to be forgotten
+
+// Power budget
+#define PRIORITY_DEFAULT 5
+#define BUDGET_HYSTERESIS 10 // Percent of the budget kept free before restoring a shed port
+
+// Inrush
+#define INRUSH_WINDOW 100 // ms after turn on that the transient limit applies
+#define INRUSH_CAPTURE_MAX 5000 // ms to wait for the current to settle
+#define INRUSH_SETTLE_MIN 20 // mA. Samples this close (or within 10%) are settled
+#define INRUSH_UNSETTLED 0xFFFF
+
+// Fault capture. Enabled ports share a ring of their last few current samples, and the first
+// overload trip freezes the port's samples along with those that follow, until FAULT CLEAR.
+#define FAULT_RING_CNT 24 // Samples kept across all ports
+#define FAULT_PRE 6 // Samples kept from before the trip
+#define FAULT_POST 6 // Samples taken after it, one per INRS period
+#define FAULT_AGE_MAX 30000 // ms. Older samples are left out of a capture
+#define FAULT_NONE 255
+
+// Voltage control
+#define VCTL_COUNT 2 // Default samples past a threshold before a port is switched
+
+// Battery state of charge estimation
+#define BATTERY_CAPACITY 0 // Fields of each bus's battery settings
+#define BATTERY_EMPTY 1
+#define BATTERY_FULL 2
+#define BATTERY_RESISTANCE 3
+#define BATTERY_TAU 600 // Seconds for the estimate to follow the voltage after a change in charge
+
+// EXT input triggers, checked with voltage control
+#define TRIGGER_CNT 4
+#define TRIGGER_EXT2 0b00000001 // Trigger flags. Source is EXT2, else EXT1
+#define TRIGGER_ABOVE 0b00000010 // Fires above the level, else below
+#define TRIGGER_ON 0b00000100 // Turns the port on, else off
+#define TRIGGER_NONE 255 // Port of an unused trigger
+
+// Time of day port schedules, run on the minute once the time is set with SETTIME
+#define SCHED_CNT 8
+#define SCHED_NONE ACTION_NONE // Action of an unused entry
+#define SCHED_DAYS_ALL 0b01111111 // Weekday bits, Sunday first
+#define MINUTES_PER_DAY 1440
+
+// Readings for rules and scripts
+#define READ_CURRENT 0 // Port current in mA
+#define READ_MAIN 1 // Bus and EXT input voltages in volts*100
+#define READ_ALT 2
+#define READ_EXT1 3
+#define READ_EXT2 4
+#define READ_TEMP 5 // Temperature in C
+
+// Rules, checked with current limits, that act on ports once a reading has been past a level
+#define RULE_CNT 6
+#define RULE_NONE 255 // Reading of an unused rule
+#define RULE_ABOVE 0b10000000 // Rule flags. Acts above the level, else below
+#define RULE_PORT 0b00001111 // Port of a current reading
+
+// Named port groups, usable anywhere a list of ports is
+#define GROUP_CNT 6
+#define GROUP_NAME_LEN 8
+
+// Script VM. Scripts are compiled on the host (host/src/Script.cpp) to a stack machine
+// bytecode, stored in EEPROM, and run a slice at a time by TASK_SCPT. Values are 16 bits.
+#define SCRIPT_LEN 255 // Bytes of code
+#define SCRIPT_STACK_LEN 16
+#define SCRIPT_VAR_CNT 8
+#define SCRIPT_SLICE 32 // Instructions per tick
+#define SCRIPT_STOPPED 0 // States
+#define SCRIPT_RUNNING 1
+#define SCRIPT_FAULT 2
+#define OP_HALT 0x00 // Opcodes, with their operand bytes
+#define OP_PUSH8 0x01 // <value>
+#define OP_PUSH16 0x02 // <low> <high>
+#define OP_LOAD 0x03 // <var>
+#define OP_STORE 0x04 // <var>
+#define OP_DUP 0x05
+#define OP_DROP 0x06
+#define OP_ADD 0x07
+#define OP_SUB 0x08
+#define OP_MUL 0x09
+#define OP_DIV 0x0A
+#define OP_NEG 0x0B
+#define OP_EQ 0x0C
+#define OP_LT 0x0D
+#define OP_GT 0x0E
+#define OP_NOT 0x0F
+#define OP_AND 0x10
+#define OP_OR 0x11
+#define OP_JMP 0x12 // <address>
+#define OP_JZ 0x13 // <address>
+#define OP_PORTS 0x14 // <ACTION_*>. Pops a port bitmap
+#define OP_READ 0x15 // <READ_*>. Pops a port number for READ_CURRENT
+#define OP_STATE 0x16 // Pops a port number, pushes 1 if it's on
+#define OP_WAIT 0x17 // <0 for ms, 1 for seconds>. Pops the time
+#define OP_YIELD 0x18
+#define OP_END 0xFF // Not an opcode. Fetched past the end of the code, so it faults
+
+// Temperature, converted in the background by the ADC interrupt
+#define TEMP_SAMPLE_TICKS 100 // Ticks between conversions
+#define TEMP_FILTER 4 // Samples for the filtered temperature to follow a change
+#define TEMP_DERATE_STEP 5 // Percent off port limits for each degree at or over the derate point
+#define TEMP_DERATE_MIN 50 // Percent. Port limits are never derated below this
+#define TEMP_SHED_SAMPLES 10 // Samples between shedding, or restoring, each port
+#define TEMP_HYSTERESIS 5 // C under the shed point before shed ports are restored
+#define TEMP_HISTORY_LEN 60
+#define TEMP_HISTORY_SAMPLES 60 // Samples per history entry, 1 minute
 
 // EEPROM Offsets
 // Stored settings
 #define EEPROM_OFFSET_PORT_DEFAULTS 0 // 16 bytes at offset 0
 #define EEPROM_OFFSET_CYCLE_TIME 16 // 1 byte at offset 17
+#define EEPROM_OFFSET_TASK_PERIOD 17 // 12 bytes - Task periods in ms
+#define EEPROM_OFFSET_RETRY_DELAY 29 // 24 bytes - Seconds before the first overload retry
+#define EEPROM_OFFSET_RETRY_ATTEMPTS 53 // 12 bytes - Overload retries before latching off
+#define EEPROM_OFFSET_RETRY_WINDOW 65 // 24 bytes - Seconds up before retries are forgotten
+#define EEPROM_OFFSET_BUS_BUDGET 89 // 4 bytes - MAIN and ALT bus power budgets in watts
+#define EEPROM_OFFSET_PRIORITY 93 // 12 bytes - Port priorities for load shedding
+#define EEPROM_OFFSET_INRUSH_WINDOW 105 // 24 bytes - ms after turn on that the transient limit applies
+#define EEPROM_OFFSET_INRUSH_LIMIT 129 // 12 bytes - Transient current limit, amps*10
 // Calibration values
 #define EEPROM_OFFSET_I_OFFSET 142 // 12 bytes - ADC counts of the current sense offset
 #define EEPROM_OFFSET_REF_V 154 // 4 bytes - Calibrate the ADC reference voltage
@@ -139,6 +337,19 @@
 #define EEPROM_OFFSET_P9NAME 464 // 16 Bytes
 #define EEPROM_OFFSET_P10NAME 480 // 16 Bytes
 #define EEPROM_OFFSET_P11NAME 496 // 16 Bytes
+// Stored settings, continued
+#define EEPROM_OFFSET_VCTL_OFF_COUNT 512 // 12 bytes - VCTL samples below cutoff before turning off
+#define EEPROM_OFFSET_VCTL_ON_COUNT 524 // 12 bytes - VCTL samples above cuton before turning on
+#define EEPROM_OFFSET_BATTERY 536 // 16 bytes - MAIN and ALT battery capacity, empty and full voltage, resistance
+#define EEPROM_OFFSET_EXT_CAL 552 // 4 bytes - Calibrate the EXT1 and EXT2 input dividers, ratio*100
+#define EEPROM_OFFSET_TRIGGER 556 // 20 bytes - EXT input triggers. Flags, port, level volts*100, samples
+#define EEPROM_OFFSET_TEMP 576 // 2 bytes - Temperatures in C to derate port limits, and to shed ports
+#define EEPROM_OFFSET_SCHEDULE 578 // 48 bytes - Port schedules. Action, weekdays, minute of day, ports
+#define EEPROM_OFFSET_RULE 626 // 54 bytes - Rules. Reading, flags, level, seconds, action, ports
+#define EEPROM_OFFSET_SCRIPT 680 // 256 bytes - Script. Run at boot flag, then code
+#define EEPROM_OFFSET_GROUP 936 // 60 bytes - Port groups. Name, then ports
+#define EEPROM_OFFSET_PEAK 996 // 25 bytes - Save peaks flag, then port peak currents in mA
+#define EEPROM_OFFSET_END 1021 // First unused byte
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // ~~ Globals
@@ -146,24 +357,113 @@
 
 // Timer
 volatile unsigned long timer = 0;
+// Clock - time since boot, advanced each tick, with the host's offset for reported times
+volatile uint32_t CLOCK_SECONDS = 0;
+volatile uint16_t CLOCK_MS = 0; // Milliseconds past CLOCK_SECONDS as of the last tick
+uint32_t CLOCK_EPOCH_S = 0;
+uint16_t CLOCK_EPOCH_MS = 0;
+uint8_t CLOCK_VALID = 0; // Set once the host has set the time
 // Schedule
-volatile uint8_t schedule_check_voltage = 0;
-volatile uint8_t schedule_check_current = 0;
 volatile uint8_t schedule_port_cycle = 0;
-volatile uint8_t schedule_reset_current = 0;
+volatile uint8_t TASK_DUE = 0; // Bitmap of tasks waiting to run
+uint32_t TASK_TICKS[TASK_CNT]; // Task periods, in ticks
+volatile uint32_t TASK_WAIT[TASK_CNT]; // Ticks until each task is next due
+#ifdef ENABLETASKS
+// Task execution time accounting, in timer 1 counts (8us)
+uint32_t TASK_RUNS[TASK_CNT];
+uint32_t TASK_TIME[TASK_CNT];
+uint16_t TASK_MAX[TASK_CNT];
+uint16_t TASK_OVERRUN[TASK_CNT]; // Runs that took longer than the task's budget
+volatile uint16_t TASK_MISSED[TASK_CNT]; // Periods that passed without the task running
+#endif
+uint8_t TASK_ACTIVE = 0; // Set while TASK_Yield is running tasks
 
 // Port Set - bitmap of ports
 typedef uint16_t pd_set;
 // Port State Set - bitmap of port state
-// (NUL,NUL,Locked?,AUX bus?,VCTL Changing,VCTL Enabled?,Overload,Enabled?)
+// (Shed?,Overload Latched?,Locked?,AUX bus?,VCTL Debouncing,VCTL Enabled?,Overload,Enabled?)
 typedef uint8_t ps_set;
 // Port Boot State Set - bitmap of port boot state
-// (NUL,NUL,NUL,NUL,Locked?,AUX bus?,VCTL Enabled?,Enabled?)
+// (NUL,NUL,VCTL On SoC?,VCTL Off SoC?,Locked?,AUX bus?,VCTL Enabled?,Enabled?)
 typedef uint8_t pbs_set;
 
 // Port Cycle Tracking
-pd_set cycle_ports;
-volatile uint8_t cycle_timer = 0;
+volatile pd_set cycle_ports;
+volatile uint16_t cycle_timer = 0;
+
+#ifdef ENABLEINRUSH
+// Inrush Capture Tracking, from turn on until the current settles
+pd_set INRUSH_PORTS = 0; // Ports being captured
+pd_set INRUSH_WINDOW_PORTS = 0; // Ports still within their inrush window
+#endif
+
+// Temperature, sampled by the ADC interrupt every TEMP_SAMPLE_TICKS
+volatile uint8_t TEMP_WAIT = TEMP_SAMPLE_TICKS; // Ticks until the next conversion
+volatile int16_t TEMP_FILTERED = 0; // C*16
+volatile uint8_t TEMP_NEW = 0; // Set by each conversion until Check_Temperature has seen it
+#ifdef ENABLETEMP
+uint8_t TEMP_DERATE_PCT = 100; // Percent of their limits the ports are held to
+pd_set TEMP_SHED_PORTS = 0; // Ports shed for temperature
+uint8_t TEMP_SHED_WAIT = 0; // Samples since a port was last shed or restored
+int8_t TEMP_HISTORY[TEMP_HISTORY_LEN]; // Hottest C in each period, in a ring ending at TEMP_HISTORY_HEAD
+uint8_t TEMP_HISTORY_HEAD = 0;
+uint8_t TEMP_HISTORY_COUNT = 0;
+uint8_t TEMP_HISTORY_WAIT = 0; // Samples into the current period
+int8_t TEMP_HISTORY_PEAK = -128; // Hottest C so far in the current period
+#else
+#define TEMP_DERATE_PCT 100 // Ports are always held to their full limits
+#endif
+
+// Idle sleep accounting
+uint32_t SLEEP_MS = 0; // Time spent asleep
+uint16_t SLEEP_COUNTS = 0; // Timer 1 counts asleep, short of a whole ms
+uint32_t SLEEP_WAKES = 0;
+
+// Bus Voltages, read at most once per tick and shared by the control tasks
+float BUS_VOLTAGE[2]; // MAIN and ALT
+unsigned long BUS_VOLTAGE_TICK = 0; // Tick the readings were taken in
+uint8_t BUS_VOLTAGE_READ = 0; // Bitmap of buses read in BUS_VOLTAGE_TICK
+
+#ifdef ENABLEBATTERY
+// Battery State of Charge
+float BUS_SOC[2]; // Percent, MAIN and ALT
+uint32_t BUS_SOC_TIME[2]; // CLOCK_Millis() of the last update
+uint8_t BUS_SOC_VALID = 0; // Bitmap of buses with a battery configured and an estimate
+#endif
+
+#ifdef ENABLETRIGGERS
+// EXT Inputs
+float EXT_VOLTAGE[2]; // EXT1 and EXT2, as of the last voltage control check
+uint8_t TRIGGER_SAMPLES[TRIGGER_CNT]; // Consecutive samples past each trigger's level
+uint8_t TRIGGER_FIRED = 0; // Bitmap of triggers that have fired, until their input comes back
+#endif
+
+#ifdef ENABLESCHEDULE
+// Port Schedules
+uint32_t SCHED_LAST = 0; // Minute of the reported time the schedule last ran for, or was set to
+#endif
+
+#ifdef ENABLERULES
+// Rules
+uint8_t RULE_HELD = 0; // Bitmap of rules whose reading is past their level
+uint32_t RULE_START[RULE_CNT]; // CLOCK_Millis() the reading went past the level, or the rule last acted
+#endif
+
+#ifdef ENABLESCRIPT
+// Script VM
+uint8_t SCRIPT_STATE = SCRIPT_STOPPED;
+uint8_t SCRIPT_PC = 0; // Next instruction, or the faulting one
+uint8_t SCRIPT_SP = 0; // Values on the stack
+int16_t SCRIPT_STACK[SCRIPT_STACK_LEN];
+int16_t SCRIPT_VARS[SCRIPT_VAR_CNT];
+uint8_t SCRIPT_WAITING = 0;
+uint32_t SCRIPT_WAKE = 0; // CLOCK_Millis() a WAIT ends
+uint32_t SCRIPT_STEPS = 0; // Instructions run since the script started
+#endif
+
+// Event Set - queued asynchronous port event
+// (Type x4, Port x4)
+typedef uint8_t ev_set;
 
 // Standard file stream for the CDC interface when set up, so that the
 // virtual CDC COM port can be used like any regular character stream
@@ -186,29 +486,142 @@ const char STR_Help_Info[] PROGMEM = "\r\nVisit https://github.com/nigelvh/K7NVH
 	const char STR_Overload[] PROGMEM = " \x1b[31m!OVERLOAD!\x1b[0m";
 	const char STR_VCTL[] PROGMEM = " \x1b[36mVOLTAGE CTL\x1b[0m";
 	const char STR_Locked[] PROGMEM = "\x1b[33mLOCKED\x1b[0m";
+	const char STR_Lockout[] PROGMEM = " \x1b[31mLATCHED OFF\x1b[0m";
+	const char STR_Shed[] PROGMEM = " \x1b[33mSHED\x1b[0m";
 #else
 	const char STR_Unrecognized[] PROGMEM = "\r\nINVALID COMMAND";
 	const char STR_Enabled[] PROGMEM = "ENABLED";
 	const char STR_Disabled[] PROGMEM = "DISABLED";
 	const char STR_Overload[] PROGMEM = " !OVERLOAD!";
 	const char STR_VCTL[] PROGMEM = " VOLTAGE CTL";
+	const char STR_Lockout[] PROGMEM = " LATCHED OFF";
+	const char STR_Shed[] PROGMEM = " SHED";
 #endif	
 
 const char STR_Backspace[] PROGMEM = "\x1b[D \x1b[D";
 const char STR_NR_Port[] PROGMEM = "\r\nPORT ";
 const char STR_Port_Default[] PROGMEM = "\r\nPORT DEFAULT ";
 const char STR_PCYCLE_Time[] PROGMEM = "\r\nPCYCLE TIME: ";
+const char STR_Time[] PROGMEM = "\r\nTIME: ";
+const char STR_Uptime[] PROGMEM = "\r\nUPTIME: ";
 const char STR_Port_Limit[] PROGMEM = "\r\nPORT LIMIT: ";
+const char STR_Port_Retry[] PROGMEM = "\r\nPORT RETRY: ";
 const char STR_Port_CutOff[] PROGMEM = "\r\nPORT CUTOFF: ";
 const char STR_Port_CutOn[] PROGMEM = "\r\nPORT CUTON: ";
 const char STR_Port_VCTL[] PROGMEM = "\r\nPORT VCTL: ";
+const char STR_Port_Debounce[] PROGMEM = "\r\nPORT DEBOUNCE: ";
 const char STR_VREF[] PROGMEM = "\r\nVREF: ";
 const char STR_VCAL[] PROGMEM = "\r\nVCAL: ";
 const char STR_ICAL[] PROGMEM = "\r\nICAL: ";
 const char STR_MAIN[] PROGMEM = "MAIN";
 const char STR_ALT[] PROGMEM = "ALT";
 const char STR_OFFSET[] PROGMEM = "\r\nOFFSET: ";
+const char STR_EXTCAL[] PROGMEM = "\r\nEXTCAL: ";
+const char STR_Sleep[] PROGMEM = "SLEEP: ";
 const char STR_Port_Lock[] PROGMEM = "\r\nPORT LOCK ";
+const char STR_Event[] PROGMEM = "\r\n!EVENT,";
+
+// Optional feature strings
+#ifdef ENABLEBUDGET
+const char STR_Port_Priority[] PROGMEM = "\r\nPORT PRIORITY: ";
+const char STR_Bus_Budget[] PROGMEM = "\r\nBUS BUDGET: ";
+#endif
+#ifdef ENABLEINRUSH
+const char STR_Port_Inrush[] PROGMEM = "\r\nPORT INRUSH: ";
+#endif
+#ifdef ENABLEBATTERY
+const char STR_Bus_Battery[] PROGMEM = "\r\nBUS BATTERY: ";
+#endif
+#ifdef ENABLETRIGGERS
+const char STR_Trigger[] PROGMEM = "\r\nTRIGGER ";
+const char STR_EXT[] PROGMEM = "EXT";
+#endif
+#ifdef ENABLETEMP
+const char STR_Temp[] PROGMEM = "\r\nTEMP: ";
+#endif
+#ifdef ENABLESCHEDULE
+const char STR_Schedule[] PROGMEM = "\r\nSCHEDULE ";
+const char STR_Clock[] PROGMEM = "\r\nCLOCK: ";
+#endif
+#ifdef ENABLERULES
+const char STR_Rule[] PROGMEM = "\r\nRULE ";
+#endif
+#ifdef ENABLESCRIPT
+const char STR_Script[] PROGMEM = "\r\nSCRIPT: ";
+#endif
+#ifdef ENABLEGROUPS
+const char STR_Group[] PROGMEM = "\r\nGROUP ";
+#endif
+#ifdef ENABLEPEAKS
+const char STR_Peaks[] PROGMEM = "\r\nPEAKS: ";
+#endif
+#ifdef ENABLEFAULT
+const char STR_Fault[] PROGMEM = "\r\nFAULT: ";
+#endif
+
+// Event type strings, indexed by EVENT_* type
+const char STR_Event_Overload[] PROGMEM = "OVERLOAD";
+const char STR_Event_VCTL_Off[] PROGMEM = "VCTLOFF";
+const char STR_Event_VCTL_On[] PROGMEM = "VCTLON";
+const char STR_Event_Retry[] PROGMEM = "RETRY";
+const char STR_Event_Cycle[] PROGMEM = "CYCLE";
+const char STR_Event_Lockout[] PROGMEM = "LOCKOUT";
+const char STR_Event_Shed[] PROGMEM = "SHED";
+const char STR_Event_Restore[] PROGMEM = "RESTORE";
+const char STR_Event_Trigger[] PROGMEM = "TRIGGER";
+const char STR_Event_Schedule[] PROGMEM = "SCHEDULE";
+const char STR_Event_Rule[] PROGMEM = "RULE";
+const char STR_Event_Script[] PROGMEM = "SCRIPT";
+PGM_P const STR_Events[] PROGMEM = \
+		{STR_Event_Overload, STR_Event_VCTL_Off, STR_Event_VCTL_On, STR_Event_Retry, STR_Event_Cycle, STR_Event_Lockout, \
+		STR_Event_Shed, STR_Event_Restore, STR_Event_Trigger, STR_Event_Schedule, STR_Event_Rule, STR_Event_Script};
+
+#ifdef ENABLESCRIPT
+// Script state strings, indexed by SCRIPT_*
+const char STR_Script_Stopped[] PROGMEM = "STOPPED";
+const char STR_Script_Running[] PROGMEM = "RUNNING";
+const char STR_Script_Fault[] PROGMEM = "FAULT";
+PGM_P const STR_Script_States[] PROGMEM = {STR_Script_Stopped, STR_Script_Running, STR_Script_Fault};
+#endif
+
+#if defined(ENABLESCHEDULE) || defined(ENABLERULES)
+// Action strings, indexed by ACTION_*
+const char STR_Action_Off[] PROGMEM = "OFF";
+const char STR_Action_On[] PROGMEM = "ON";
+const char STR_Action_Cycle[] PROGMEM = "CYCLE";
+PGM_P const STR_Actions[] PROGMEM = {STR_Action_Off, STR_Action_On, STR_Action_Cycle};
+#endif
+
+#ifdef ENABLERULES
+// Reading strings, indexed by READ_*. Port currents are P<port>.
+const char STR_Read_Current[] PROGMEM = "P";
+const char STR_Read_EXT1[] PROGMEM = "EXT1";
+const char STR_Read_EXT2[] PROGMEM = "EXT2";
+const char STR_Read_Temp[] PROGMEM = "TEMP";
+PGM_P const STR_Readings[] PROGMEM = {STR_Read_Current, STR_MAIN, STR_ALT, STR_Read_EXT1, STR_Read_EXT2, STR_Read_Temp};
+#endif
+
+#ifdef ENABLESCHEDULE
+// Day names and letters from Sunday, for schedules
+const char STR_Days[] PROGMEM = "SUNMONTUEWEDTHUFRISAT";
+const char STR_Day_Letters[] PROGMEM = "SMTWTFS";
+#endif
+
+// Task name strings, indexed by TASK_*, default periods, and run budgets
+#ifdef ENABLETASKS
+const char STR_Task_ICTL[] PROGMEM = "ICTL";
+const char STR_Task_VCTL[] PROGMEM = "VCTL";
+const char STR_Task_IRST[] PROGMEM = "IRST";
+const char STR_Task_INRS[] PROGMEM = "INRS";
+const char STR_Task_SCHD[] PROGMEM = "SCHD";
+const char STR_Task_SCPT[] PROGMEM = "SCPT";
+PGM_P const STR_Tasks[] PROGMEM = {STR_Task_ICTL, STR_Task_VCTL, STR_Task_IRST, STR_Task_INRS, STR_Task_SCHD, STR_Task_SCPT};
+#endif
+const uint32_t TASK_Default_Period[TASK_STORED_CNT] PROGMEM = {ICTL_PERIOD, VCTL_PERIOD, IRST_PERIOD};
+#ifdef ENABLETASKS
+const uint16_t TASK_Budget[TASK_CNT] PROGMEM = {ICTL_BUDGET, VCTL_BUDGET, IRST_BUDGET, INRS_BUDGET, SCHD_BUDGET, SCPT_BUDGET};
+const char STR_Period[] PROGMEM = "\r\nPERIOD ";
+#endif
 
 // Command strings
 const char STR_Command_HELP[] PROGMEM = "HELP";
@@ -227,13 +640,78 @@ const char STR_Command_SETNAME[] PROGMEM = "SETNAME";
 const char STR_Command_SETLIMIT[] PROGMEM = "SETLIMIT";
 const char STR_Command_VCTL[] PROGMEM = "VCTL";
 const char STR_Command_SETVCTL[] PROGMEM = "SETVCTL";
+const char STR_Command_SETDEBOUNCE[] PROGMEM = "SETDEBOUNCE";
 const char STR_Command_SETBUS[] PROGMEM = "SETBUS";
 const char STR_Command_SETOFFSET[] PROGMEM = "SETOFFSET";
+const char STR_Command_SETEXTCAL[] PROGMEM = "SETEXTCAL";
 const char STR_Command_PLOCK[] PROGMEM = "PLOCK";
+const char STR_Command_QUIET[] PROGMEM = "QUIET";
+const char STR_Command_TIME[] PROGMEM = "TIME";
+const char STR_Command_SETTIME[] PROGMEM = "SETTIME";
+#ifdef ENABLETASKS
+const char STR_Command_SETPERIOD[] PROGMEM = "SETPERIOD";
+const char STR_Command_TASKS[] PROGMEM = "TASKS";
+#endif
+#ifdef ENABLERETRY
+const char STR_Command_SETRETRY[] PROGMEM = "SETRETRY";
+#endif
+#ifdef ENABLEJSON
+const char STR_Command_JSTATUS[] PROGMEM = "JSTATUS";
+#endif
+#ifdef ENABLEBUDGET
+const char STR_Command_SETBUDGET[] PROGMEM = "SETBUDGET";
+const char STR_Command_SETPRIORITY[] PROGMEM = "SETPRIORITY";
+#endif
+#ifdef ENABLEINRUSH
+const char STR_Command_SETINRUSH[] PROGMEM = "SETINRUSH";
+const char STR_Command_INRUSH[] PROGMEM = "INRUSH";
+#endif
+#ifdef ENABLEBATTERY
+const char STR_Command_SETBATTERY[] PROGMEM = "SETBATTERY";
+const char STR_Command_BATTERY[] PROGMEM = "BATTERY";
+#endif
+#ifdef ENABLETRIGGERS
+const char STR_Command_SETTRIG[] PROGMEM = "SETTRIG";
+const char STR_Command_TRIGGERS[] PROGMEM = "TRIGGERS";
+#endif
+#ifdef ENABLETEMP
+const char STR_Command_SETTEMP[] PROGMEM = "SETTEMP";
+const char STR_Command_TEMP[] PROGMEM = "TEMP";
+#endif
+#ifdef ENABLESCHEDULE
+const char STR_Command_SETSCHED[] PROGMEM = "SETSCHED";
+const char STR_Command_SCHEDULE[] PROGMEM = "SCHEDULE";
+#endif
+#ifdef ENABLERULES
+const char STR_Command_SETRULE[] PROGMEM = "SETRULE";
+const char STR_Command_RULES[] PROGMEM = "RULES";
+#endif
+#ifdef ENABLESCRIPT
+const char STR_Command_SETSCRIPT[] PROGMEM = "SETSCRIPT";
+const char STR_Command_SCRIPT[] PROGMEM = "SCRIPT";
+#endif
+#ifdef ENABLEGROUPS
+const char STR_Command_SETGROUP[] PROGMEM = "SETGROUP";
+const char STR_Command_GROUPS[] PROGMEM = "GROUPS";
+#endif
+#ifdef ENABLEPEAKS
+const char STR_Command_PEAKS[] PROGMEM = "PEAKS";
+#endif
+#ifdef ENABLEFAULT
+const char STR_Command_FAULT[] PROGMEM = "FAULT";
+#endif
 
-// Port to pin lookup table
-const uint8_t Ports_Pins[PORT_CNT] = \
-		{PD0, PD1, PD2, PD3, PD5, PD4, PD6, PD7, PB4, PB5, PB6, PC6};
+// Port to enable pin lookup tables, as the GPIO port (GPIO_*) and the pin's mask, so a set of
+// ports can be switched with one write per GPIO port
+#define GPIO_D 0
+#define GPIO_B 1
+#define GPIO_C 2
+#define GPIO_CNT 3
+const uint8_t Ports_GPIO[PORT_CNT] = \
+		{GPIO_D, GPIO_D, GPIO_D, GPIO_D, GPIO_D, GPIO_D, GPIO_D, GPIO_D, GPIO_B, GPIO_B, GPIO_B, GPIO_C};
+const uint8_t Ports_Masks[PORT_CNT] = \
+		{(1 << PD0), (1 << PD1), (1 << PD2), (1 << PD3), (1 << PD5), (1 << PD4), (1 << PD6), (1 << PD7), \
+		 (1 << PB4), (1 << PB5), (1 << PB6), (1 << PC6)};
 
 // Port to ADC channel lookup table
 // 1,2,3,4,5,6
@@ -250,7 +728,54 @@ pbs_set PORT_BOOT_STATE[PORT_CNT];
 char * DATA_IN; // Variable to hold input data for parsing
 char * DATA_IN_START; // Variable to hold the *original* position of DATA_IN so we can reset after parsing
 uint8_t DATA_IN_POS = 0;
-uint8_t PORT_HIGH_WATER[PORT_CNT];
+uint8_t RX_BUFF[RX_BUFF_LEN]; // Ring buffer of received bytes waiting to be processed
+uint8_t RX_HEAD = 0;
+uint8_t RX_COUNT = 0;
+uint16_t PORT_PEAK[PORT_CNT]; // mA. Highest current sampled since the peaks were cleared
+#ifdef ENABLEPEAKS
+uint32_t PORT_PEAK_TIME[PORT_CNT]; // CLOCK_Millis() of the peak
+uint16_t PORT_PEAK_VOLTAGE[PORT_CNT]; // Volts*100 on the port's bus at the peak
+uint32_t PEAK_START = 0; // CLOCK_Millis() the peaks were last cleared
+pd_set PEAK_RESTORED = 0; // Ports whose peak was saved before boot, so has no time or voltage
+#endif
+uint8_t PORT_RETRIES[PORT_CNT]; // Overload retries since the port last stayed up
+uint32_t PORT_RETRY_TIME[PORT_CNT]; // CLOCK_Millis() of the next retry, or the end of the window after one
+uint16_t PORT_CURRENT[PORT_CNT]; // mA, as of the last current limit check
+#ifdef ENABLEBUDGET
+uint16_t PORT_SHED_POWER[PORT_CNT]; // Watts*10 a shed port was drawing, needed back to restore it
+#endif
+#ifdef ENABLEINRUSH
+uint16_t PORT_ON_TIME[PORT_CNT]; // Low 16 bits of CLOCK_Millis() when the port was last turned on
+uint16_t PORT_INRUSH_PEAK[PORT_CNT]; // mA. Highest current seen in the last inrush capture
+uint16_t PORT_INRUSH_SETTLE[PORT_CNT]; // ms from turn on to settling, or INRUSH_UNSETTLED
+uint16_t PORT_INRUSH_LAST[PORT_CNT]; // mA. Previous capture sample
+#endif
+#ifdef ENABLEFAULT
+uint8_t FAULT_RING[FAULT_RING_CNT]; // Deci-amps. Rolling samples of the enabled ports
+uint8_t FAULT_RING_PORT[FAULT_RING_CNT]; // Port of each sample, or FAULT_NONE
+uint16_t FAULT_RING_TIME[FAULT_RING_CNT]; // Low 16 bits of CLOCK_Millis() of each sample
+uint8_t FAULT_RING_HEAD = 0; // Next sample to write
+uint8_t FAULT_PORT = FAULT_NONE; // Port of the frozen capture
+uint32_t FAULT_TIME; // CLOCK_Millis() of the trip
+uint8_t FAULT_SAMPLES[FAULT_PRE + FAULT_POST]; // Deci-amps, oldest first
+int16_t FAULT_SAMPLE_TIME[FAULT_PRE + FAULT_POST]; // ms from the trip
+uint8_t FAULT_COUNT = 0; // Samples in the capture
+uint8_t FAULT_POST_LEFT = 0; // Samples still to take after the trip
+#endif
+uint16_t PORT_CUTOFF[PORT_CNT]; // Volts*100. RAM copies of the voltage control settings
+uint16_t PORT_CUTON[PORT_CNT];
+uint8_t PORT_VCTL_OFF_COUNT[PORT_CNT];
+uint8_t PORT_VCTL_ON_COUNT[PORT_CNT];
+uint8_t PORT_VCTL_SAMPLES[PORT_CNT]; // Consecutive VCTL samples past the threshold
+char PDU_NAME[16]; // RAM copy of the PDU name, so the prompt doesn't read EEPROM every time
+uint8_t SESSION_QUIET = 0; // Quiet mode - no echo, prompt, or colors. Responses end with QUIET_DELIM.
+ev_set EVENT_QUEUE[EVENT_QUEUE_LEN]; // Ring buffer of events waiting to be reported
+uint32_t EVENT_TIME[EVENT_QUEUE_LEN]; // CLOCK_Millis() when each event was queued
+uint8_t EVENT_HEAD = 0;
+uint8_t EVENT_COUNT = 0;
+uint8_t EVENT_NOTIFY_PENDING = 0; // Events have been queued since the last SerialState notification
+uint8_t EVENT_NOTIFY_STAGE = 0; // 1 once a notification's header has been sent, and its lines are due
+uint16_t EVENT_NOTIFY_LINES; // Lines being sent
 
 uint8_t BOOT_RESET_VECTOR = 0;
 
@@ -299,13 +824,75 @@ static inline void run_lufa(void);
 
 // LED & Port Control
 static inline void LED_CTL(uint8_t led, uint8_t state);
-static inline void PORT_CTL(uint8_t port, uint8_t state);
+static inline void PORT_Write(uint8_t port, uint8_t state);
+static inline void PORT_Write_Set(pd_set ports, uint8_t state);
+static inline void PORT_Release(uint8_t port);
 static inline void PORT_Set_Ctl(pd_set *pd, uint8_t state);
+static inline void PORT_Action(uint8_t action, pd_set ports, uint8_t event);
 
 // Check Limits
 static inline void Check_Current_Limits(void);
+static inline void PORT_Overload(uint8_t port);
 static inline uint8_t PORT_Check_Current_Limit(uint8_t port);
+static inline void PORT_Peak(uint8_t port, uint16_t current);
+static inline void PORT_Retry_Schedule(uint8_t port);
+static inline void VCTL_Load(void);
 static inline void Check_Voltage_Cutoff(void);
+static inline int32_t READ_Value(uint8_t reading, uint8_t port);
+static inline void Retry_Overloaded_Ports(void);
+#ifdef ENABLEINRUSH
+static inline uint8_t PORT_In_Inrush(uint8_t port);
+static inline void Check_Inrush(void);
+#endif
+#ifdef ENABLEPEAKS
+static inline void PORT_Clear_Peaks(void);
+#endif
+#ifdef ENABLEFAULT
+static inline uint8_t FAULT_Deciamps(uint16_t current);
+static inline void FAULT_Sample(uint8_t port, uint16_t current);
+static inline void FAULT_Trigger(uint8_t port);
+static inline void FAULT_Forget(uint8_t port);
+static inline void Check_Fault_Capture(void);
+#endif
+#ifdef ENABLEBUDGET
+static inline void Check_Power_Budget(void);
+static inline uint8_t VCTL_Past_Cutoff(uint8_t port);
+#endif
+#ifdef ENABLEBATTERY
+static inline void Check_Battery(void);
+#endif
+#ifdef ENABLETRIGGERS
+static inline void Check_Triggers(void);
+#endif
+#ifdef ENABLETEMP
+static inline void Check_Temperature(void);
+#endif
+#ifdef ENABLESCHEDULE
+static inline void Check_Schedule(void);
+#endif
+#ifdef ENABLERULES
+static inline void Check_Rules(void);
+#endif
+
+// Tasks
+static inline void TASK_Init(void);
+static inline void TASK_Set_Period(uint8_t task, uint32_t period);
+static inline void SCHED_Align(void);
+static inline void TASK_Run(uint8_t task);
+static inline void TASK_Yield(void);
+
+// Events
+static inline void EVENT_Queue(uint8_t type, uint8_t port);
+static inline void EVENT_Flush(void);
+static inline void EVENT_Notify(void);
+
+// Clock
+static inline void CLOCK_Read(uint32_t *seconds, uint16_t *ms);
+static inline uint32_t CLOCK_Millis(void);
+static inline void CLOCK_Read_Time(uint32_t *seconds, uint16_t *ms);
+static inline void CLOCK_Set(uint32_t seconds, uint16_t ms);
+static inline void CLOCK_Print_Time(uint32_t *at);
+static inline uint32_t CLOCK_Counts(void);
 
 // EEPROM Read & Write
 static inline uint8_t EEPROM_Read_Port_Boot_State(uint8_t port);
@@ -320,6 +907,24 @@ static inline float EEPROM_Read_I_CAL(uint8_t port);
 static inline void EEPROM_Write_I_CAL(uint8_t port, float cal);
 static inline uint8_t EEPROM_Read_PCycle_Time(void);
 static inline void EEPROM_Write_PCycle_Time(uint8_t time);
+static inline uint32_t EEPROM_Read_Task_Period(uint8_t task);
+static inline void EEPROM_Write_Task_Period(uint8_t task, uint32_t period);
+static inline uint16_t EEPROM_Read_Retry_Delay(uint8_t port);
+static inline void EEPROM_Write_Retry_Delay(uint8_t port, uint16_t delay);
+static inline uint8_t EEPROM_Read_Retry_Attempts(uint8_t port);
+static inline void EEPROM_Write_Retry_Attempts(uint8_t port, uint8_t attempts);
+static inline uint16_t EEPROM_Read_Retry_Window(uint8_t port);
+static inline void EEPROM_Write_Retry_Window(uint8_t port, uint16_t window);
+static inline uint16_t EEPROM_Read_Bus_Budget(uint8_t bus);
+static inline void EEPROM_Write_Bus_Budget(uint8_t bus, uint16_t budget);
+static inline uint16_t EEPROM_Read_Battery(uint8_t bus, uint8_t field);
+static inline void EEPROM_Write_Battery(uint8_t bus, uint8_t field, uint16_t value);
+static inline uint8_t EEPROM_Read_Port_Priority(uint8_t port);
+static inline void EEPROM_Write_Port_Priority(uint8_t port, uint8_t priority);
+static inline uint16_t EEPROM_Read_Inrush_Window(uint8_t port);
+static inline void EEPROM_Write_Inrush_Window(uint8_t port, uint16_t window);
+static inline uint8_t EEPROM_Read_Inrush_Limit(uint8_t port);
+static inline void EEPROM_Write_Inrush_Limit(uint8_t port, uint8_t limit);
 static inline void EEPROM_Read_Port_Name(int8_t port, char *str);
 static inline void EEPROM_Write_Port_Name(int8_t port, char *str);
 static inline uint8_t EEPROM_Read_Port_Limit(uint8_t port);
@@ -328,6 +933,33 @@ static inline float EEPROM_Read_Port_CutOff(uint8_t port);
 static inline void EEPROM_Write_Port_CutOff(uint8_t port, uint16_t cutoff);
 static inline float EEPROM_Read_Port_CutOn(uint8_t port);
 static inline void EEPROM_Write_Port_CutOn(uint8_t port, uint16_t cuton);
+static inline uint16_t EEPROM_Read_Port_CutOff_SoC(uint8_t port);
+static inline uint16_t EEPROM_Read_Port_CutOn_SoC(uint8_t port);
+static inline uint8_t EEPROM_Read_VCTL_Off_Count(uint8_t port);
+static inline void EEPROM_Write_VCTL_Off_Count(uint8_t port, uint8_t count);
+static inline uint8_t EEPROM_Read_VCTL_On_Count(uint8_t port);
+static inline void EEPROM_Write_VCTL_On_Count(uint8_t port, uint8_t count);
+static inline float EEPROM_Read_EXT_CAL(uint8_t ext);
+static inline void EEPROM_Write_EXT_CAL(uint8_t ext, float div);
+static inline uint8_t EEPROM_Read_Temp(uint8_t setting);
+static inline void EEPROM_Write_Temp(uint8_t setting, uint8_t temp);
+static inline uint8_t EEPROM_Read_Trigger(uint8_t trigger, uint8_t *flags, uint16_t *level, uint8_t *count);
+static inline void EEPROM_Write_Trigger(uint8_t trigger, uint8_t port, uint8_t flags, uint16_t level, uint8_t count);
+static inline uint8_t EEPROM_Read_Schedule(uint8_t entry, uint8_t *days, uint16_t *minute, pd_set *ports);
+static inline void EEPROM_Write_Schedule(uint8_t entry, uint8_t action, uint8_t days, uint16_t minute, pd_set ports);
+static inline uint8_t EEPROM_Read_Rule(uint8_t rule, uint8_t *flags, int16_t *level, uint16_t *seconds, uint8_t *action, pd_set *ports);
+static inline uint8_t EEPROM_Read_Script_Auto(void);
+static inline void EEPROM_Write_Script_Auto(uint8_t autorun);
+static inline void EEPROM_Write_Script(uint8_t offset, uint8_t *code, uint8_t len);
+static inline void EEPROM_Write_Rule(uint8_t rule, uint8_t reading, uint8_t flags, int16_t level, uint16_t seconds, uint8_t action, pd_set ports);
+static inline pd_set EEPROM_Read_Group(uint8_t group, char *name);
+static inline void EEPROM_Write_Group(uint8_t group, char *name, uint8_t len, pd_set ports);
+static inline uint8_t EEPROM_Read_Peak_Save(void);
+static inline void EEPROM_Write_Peak_Save(uint8_t save);
+#ifdef ENABLEPEAKS
+static inline void EEPROM_Read_Peaks(void);
+static inline void EEPROM_Write_Peaks(void);
+#endif
 static inline uint8_t EEPROM_Read_I_Offset(uint8_t port);
 static inline void EEPROM_Write_I_Offset(uint8_t port, uint8_t offset);
 static inline void EEPROM_Reset(void);
@@ -339,7 +971,9 @@ static inline void DEBUG_Dump(void);
 static inline float ADC_Read_Port_Current(uint8_t port);
 static inline float ADC_Read_Main_Voltage(void);
 static inline float ADC_Read_Alt_Voltage(void);
+static inline float BUS_Read_Voltage(uint8_t bus);
 static inline float ADC_Read_EXT_Voltage(uint8_t ext);
+static inline void ADC_Init_Temperature(void);
 static inline int16_t ADC_Read_Temperature(void);
 static inline uint16_t ADC_Read_Raw(uint8_t adc);
 
@@ -347,13 +981,77 @@ static inline uint16_t ADC_Read_Raw(uint8_t adc);
 static inline void printPGMStr(PGM_P s);
 static inline void PRINT_Status(void);
 static inline void PRINT_Status_Prog(void);
+#ifdef ENABLETASKS
+static inline void PRINT_Tasks(void);
+#endif
+static inline void PRINT_Ports(pd_set ports);
 static inline void PRINT_Help(void);
+#ifdef ENABLEJSON
+static inline void PRINT_Status_JSON(void);
+static inline void PRINT_JSON_Str(char *str);
+#endif
+#ifdef ENABLEINRUSH
+static inline void PRINT_Inrush(void);
+#endif
+#ifdef ENABLEBATTERY
+static inline void PRINT_Battery(void);
+#endif
+#ifdef ENABLETRIGGERS
+static inline void PRINT_Triggers(void);
+#endif
+#ifdef ENABLETEMP
+static inline void PRINT_Temperature(void);
+#endif
+#ifdef ENABLESCHEDULE
+static inline void PRINT_Schedule(void);
+static inline void PRINT_Schedule_Entry(uint8_t entry);
+#endif
+#ifdef ENABLERULES
+static inline void PRINT_Rule(uint8_t rule);
+#endif
+#ifdef ENABLESCRIPT
+static inline void PRINT_Script(void);
+#endif
+#ifdef ENABLEGROUPS
+static inline void PRINT_Group(uint8_t group);
+#endif
+#ifdef ENABLEPEAKS
+static inline void PRINT_Peaks(void);
+#endif
+#ifdef ENABLEFAULT
+static inline void PRINT_Fault(void);
+#endif
 
 // Input
+static inline void INPUT_Receive(void);
+static inline uint8_t INPUT_Read(void);
 static inline void INPUT_Clear(void);
 static inline void INPUT_Parse(void);
 static inline void INPUT_Parse_args(pd_set *pd, char *str);
 static inline int8_t INPUT_Parse_port(void);
+static inline uint8_t INPUT_Name_Char(char c);
+#if defined(ENABLESCHEDULE) || defined(ENABLERULES)
+static inline uint8_t INPUT_Parse_action(void);
+#endif
+#ifdef ENABLESCRIPT
+static inline int8_t INPUT_Hex_Digit(char c);
+#endif
+#ifdef ENABLEGROUPS
+static inline int8_t INPUT_Find_Group(char *name, uint8_t len);
+#endif
+
+#ifdef ENABLESCRIPT
+// Script
+static inline void SCRIPT_Start(void);
+static inline void SCRIPT_Run(void);
+static inline uint8_t SCRIPT_Fetch(void);
+static inline void SCRIPT_Push(int16_t value);
+static inline int16_t SCRIPT_Pop(void);
+#endif
+
+// Power
+static inline void POWER_Init(void);
+static inline void POWER_Idle(void);
 
 // Watchdog
 static inline void Watchdog_Disable(void);
@@ -0,0 +1,48 @@
+# Build the firmware with avr-gcc, as configured in K7NVH_PoE_PDU.h, and check that it fits
+# the ATmega32u4. Run by ctest as:
+#   cmake -DFIRMWARE_DIR=<dir> -DAVR_SIZE=<avr-size> -P FirmwareSize.cmake
+#
+# Program must fit below the bootloader at word 0x3800, and Data (.data and .bss) must leave
+# STACK_RESERVE bytes of the 2.5KB of SRAM for the heap and stack. DEBUG reports how much of
+# that the stack has never used.
+set(FLASH_MAX 28672)
+set(SRAM_MAX 2560)
+set(STACK_RESERVE 512)
+
+execute_process(
+	COMMAND make elf
+	WORKING_DIRECTORY "${FIRMWARE_DIR}"
+	RESULT_VARIABLE result
+)
+if(NOT result EQUAL 0)
+	message(FATAL_ERROR "Firmware build failed")
+endif()
+
+execute_process(
+	COMMAND "${AVR_SIZE}" -C --mcu=atmega32u4 K7NVH_PoE_PDU.elf
+	WORKING_DIRECTORY "${FIRMWARE_DIR}"
+	OUTPUT_VARIABLE size
+	RESULT_VARIABLE result
+)
+if(NOT result EQUAL 0)
+	message(FATAL_ERROR "avr-size failed")
+endif()
+message("${size}")
+
+string(REGEX MATCH "Program: *([0-9]+) bytes" match "${size}")
+set(program "${CMAKE_MATCH_1}")
+string(REGEX MATCH "Data: *([0-9]+) bytes" match "${size}")
+set(data "${CMAKE_MATCH_1}")
+if(program STREQUAL "" OR data STREQUAL "")
+	message(FATAL_ERROR "Couldn't read Program and Data from avr-size")
+endif()
+
+math(EXPR data_max "${SRAM_MAX} - ${STACK_RESERVE}")
+if(program GREATER FLASH_MAX)
+	message(FATAL_ERROR "Program is ${program} bytes, over the ${FLASH_MAX} below the bootloader")
+endif()
+if(data GREATER data_max)
+	message(FATAL_ERROR "Data is ${data} bytes, leaving under ${STACK_RESERVE} bytes for the stack")
+endif()
+math(EXPR headroom "${SRAM_MAX} - ${data}")
+message("Fits: ${program} of ${FLASH_MAX} bytes flash, ${headroom} bytes of SRAM left for the heap and stack")
@@ -0,0 +1,556 @@
+/* (c) 2017 Nigel Vander Houwen */
+//
+// Host HAL implementation for the fake PDU. The firmware's console is served on a
+// pseudo terminal, EEPROM is a 1KB image (optionally persisted to a file), Timer 1
+// compare interrupts are generated from the host monotonic clock, and the two MCP3208
+// ADCs are emulated bit by bit behind the firmware's software SPI.
+//
+// The simulated loads and bus voltages are read from the environment at startup, and
+// from $FAKEPDU_CONTROL whenever that file changes, as "key=value" lines:
+//   load=0.10,0.25,...   Per port current draw in amps while the port is enabled
+//   inrush=2.0,50        Extra current in amps when a port turns on, falling away
+//                        linearly over the given ms
+//   main=24.0            MAIN bus voltage
+//   alt=12.0             ALT bus voltage
+//   ext1=0.0, ext2=0.0   EXT input voltages
+//   temp=25              Die temperature in C
+// The environment variables are FAKEPDU_LOAD, FAKEPDU_MAIN and so on.
+//
+// Other environment variables:
+//   FAKEPDU_EEPROM       File to persist the EEPROM image in
+//   FAKEPDU_LINK         Symlink to create pointing at the pty, e.g. /tmp/ttyPDU0
+//   FAKEPDU_VERBOSE      Log SerialState notifications to stderr
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+#include "fakepdu_hal.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <LUFA/Drivers/USB/USB.h>
+
+#define FAKEPDU_PORTS 12
+#define FAKEPDU_VREF 4.2 // Nominal ADC reference
+#define FAKEPDU_VCAL 15.0 // Nominal bus voltage divider
+#define FAKEPDU_ICAL 50.0 // Nominal current sense gain
+#define FAKEPDU_RSENSE 0.02 // Current sense resistor
+#define FAKEPDU_TIMER_US 8 // Timer 1 count period, F_CPU 1MHz with a /8 prescaler
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~ Registers
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+volatile uint8_t PORTB, PORTC, PORTD, PORTF, DDRB, DDRC, DDRD, DDRF, PINC, PIND, PINF;
+volatile uint8_t MCUSR, WDTCSR, SREG, SMCR, PRR0, PRR1, GPIOR0;
+volatile uint8_t TCCR0A, TCCR0B, TCNT0, OCR0A, TIMSK0, TIFR0;
+volatile uint8_t TCCR1A, TCCR1B, TCCR1C, TIMSK1, TIFR1;
+volatile uint16_t OCR1A, OCR1B;
+volatile uint8_t TCCR3A, TCCR3B, TIMSK3, TIFR3;
+volatile uint16_t TCNT3;
+volatile uint8_t ADMUX, ADCSRB, DIDR0, DIDR2, ACSR;
+volatile uint16_t ADCW;
+
+volatile uint8_t USB_DeviceState;
+FILE *fakepdu_stream_ptr;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~ State
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+static int pty_fd = -1;
+static int pty_slave_fd = -1;
+static USB_ClassInfo_CDC_Device_t *cdc_interface;
+static speed_t cdc_speed;
+
+static uint8_t eeprom[E2END + 1];
+static int eeprom_fd = -1;
+
+static uint64_t timer1_match_us; // Time of the last Timer 1 compare match
+static volatile uint8_t adcsra;
+static volatile uint16_t tcnt1;
+
+// Software SPI state for the emulated MCP3208s
+static int8_t spi_chip = -1;
+static uint8_t spi_clock;
+static uint8_t spi_channel;
+static uint16_t spi_value;
+
+// Simulated world
+static double sim_load[FAKEPDU_PORTS];
+static double sim_main = 24.0;
+static double sim_alt = 12.0;
+static double sim_ext[2];
+static double sim_temp = 25;
+static double sim_inrush;
+static double sim_inrush_ms;
+static uint8_t sim_port_was_on[FAKEPDU_PORTS];
+static uint64_t sim_port_on_us[FAKEPDU_PORTS];
+static const char *sim_control_path;
+static struct timespec sim_control_mtime;
+
+// Port to enable pin, matching Ports_Masks in the firmware. Ports 1-8 are on PORTD,
+// 9-11 on PORTB, and 12 on PORTC.
+static const uint8_t port_pins[FAKEPDU_PORTS] = {0, 1, 2, 3, 5, 4, 6, 7, 4, 5, 6, 6};
+
+// Weak defaults for LUFA events the firmware may not handle
+__attribute__((weak)) void EVENT_USB_Device_Connect(void) {}
+__attribute__((weak)) void EVENT_USB_Device_ConfigurationChanged(void) {}
+__attribute__((weak)) void EVENT_CDC_Device_LineEncodingChanged(USB_ClassInfo_CDC_Device_t* const CDCInterfaceInfo) { (void)CDCInterfaceInfo; }
+__attribute__((weak)) void EVENT_CDC_Device_ControLineStateChanged(USB_ClassInfo_CDC_Device_t* const CDCInterfaceInfo) { (void)CDCInterfaceInfo; }
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~ Simulation
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+static uint64_t now_us(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Apply a single "key=value" simulation setting
+static void sim_set(const char *key, const char *value) {
+	if (strcmp(key, "load") == 0) {
+		for (uint8_t i = 0; i < FAKEPDU_PORTS; i++) {
+			char *end;
+			double load = strtod(value, &end);
+			if (end == value) break;
+			sim_load[i] = load;
+			value = (*end == ',') ? end + 1 : end;
+		}
+	} else if (strcmp(key, "inrush") == 0) {
+		char *end;
+		sim_inrush = strtod(value, &end);
+		sim_inrush_ms = (*end == ',') ? atof(end + 1) : 0;
+	} else if (strcmp(key, "main") == 0) {
+		sim_main = atof(value);
+	} else if (strcmp(key, "alt") == 0) {
+		sim_alt = atof(value);
+	} else if (strcmp(key, "ext1") == 0) {
+		sim_ext[0] = atof(value);
+	} else if (strcmp(key, "ext2") == 0) {
+		sim_ext[1] = atof(value);
+	} else if (strcmp(key, "temp") == 0) {
+		sim_temp = atof(value);
+	}
+}
+
+// Re-read the control file if it has changed since we last looked
+static void sim_poll_control(void) {
+	struct stat st;
+	char line[256];
+
+	if (sim_control_path == NULL || stat(sim_control_path, &st) != 0) return;
+	if (st.st_mtim.tv_sec == sim_control_mtime.tv_sec && st.st_mtim.tv_nsec == sim_control_mtime.tv_nsec) return;
+	sim_control_mtime = st.st_mtim;
+
+	FILE *f = fopen(sim_control_path, "r");
+	if (f == NULL) return;
+	while (fgets(line, sizeof(line), f) != NULL) {
+		char *eq = strchr(line, '=');
+		if (eq == NULL) continue;
+		*eq = 0;
+		line[strcspn(line, " \t")] = 0;
+		eq[1 + strcspn(eq + 1, "\r\n")] = 0;
+		sim_set(line, eq + 1);
+	}
+	fclose(f);
+}
+
+static uint8_t sim_port_enabled(uint8_t port) {
+	if (port < 8) return (PORTD >> port_pins[port]) & 1;
+	if (port < 11) return (PORTB >> port_pins[port]) & 1;
+	return (PORTC >> port_pins[port]) & 1;
+}
+
+// 10 bit reading for a channel, as the firmware sees it (the top bits of the 12 bit result)
+static uint16_t sim_adc(uint8_t chip, uint8_t channel) {
+	const double lsb = FAKEPDU_VREF / 1024;
+	double counts;
+
+	// Note when ports come on, for the inrush model
+	uint64_t now = now_us();
+	for (uint8_t i = 0; i < FAKEPDU_PORTS; i++) {
+		uint8_t on = sim_port_enabled(i);
+		if (on && !sim_port_was_on[i]) sim_port_on_us[i] = now;
+		sim_port_was_on[i] = on;
+	}
+
+	if (channel < 6) {
+		uint8_t port = chip * 6 + channel;
+		double current = sim_port_enabled(port) ? sim_load[port] : 0;
+		double since_ms = (now - sim_port_on_us[port]) / 1000.0;
+		if (current > 0 && since_ms < sim_inrush_ms) current += sim_inrush * (1 - since_ms / sim_inrush_ms);
+		counts = current * FAKEPDU_RSENSE * FAKEPDU_ICAL / lsb;
+	} else if (chip == 0) {
+		counts = ((channel == 6) ? sim_main : sim_alt) / FAKEPDU_VCAL / lsb;
+	} else {
+		counts = sim_ext[channel - 6] / lsb;
+	}
+
+	if (counts < 0) counts = 0;
+	if (counts > 1023) counts = 1023;
+	return (uint16_t)(counts + 0.5);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~ Register Side Effects
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// Timer 1 period in microseconds, CTC mode clearing at OCR1A
+static uint64_t timer1_period_us(void) {
+	return ((uint64_t)OCR1A + 1) * FAKEPDU_TIMER_US;
+}
+
+// Finish a conversion. Only the temperature sensor is wired up, at 1 count per degree from 273.
+static void adc_complete(void) {
+	adcsra &= ~(1 << ADSC);
+	adcsra |= (1 << ADIF);
+	ADCW = (uint16_t)(273 + sim_temp);
+}
+
+// Deliver a conversion started with the ADC interrupt enabled
+static void adc_run(void) {
+	if ((adcsra & (1 << ADSC)) && (adcsra & (1 << ADIE))) {
+		adc_complete();
+		ADC_vect();
+	}
+}
+
+// Deliver any Timer 1 compare matches that have come due
+static void timer1_run(void) {
+	uint64_t now = now_us();
+
+	if (OCR1A == 0 || !(TCCR1B & 0b00000111)) {
+		timer1_match_us = now;
+		return;
+	}
+	while (now - timer1_match_us >= timer1_period_us()) {
+		timer1_match_us += timer1_period_us();
+		if (TIMSK1 & (1 << OCIE1A)) {
+			TIMER1_COMPA_vect();
+		} else {
+			TIFR1 |= (1 << OCF1A);
+		}
+		adc_run();
+	}
+}
+
+volatile uint16_t *fakepdu_tcnt1(void) {
+	uint64_t elapsed = now_us() - timer1_match_us;
+
+	// A match that hasn't been delivered yet shows up as a pending flag, as on the chip
+	if (elapsed >= timer1_period_us()) {
+		TIFR1 |= (1 << OCF1A);
+		elapsed -= timer1_period_us();
+	}
+	tcnt1 = elapsed / FAKEPDU_TIMER_US;
+	if (tcnt1 > OCR1A) tcnt1 = OCR1A;
+	return &tcnt1;
+}
+
+// Polled conversions complete as soon as the firmware looks at ADCSRA again. Those with
+// the interrupt enabled are delivered with the timer interrupts.
+volatile uint8_t *fakepdu_adcsra(void) {
+	if ((adcsra & (1 << ADSC)) && !(adcsra & (1 << ADIE))) adc_complete();
+	return &adcsra;
+}
+
+// MISO for the bit being clocked. The firmware raises SCK and then samples PINB, so each
+// read is one SPI clock. Transactions are always three bytes: start bit, then single
+// ended mode and the channel number, then the result clocked out from the 15th clock.
+uint8_t fakepdu_pinb(void) {
+	int8_t chip = -1;
+	uint8_t miso = 0;
+
+	if (!(PORTB & (1 << PB0))) chip = 0;
+	else if (!(PORTB & (1 << PB7))) chip = 1;
+	if (chip < 0) return 0;
+
+	if (chip != spi_chip) {
+		spi_chip = chip;
+		spi_clock = 0;
+	}
+	spi_clock++;
+
+	if (spi_clock >= 10 && spi_clock <= 12) {
+		spi_channel = (spi_channel << 1) | ((PORTB >> PB2) & 1);
+		if (spi_clock == 12) spi_value = sim_adc(chip, spi_channel & 0x07);
+	}
+	if (spi_clock >= 15) miso = (spi_value >> (24 - spi_clock)) & 1;
+	if (spi_clock == 24) {
+		spi_clock = 0;
+		spi_channel = 0;
+	}
+
+	return miso << PB3;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~ EEPROM
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+uint8_t fakepdu_eeprom_read(uintptr_t addr) {
+	return eeprom[addr & E2END];
+}
+
+void fakepdu_eeprom_write(uintptr_t addr, uint8_t value) {
+	addr &= E2END;
+	if (eeprom[addr] == value) return;
+	eeprom[addr] = value;
+	if (eeprom_fd >= 0 && pwrite(eeprom_fd, &value, 1, addr) != 1) perror("fakepdu: eeprom");
+}
+
+void fakepdu_eeprom_read_block(void *dst, uintptr_t addr, size_t len) {
+	for (size_t i = 0; i < len; i++) ((uint8_t *)dst)[i] = fakepdu_eeprom_read(addr + i);
+}
+
+void fakepdu_eeprom_write_block(const void *src, uintptr_t addr, size_t len) {
+	for (size_t i = 0; i < len; i++) fakepdu_eeprom_write(addr + i, ((const uint8_t *)src)[i]);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~ USB CDC on a pseudo terminal
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+static uint32_t speed_to_baud(speed_t speed) {
+	static const struct { speed_t speed; uint32_t baud; } speeds[] = {
+		{B1200, 1200}, {B2400, 2400}, {B4800, 4800}, {B9600, 9600}, {B19200, 19200},
+		{B38400, 38400}, {B57600, 57600}, {B115200, 115200}, {B230400, 230400},
+	};
+	for (size_t i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++) {
+		if (speeds[i].speed == speed) return speeds[i].baud;
+	}
+	return 9600;
+}
+
+// Pick up baud rate changes made by the client, as a line coding request would
+static void cdc_poll_line_coding(void) {
+	struct termios tio;
+
+	if (cdc_interface == NULL || tcgetattr(pty_fd, &tio) != 0) return;
+	if (cfgetospeed(&tio) == cdc_speed) return;
+	cdc_speed = cfgetospeed(&tio);
+	cdc_interface->State.LineEncoding.BaudRateBPS = speed_to_baud(cdc_speed);
+	EVENT_CDC_Device_LineEncodingChanged(cdc_interface);
+}
+
+static void cdc_flush(void) {
+	if (fakepdu_stream_ptr == NULL) return;
+	fflush(fakepdu_stream_ptr);
+	// With nobody reading, output is dropped rather than blocking, as with an unconnected USB host
+	clearerr(fakepdu_stream_ptr);
+}
+
+void USB_Init(void) {
+	USB_DeviceState = DEVICE_STATE_Configured;
+	EVENT_USB_Device_Connect();
+	EVENT_USB_Device_ConfigurationChanged();
+}
+
+void USB_USBTask(void) {
+	timer1_run();
+	sim_poll_control();
+	cdc_poll_line_coding();
+	cdc_flush();
+}
+
+bool CDC_Device_ConfigureEndpoints(USB_ClassInfo_CDC_Device_t* const CDCInterfaceInfo) {
+	cdc_interface = CDCInterfaceInfo;
+	cdc_interface->State.LineEncoding.BaudRateBPS = 9600;
+	cdc_speed = B9600;
+	return true;
+}
+
+void CDC_Device_ProcessControlRequest(USB_ClassInfo_CDC_Device_t* const CDCInterfaceInfo) {
+	(void)CDCInterfaceInfo;
+}
+
+void CDC_Device_USBTask(USB_ClassInfo_CDC_Device_t* const CDCInterfaceInfo) {
+	(void)CDCInterfaceInfo;
+	cdc_flush();
+}
+
+uint8_t CDC_Device_SendByte(USB_ClassInfo_CDC_Device_t* const CDCInterfaceInfo, const uint8_t Data) {
+	(void)CDCInterfaceInfo;
+	fputc(Data, fakepdu_stream_ptr);
+	return 0;
+}
+
+// Like the real endpoint, report at most one bank's worth of bytes at a time
+uint16_t CDC_Device_BytesReceived(USB_ClassInfo_CDC_Device_t* const CDCInterfaceInfo) {
+	int available = 0;
+
+	(void)CDCInterfaceInfo;
+	if (ioctl(pty_fd, FIONREAD, &available) != 0 || available < 0) return 0;
+	return (available > 16) ? 16 : available;
+}
+
+int16_t CDC_Device_ReceiveByte(USB_ClassInfo_CDC_Device_t* const CDCInterfaceInfo) {
+	uint8_t byte;
+
+	(void)CDCInterfaceInfo;
+	timer1_run();
+	if (read(pty_fd, &byte, 1) != 1) return -1;
+	return byte;
+}
+
+uint8_t CDC_Device_Flush(USB_ClassInfo_CDC_Device_t* const CDCInterfaceInfo) {
+	(void)CDCInterfaceInfo;
+	cdc_flush();
+	return 0;
+}
+
+// Only the notification endpoint is written directly. Its packets are always taken at once,
+// and a pty has no modem status lines, so SerialState notifications can only be logged.
+static uint8_t endpoint_selected;
+static uint8_t endpoint_packet[8];
+static uint8_t endpoint_packet_len;
+
+uint8_t Endpoint_GetCurrentEndpoint(void) {
+	return endpoint_selected;
+}
+
+void Endpoint_SelectEndpoint(const uint8_t Address) {
+	endpoint_selected = Address;
+}
+
+bool Endpoint_IsINReady(void) {
+	return true;
+}
+
+void Endpoint_Write_8(const uint8_t Data) {
+	if (endpoint_packet_len < sizeof(endpoint_packet)) endpoint_packet[endpoint_packet_len++] = Data;
+}
+
+void Endpoint_Write_16_LE(const uint16_t Data) {
+	Endpoint_Write_8(Data & 0xFF);
+	Endpoint_Write_8(Data >> 8);
+}
+
+void Endpoint_ClearIN(void) {
+	// The SerialState data packet is the two line bytes that follow the request header
+	if (endpoint_packet_len == 2 && getenv("FAKEPDU_VERBOSE") != NULL) {
+		fprintf(stderr, "fakepdu: SerialState 0x%02x\n", endpoint_packet[0]);
+	}
+	endpoint_packet_len = 0;
+}
+
+// There are no descriptors behind a pty, so the name string can only be logged
+void USB_Set_Name_String(const char *name) {
+	if (getenv("FAKEPDU_VERBOSE") != NULL) fprintf(stderr, "fakepdu: name string \"%s\"\n", name);
+}
+
+void CDC_Device_CreateStream(USB_ClassInfo_CDC_Device_t* const CDCInterfaceInfo, FILE* const Stream) {
+	(void)CDCInterfaceInfo;
+	(void)Stream;
+	// The firmware's stream is redirected to fakepdu_stream_ptr, opened at startup
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~ Power and Reset
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// Idle until there is console input or the next timer tick is due
+void fakepdu_sleep(void) {
+	struct pollfd pfd = {.fd = pty_fd, .events = POLLIN};
+	uint64_t now = now_us();
+	uint64_t due = timer1_match_us + timer1_period_us();
+	int timeout = (due > now) ? (int)((due - now + 999) / 1000) : 0;
+
+	cdc_flush();
+	poll(&pfd, 1, timeout);
+	timer1_run();
+}
+
+void fakepdu_bootloader(void) {
+	cdc_flush();
+	exit(0);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~ Startup
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+static void hal_load_environment(void) {
+	static const char *keys[] = {"load", "inrush", "main", "alt", "ext1", "ext2", "temp"};
+	char name[32];
+
+	for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+		snprintf(name, sizeof(name), "FAKEPDU_%s", keys[i]);
+		for (char *c = name; *c; c++) *c = (*c >= 'a' && *c <= 'z') ? *c - 32 : *c;
+		const char *value = getenv(name);
+		if (value != NULL) sim_set(keys[i], value);
+	}
+	sim_control_path = getenv("FAKEPDU_CONTROL");
+}
+
+static void hal_open_eeprom(void) {
+	const char *path = getenv("FAKEPDU_EEPROM");
+
+	// Blank EEPROM reads as 0xFF, as on a new chip
+	memset(eeprom, 0xFF, sizeof(eeprom));
+	if (path == NULL) return;
+
+	eeprom_fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (eeprom_fd < 0) {
+		perror("fakepdu: eeprom");
+		exit(1);
+	}
+	if (pread(eeprom_fd, eeprom, sizeof(eeprom), 0) < (ssize_t)sizeof(eeprom)) {
+		memset(eeprom, 0xFF, sizeof(eeprom));
+		if (pwrite(eeprom_fd, eeprom, sizeof(eeprom), 0) != (ssize_t)sizeof(eeprom)) perror("fakepdu: eeprom");
+	}
+}
+
+static void hal_open_pty(void) {
+	const char *link = getenv("FAKEPDU_LINK");
+	struct termios tio;
+
+	pty_fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (pty_fd < 0 || grantpt(pty_fd) != 0 || unlockpt(pty_fd) != 0) {
+		perror("fakepdu: pty");
+		exit(1);
+	}
+
+	// Hold the slave side open so the pty survives clients coming and going, and start
+	// it in raw mode like a real CDC ACM port.
+	pty_slave_fd = open(ptsname(pty_fd), O_RDWR | O_NOCTTY);
+	if (pty_slave_fd < 0 || tcgetattr(pty_slave_fd, &tio) != 0) {
+		perror("fakepdu: pty");
+		exit(1);
+	}
+	cfmakeraw(&tio);
+	cfsetspeed(&tio, B9600);
+	tcsetattr(pty_slave_fd, TCSANOW, &tio);
+
+	fakepdu_stream_ptr = fdopen(dup(pty_fd), "w");
+	if (fakepdu_stream_ptr == NULL) {
+		perror("fakepdu: pty");
+		exit(1);
+	}
+
+	if (link != NULL) {
+		unlink(link);
+		if (symlink(ptsname(pty_fd), link) != 0) perror("fakepdu: link");
+	}
+	printf("%s\n", ptsname(pty_fd));
+	fflush(stdout);
+}
+
+// Runs ahead of the firmware's main()
+__attribute__((constructor)) static void hal_init(void) {
+	hal_load_environment();
+	hal_open_eeprom();
+	hal_open_pty();
+	timer1_match_us = now_us();
+}
@@ -0,0 +1,31 @@
+/* (c) 2017 Nigel Vander Houwen */
+//
+// Host HAL for building the PDU firmware as a normal Linux program. This header is
+// force-included ahead of the firmware sources, and the hal/ directory stands in for
+// the avr-libc and LUFA headers. The console is served on a pseudo terminal, and the
+// MCP3208 ADCs are emulated behind the firmware's bit-banged SPI.
+
+#ifndef _FAKEPDU_HAL_H_
+#define _FAKEPDU_HAL_H_
+
+// Everything is compiled with this header first, so it sets the feature macros too
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+
+// The firmware's console stream is a static FILE, which can't be backed by a pty on the
+// host. Redirect it to a real stream - the firmware's "static FILE USBSerialStream;"
+// then redeclares this function.
+extern FILE *fakepdu_stream_ptr;
+static inline FILE *fakepdu_stream(void) { return fakepdu_stream_ptr; }
+#define USBSerialStream (*fakepdu_stream())
+
+// Jumping to the bootloader just ends the program.
+void fakepdu_bootloader(void);
+#define bootloader fakepdu_bootloader
+
+#endif
@@ -0,0 +1,137 @@
+/* (c) 2017 Nigel Vander Houwen */
+//
+// Just enough of the LUFA USB device API for the firmware to build on the host. The
+// CDC class functions are implemented in fakepdu_hal.c on top of a pseudo terminal.
+
+#ifndef _FAKEPDU_LUFA_USB_H_
+#define _FAKEPDU_LUFA_USB_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <wchar.h>
+
+#define ATTR_WARN_UNUSED_RESULT
+#define ATTR_NON_NULL_PTR_ARG(...)
+
+#define ENDPOINT_DIR_IN  0x80
+#define ENDPOINT_DIR_OUT 0x00
+#define NO_DESCRIPTOR 0
+#define USE_INTERNAL_SERIAL 0xDC
+#define INTERNAL_SERIAL_LENGTH_BITS 80
+#define INTERNAL_SERIAL_START_ADDRESS 0x0E
+#define FIXED_CONTROL_ENDPOINT_SIZE 8
+#define FIXED_NUM_CONFIGURATIONS 1
+#define VERSION_BCD(x, y, z) (((x) << 8) | ((y) << 4) | (z))
+#define LANGUAGE_ID_ENG 0x0409
+#define USB_CONFIG_POWER_MA(mA) ((mA) >> 1)
+
+#define CDC_CONTROL_LINE_OUT_DTR         (1 << 0)
+#define CDC_CONTROL_LINE_OUT_RTS         (1 << 1)
+#define CDC_CONTROL_LINE_IN_DCD          (1 << 0)
+#define CDC_CONTROL_LINE_IN_DSR          (1 << 1)
+#define CDC_CONTROL_LINE_IN_BREAK        (1 << 2)
+#define CDC_CONTROL_LINE_IN_RING         (1 << 3)
+#define CDC_CONTROL_LINE_IN_FRAMEERROR   (1 << 4)
+#define CDC_CONTROL_LINE_IN_PARITYERROR  (1 << 5)
+#define CDC_CONTROL_LINE_IN_OVERRUNERROR (1 << 6)
+
+#define REQDIR_DEVICETOHOST (1 << 7)
+#define REQTYPE_CLASS       (1 << 5)
+#define REQREC_INTERFACE    (1 << 0)
+#define CDC_NOTIF_SerialState 0x20
+
+enum USB_Device_States_t {
+	DEVICE_STATE_Unattached = 0,
+	DEVICE_STATE_Powered,
+	DEVICE_STATE_Default,
+	DEVICE_STATE_Addressed,
+	DEVICE_STATE_Configured,
+	DEVICE_STATE_Suspended,
+};
+extern volatile uint8_t USB_DeviceState;
+
+enum {
+	DTYPE_Device = 0x01,
+	DTYPE_Configuration = 0x02,
+	DTYPE_String = 0x03,
+	DTYPE_Interface = 0x04,
+	DTYPE_Endpoint = 0x05,
+	DTYPE_CSInterface = 0x24,
+};
+
+enum {
+	CDC_CSCP_CDCClass = 0x02,
+	CDC_CSCP_NoSpecificSubclass = 0x00,
+	CDC_CSCP_ACMSubclass = 0x02,
+	CDC_CSCP_ATCommandProtocol = 0x01,
+	CDC_CSCP_NoSpecificProtocol = 0x00,
+	CDC_CSCP_CDCDataClass = 0x0A,
+	CDC_CSCP_NoDataSubclass = 0x00,
+	CDC_CSCP_NoDataProtocol = 0x00,
+	CDC_DSUBTYPE_CSInterface_Header = 0x00,
+	CDC_DSUBTYPE_CSInterface_ACM = 0x02,
+	CDC_DSUBTYPE_CSInterface_Union = 0x06,
+	EP_TYPE_BULK = 0x02,
+	EP_TYPE_INTERRUPT = 0x03,
+	ENDPOINT_ATTR_NO_SYNC = 0x00,
+	ENDPOINT_USAGE_DATA = 0x00,
+	USB_CONFIG_ATTR_RESERVED = 0x80,
+	USB_CONFIG_ATTR_SELFPOWERED = 0x40,
+	MEMSPACE_FLASH = 0,
+	MEMSPACE_EEPROM = 1,
+	MEMSPACE_RAM = 2,
+};
+
+typedef struct { uint8_t Size; uint8_t Type; } USB_Descriptor_Header_t;
+typedef struct { USB_Descriptor_Header_t Header; uint16_t USBSpecification; uint8_t Class; uint8_t SubClass; uint8_t Protocol; uint8_t Endpoint0Size; uint16_t VendorID; uint16_t ProductID; uint16_t ReleaseNumber; uint8_t ManufacturerStrIndex; uint8_t ProductStrIndex; uint8_t SerialNumStrIndex; uint8_t NumberOfConfigurations; } USB_Descriptor_Device_t;
+typedef struct { USB_Descriptor_Header_t Header; uint16_t TotalConfigurationSize; uint8_t TotalInterfaces; uint8_t ConfigurationNumber; uint8_t ConfigurationStrIndex; uint8_t ConfigAttributes; uint8_t MaxPowerConsumption; } USB_Descriptor_Configuration_Header_t;
+typedef struct { USB_Descriptor_Header_t Header; uint8_t InterfaceNumber; uint8_t AlternateSetting; uint8_t TotalEndpoints; uint8_t Class; uint8_t SubClass; uint8_t Protocol; uint8_t InterfaceStrIndex; } USB_Descriptor_Interface_t;
+typedef struct { USB_Descriptor_Header_t Header; uint8_t EndpointAddress; uint8_t Attributes; uint16_t EndpointSize; uint8_t PollingIntervalMS; } USB_Descriptor_Endpoint_t;
+typedef struct { USB_Descriptor_Header_t Header; uint16_t UnicodeString[]; } USB_Descriptor_String_t;
+typedef struct { USB_Descriptor_Header_t Header; uint8_t Subtype; uint16_t CDCSpecification; } USB_CDC_Descriptor_FunctionalHeader_t;
+typedef struct { USB_Descriptor_Header_t Header; uint8_t Subtype; uint8_t Capabilities; } USB_CDC_Descriptor_FunctionalACM_t;
+typedef struct { USB_Descriptor_Header_t Header; uint8_t Subtype; uint8_t MasterInterfaceNumber; uint8_t SlaveInterfaceNumber; } USB_CDC_Descriptor_FunctionalUnion_t;
+
+typedef struct { uint8_t Address; uint16_t Size; uint8_t Type; uint8_t Banks; } USB_Endpoint_Table_t;
+typedef struct { uint32_t BaudRateBPS; uint8_t CharFormat; uint8_t ParityType; uint8_t DataBits; } CDC_LineEncoding_t;
+
+typedef struct {
+	struct {
+		uint8_t ControlInterfaceNumber;
+		USB_Endpoint_Table_t DataINEndpoint;
+		USB_Endpoint_Table_t DataOUTEndpoint;
+		USB_Endpoint_Table_t NotificationEndpoint;
+	} Config;
+	struct {
+		struct {
+			uint16_t HostToDevice;
+			uint16_t DeviceToHost;
+		} ControlLineStates;
+		CDC_LineEncoding_t LineEncoding;
+	} State;
+} USB_ClassInfo_CDC_Device_t;
+
+void USB_Init(void);
+void USB_USBTask(void);
+
+uint8_t Endpoint_GetCurrentEndpoint(void);
+void Endpoint_SelectEndpoint(const uint8_t Address);
+bool Endpoint_IsINReady(void);
+void Endpoint_Write_8(const uint8_t Data);
+void Endpoint_Write_16_LE(const uint16_t Data);
+void Endpoint_ClearIN(void);
+
+bool CDC_Device_ConfigureEndpoints(USB_ClassInfo_CDC_Device_t* const CDCInterfaceInfo);
+void CDC_Device_ProcessControlRequest(USB_ClassInfo_CDC_Device_t* const CDCInterfaceInfo);
+void CDC_Device_USBTask(USB_ClassInfo_CDC_Device_t* const CDCInterfaceInfo);
+uint8_t CDC_Device_SendByte(USB_ClassInfo_CDC_Device_t* const CDCInterfaceInfo, const uint8_t Data);
+uint16_t CDC_Device_BytesReceived(USB_ClassInfo_CDC_Device_t* const CDCInterfaceInfo);
+int16_t CDC_Device_ReceiveByte(USB_ClassInfo_CDC_Device_t* const CDCInterfaceInfo);
+uint8_t CDC_Device_Flush(USB_ClassInfo_CDC_Device_t* const CDCInterfaceInfo);
+void CDC_Device_CreateStream(USB_ClassInfo_CDC_Device_t* const CDCInterfaceInfo, FILE* const Stream);
+
+void EVENT_CDC_Device_LineEncodingChanged(USB_ClassInfo_CDC_Device_t* const CDCInterfaceInfo);
+void EVENT_CDC_Device_ControLineStateChanged(USB_ClassInfo_CDC_Device_t* const CDCInterfaceInfo);
+
+#endif
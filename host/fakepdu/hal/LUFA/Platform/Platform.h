@@ -0,0 +1,8 @@
+/* (c) 2017 Nigel Vander Houwen */
+#ifndef _FAKEPDU_LUFA_PLATFORM_H_
+#define _FAKEPDU_LUFA_PLATFORM_H_
+
+#define GlobalInterruptEnable()
+#define GlobalInterruptDisable()
+
+#endif
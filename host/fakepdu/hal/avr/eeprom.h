@@ -0,0 +1,53 @@
+/* (c) 2017 Nigel Vander Houwen */
+#ifndef _FAKEPDU_AVR_EEPROM_H_
+#define _FAKEPDU_AVR_EEPROM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// EEPROM addresses are offsets into a 1KB image, persisted to $FAKEPDU_EEPROM if set.
+// The firmware casts integer offsets to pointers, so take them as pointers here.
+uint8_t fakepdu_eeprom_read(uintptr_t addr);
+void fakepdu_eeprom_write(uintptr_t addr, uint8_t value);
+void fakepdu_eeprom_read_block(void *dst, uintptr_t addr, size_t len);
+void fakepdu_eeprom_write_block(const void *src, uintptr_t addr, size_t len);
+
+#define eeprom_read_byte(addr) fakepdu_eeprom_read((uintptr_t)(addr))
+#define eeprom_update_byte(addr, value) fakepdu_eeprom_write((uintptr_t)(addr), (value))
+#define eeprom_write_byte eeprom_update_byte
+
+static inline uint16_t fakepdu_eeprom_read_word(uintptr_t addr) {
+	uint16_t value;
+	fakepdu_eeprom_read_block(&value, addr, sizeof(value));
+	return value;
+}
+static inline uint32_t fakepdu_eeprom_read_dword(uintptr_t addr) {
+	uint32_t value;
+	fakepdu_eeprom_read_block(&value, addr, sizeof(value));
+	return value;
+}
+static inline float fakepdu_eeprom_read_float(uintptr_t addr) {
+	float value;
+	fakepdu_eeprom_read_block(&value, addr, sizeof(value));
+	return value;
+}
+static inline void fakepdu_eeprom_write_word(uintptr_t addr, uint16_t value) {
+	fakepdu_eeprom_write_block(&value, addr, sizeof(value));
+}
+static inline void fakepdu_eeprom_write_dword(uintptr_t addr, uint32_t value) {
+	fakepdu_eeprom_write_block(&value, addr, sizeof(value));
+}
+static inline void fakepdu_eeprom_write_float(uintptr_t addr, float value) {
+	fakepdu_eeprom_write_block(&value, addr, sizeof(value));
+}
+
+#define eeprom_read_word(addr) fakepdu_eeprom_read_word((uintptr_t)(addr))
+#define eeprom_read_dword(addr) fakepdu_eeprom_read_dword((uintptr_t)(addr))
+#define eeprom_read_float(addr) fakepdu_eeprom_read_float((uintptr_t)(addr))
+#define eeprom_read_block(dst, addr, len) fakepdu_eeprom_read_block((dst), (uintptr_t)(addr), (len))
+#define eeprom_update_word(addr, value) fakepdu_eeprom_write_word((uintptr_t)(addr), (value))
+#define eeprom_update_dword(addr, value) fakepdu_eeprom_write_dword((uintptr_t)(addr), (value))
+#define eeprom_update_float(addr, value) fakepdu_eeprom_write_float((uintptr_t)(addr), (value))
+#define eeprom_update_block(src, addr, len) fakepdu_eeprom_write_block((src), (uintptr_t)(addr), (len))
+
+#endif
@@ -0,0 +1,14 @@
+/* (c) 2017 Nigel Vander Houwen */
+#ifndef _FAKEPDU_AVR_INTERRUPT_H_
+#define _FAKEPDU_AVR_INTERRUPT_H_
+
+// Interrupts are delivered synchronously by the HAL, from inside the firmware's USB and
+// timer accesses, so there is nothing to mask.
+#define ISR(vector) void vector(void)
+#define cli()
+#define sei()
+
+void TIMER1_COMPA_vect(void);
+void ADC_vect(void);
+
+#endif
@@ -0,0 +1,96 @@
+/* (c) 2017 Nigel Vander Houwen */
+#ifndef _FAKEPDU_AVR_IO_H_
+#define _FAKEPDU_AVR_IO_H_
+
+#include <stdint.h>
+
+// Plain registers
+extern volatile uint8_t PORTB, PORTC, PORTD, PORTF, DDRB, DDRC, DDRD, DDRF, PINC, PIND, PINF;
+extern volatile uint8_t MCUSR, WDTCSR, SREG, SMCR, PRR0, PRR1, GPIOR0;
+extern volatile uint8_t TCCR0A, TCCR0B, TCNT0, OCR0A, TIMSK0, TIFR0;
+extern volatile uint8_t TCCR1A, TCCR1B, TCCR1C, TIMSK1, TIFR1;
+extern volatile uint16_t OCR1A, OCR1B;
+extern volatile uint8_t TCCR3A, TCCR3B, TIMSK3, TIFR3;
+extern volatile uint16_t TCNT3;
+extern volatile uint8_t ADMUX, ADCSRB, DIDR0, DIDR2, ACSR;
+extern volatile uint16_t ADCW;
+
+// Registers with side effects are backed by functions
+volatile uint8_t *fakepdu_adcsra(void);
+volatile uint16_t *fakepdu_tcnt1(void);
+uint8_t fakepdu_pinb(void);
+#define ADCSRA (*fakepdu_adcsra())
+#define TCNT1 (*fakepdu_tcnt1())
+#define PINB (fakepdu_pinb())
+#define ADC ADCW
+
+// Pin numbers
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+#define PC6 6
+#define PC7 7
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+#define PF0 0
+#define PF1 1
+#define PF4 4
+#define PF5 5
+#define PF6 6
+#define PF7 7
+
+// Register bits
+#define ADEN 7
+#define ADSC 6
+#define ADATE 5
+#define ADIF 4
+#define ADIE 3
+#define ADPS2 2
+#define ADPS1 1
+#define ADPS0 0
+#define WDRF 3
+#define WDIE 6
+#define WDCE 4
+#define WDE 3
+#define WDP3 5
+#define WDP2 2
+#define WDP1 1
+#define WDP0 0
+#define OCIE1B 2
+#define OCIE1A 1
+#define TOIE1 0
+#define OCF1B 2
+#define OCF1A 1
+#define TOV1 0
+#define TOIE3 0
+#define TOV3 0
+#define CS12 2
+#define CS11 1
+#define CS10 0
+#define WGM12 3
+#define PRTWI 7
+#define PRTIM0 5
+#define PRTIM1 3
+#define PRSPI 2
+#define PRADC 0
+#define PRUSB 7
+#define PRTIM4 4
+#define PRTIM3 3
+#define PRUSART1 0
+#define SE 0
+#define ACD 7
+
+#define E2END 0x3FF
+
+#endif
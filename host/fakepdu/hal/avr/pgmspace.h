@@ -0,0 +1,25 @@
+/* (c) 2017 Nigel Vander Houwen */
+#ifndef _FAKEPDU_AVR_PGMSPACE_H_
+#define _FAKEPDU_AVR_PGMSPACE_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+// Program memory is ordinary memory on the host
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(addr))
+#define pgm_read_dword(addr) (*(addr))
+#define memcpy_P memcpy
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define strcasecmp_P strcasecmp
+#define strncasecmp_P strncasecmp
+#define strncpy_P strncpy
+#define fprintf_P fprintf
+
+#endif
@@ -0,0 +1,10 @@
+/* (c) 2017 Nigel Vander Houwen */
+#ifndef _FAKEPDU_AVR_POWER_H_
+#define _FAKEPDU_AVR_POWER_H_
+
+#include <avr/io.h>
+
+typedef enum { clock_div_1 = 0, clock_div_16 = 4 } clock_div_t;
+#define clock_prescale_set(x) ((void)(x))
+
+#endif
@@ -0,0 +1,15 @@
+/* (c) 2017 Nigel Vander Houwen */
+#ifndef _FAKEPDU_AVR_SLEEP_H_
+#define _FAKEPDU_AVR_SLEEP_H_
+
+// Sleeping waits for console input or the next timer tick
+void fakepdu_sleep(void);
+
+#define SLEEP_MODE_IDLE 0
+#define set_sleep_mode(mode) ((void)(mode))
+#define sleep_enable()
+#define sleep_disable()
+#define sleep_cpu() fakepdu_sleep()
+#define sleep_mode() fakepdu_sleep()
+
+#endif
@@ -0,0 +1,7 @@
+/* (c) 2017 Nigel Vander Houwen */
+#ifndef _FAKEPDU_AVR_WDT_H_
+#define _FAKEPDU_AVR_WDT_H_
+
+#define wdt_reset()
+
+#endif
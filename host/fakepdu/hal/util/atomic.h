@@ -0,0 +1,10 @@
+/* (c) 2017 Nigel Vander Houwen */
+#ifndef _FAKEPDU_UTIL_ATOMIC_H_
+#define _FAKEPDU_UTIL_ATOMIC_H_
+
+// Interrupts are synchronous on the host, so every block is already atomic
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+#define ATOMIC_BLOCK(type) for (uint8_t _fakepdu_atomic = 1; _fakepdu_atomic; _fakepdu_atomic = 0)
+
+#endif
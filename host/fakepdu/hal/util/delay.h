@@ -0,0 +1,10 @@
+/* (c) 2017 Nigel Vander Houwen */
+#ifndef _FAKEPDU_UTIL_DELAY_H_
+#define _FAKEPDU_UTIL_DELAY_H_
+
+#include <unistd.h>
+
+#define _delay_ms(ms) usleep((useconds_t)((ms) * 1000))
+#define _delay_us(us) usleep((useconds_t)(us))
+
+#endif
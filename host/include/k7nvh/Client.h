@@ -0,0 +1,112 @@
+/* (c) 2017 Nigel Vander Houwen */
+//
+// Non-blocking client for one PDU's USB serial console.
+//
+// The client opens the port at the quiet mode baud rate, so the PDU drops echo, prompts,
+// and colour, and ends every response with a line holding a single ".". Requests are
+// pipelined: up to MAX_IN_FLIGHT commands are written before their responses arrive,
+// and the PDU buffers and runs them in order. Asynchronous "!EVENT" lines are passed to
+// the event handler.
+//
+// A Client does no waiting of its own. Add it to a Fleet, which multiplexes any number
+// of clients over epoll, or drive handleReadable/handleWritable/tick from your own loop.
+
+#ifndef K7NVH_CLIENT_H
+#define K7NVH_CLIENT_H
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "k7nvh/Status.h"
+
+namespace k7nvh {
+
+class Client {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	struct Response {
+		std::string command;
+		std::vector<std::string> lines;
+		bool ok = false; // False if the PDU rejected the command or the connection was lost
+	};
+
+	using ResponseHandler = std::function<void(const Response&)>;
+	using EventHandler = std::function<void(const Event&)>;
+
+	static constexpr size_t MAX_IN_FLIGHT = 4;
+	static constexpr size_t MAX_COMMAND_LEN = 31; // DATA_BUFF_LEN - 1 in the firmware
+	static constexpr unsigned QUIET_BAUD = 57600;
+	static constexpr std::chrono::milliseconds SYNC_TIMEOUT{2000};
+	static constexpr std::chrono::milliseconds SYNC_SETTLE{200};
+	static constexpr std::chrono::milliseconds RESPONSE_TIMEOUT{10000};
+
+	explicit Client(std::string path);
+	~Client();
+	Client(const Client&) = delete;
+	Client& operator=(const Client&) = delete;
+
+	// Open the port and start synchronising with the PDU. Returns false with errno set
+	// if the port can't be opened.
+	bool open();
+	// Close the port, failing any outstanding requests.
+	void close();
+
+	bool isOpen() const { return fd_ >= 0; }
+	// True once synchronised and accepting requests onto the wire
+	bool isReady() const { return state_ == State::Ready; }
+	int fd() const { return fd_; }
+	const std::string& path() const { return path_; }
+	// Reason for the last close, empty if closed by the caller
+	const std::string& error() const { return error_; }
+
+	// Queue a command. Returns false if the command is too long to send, or the port
+	// isn't open.
+	bool request(const std::string& command, ResponseHandler handler);
+	// Requests queued or awaiting a response
+	size_t pending() const { return queued_.size() + inFlight_.size(); }
+
+	void setEventHandler(EventHandler handler) { eventHandler_ = std::move(handler); }
+
+	// I/O and timer entry points
+	bool wantsWrite() const { return !output_.empty(); }
+	void handleReadable();
+	void handleWritable();
+	// Run timeouts. Returns the time of the next deadline, or Clock::time_point::max().
+	Clock::time_point tick(Clock::time_point now);
+
+private:
+	enum class State { Closed, Syncing, Ready };
+
+	struct Pending {
+		ResponseHandler handler;
+		Clock::time_point sent;
+		Response response;
+	};
+
+	void fail(const std::string& why);
+	void handleLine(const std::string& line);
+	void pump();
+
+	std::string path_;
+	int fd_ = -1;
+	State state_ = State::Closed;
+	std::string error_;
+
+	std::string input_;
+	std::string output_;
+	std::deque<Pending> queued_;
+	std::deque<Pending> inFlight_;
+	EventHandler eventHandler_;
+
+	Clock::time_point opened_;
+	Clock::time_point lastInput_;
+	bool syncDelimiter_ = false;
+};
+
+} // namespace k7nvh
+
+#endif
@@ -0,0 +1,28 @@
+/* (c) 2017 Nigel Vander Houwen */
+//
+// Finds attached PDUs through sysfs, by the USB IDs in K7NVH_PDU.inf. The serial number
+// and PDU name come from the USB string descriptors, so no PDU has to be opened.
+
+#ifndef K7NVH_DISCOVERY_H
+#define K7NVH_DISCOVERY_H
+
+#include <string>
+#include <vector>
+
+namespace k7nvh {
+
+constexpr unsigned PDU_VENDOR_ID = 0x03EB;
+constexpr unsigned PDU_PRODUCT_ID = 0x2044;
+
+struct Device {
+	std::string path; // e.g. /dev/ttyACM0
+	std::string serial; // USB serial number, unique to the PDU's microcontroller
+	std::string name; // PDU name as of when it was connected, from the interface string
+};
+
+// Serial devices belonging to attached PDUs, sorted by path.
+std::vector<Device> findDevices(const std::string& sysfs = "/sys/class/tty");
+
+} // namespace k7nvh
+
+#endif
@@ -0,0 +1,66 @@
+/* (c) 2017 Nigel Vander Houwen */
+//
+// Multiplexes any number of PDU clients on one thread with epoll. Clients are polled
+// for their current descriptor and write interest on every pass, so they may be closed
+// and reopened freely while registered. Other descriptors, such as sockets, can share
+// the loop through watch().
+
+#ifndef K7NVH_FLEET_H
+#define K7NVH_FLEET_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <vector>
+
+#include "k7nvh/Client.h"
+
+namespace k7nvh {
+
+class Fleet {
+public:
+	Fleet();
+	~Fleet();
+	Fleet(const Fleet&) = delete;
+	Fleet& operator=(const Fleet&) = delete;
+
+	// The fleet doesn't own its clients, which must outlive their registration. Neither
+	// may be called from a client's handlers.
+	void add(Client& client);
+	void remove(Client& client);
+	const std::vector<Client*>& clients() const { return clients_; }
+
+	// Call handler with the ready epoll events whenever fd is ready for any of events.
+	// Watching an already watched fd replaces its events and handler.
+	using Handler = std::function<void(uint32_t events)>;
+	void watch(int fd, uint32_t events, Handler handler);
+	// Stop watching fd. Must be called before closing it.
+	void unwatch(int fd);
+
+	// Wait up to timeoutMs (-1 for no limit) for I/O or a client deadline, and service
+	// whatever is ready. Returns false if there was nothing to wait for.
+	bool poll(int timeoutMs);
+	// Poll until no client has requests outstanding, or timeoutMs passes. Returns true
+	// if everything completed.
+	bool runUntilIdle(int timeoutMs);
+
+private:
+	// What an epoll entry points at, either a client or a watched descriptor
+	struct Registration {
+		Client* client = nullptr;
+		int fd = -1;
+		uint32_t events = 0;
+		Handler handler;
+	};
+
+	void sync(Client& client);
+
+	int epoll_ = -1;
+	std::vector<Client*> clients_;
+	std::map<Client*, Registration> registered_;
+	std::map<int, Registration> watched_;
+};
+
+} // namespace k7nvh
+
+#endif
@@ -0,0 +1,39 @@
+/* (c) 2017 Nigel Vander Houwen */
+//
+// Compiler for PDU automation scripts. Scripts are compiled on the host to bytecode for
+// the firmware's script VM, written to its EEPROM with SETSCRIPT, and started with
+// SCRIPT RUN. One statement per line, # starts a comment:
+//
+//   on|off|cycle <ports>        Switch ports, as PON, POFF and PCYCLE. Ports as for PON.
+//   wait <expr> [ms|s]          Pause the script, in milliseconds by default
+//   let <name> = <expr>         Set a variable. Up to 8, all starting at 0.
+//   if <expr> / else / end      Conditional
+//   while <expr> / end          Loop
+//   yield                       Give up the rest of this tick
+//   stop                        End the script
+//
+// Expressions are 16 bit integers, with ( ) - ! not * / + - < > <= >= == != and && or ||,
+// in C precedence. Readings are current(<port>) in mA (0 while the port is off),
+// state(<port>) (1 if on), main, alt, ext1 and ext2 in volts*100, and temp in C.
+
+#ifndef K7NVH_SCRIPT_H
+#define K7NVH_SCRIPT_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace k7nvh {
+
+constexpr size_t SCRIPT_LEN = 255; // Bytes of code the PDU holds
+
+// Compile a script. Returns the code, or nullopt with error set to the line and reason.
+std::optional<std::vector<uint8_t>> compileScript(const std::string& source, std::string& error);
+
+// The SETSCRIPT commands that write code to the PDU, each short enough for the console
+std::vector<std::string> scriptCommands(const std::vector<uint8_t>& code);
+
+} // namespace k7nvh
+
+#endif
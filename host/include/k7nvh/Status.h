@@ -0,0 +1,58 @@
+/* (c) 2017 Nigel Vander Houwen */
+//
+// Parsed forms of the PDU's machine readable output: the PSTATUS report and the
+// "!EVENT,..." lines emitted asynchronously in quiet mode.
+
+#ifndef K7NVH_STATUS_H
+#define K7NVH_STATUS_H
+
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace k7nvh {
+
+struct PortStatus {
+	int number = 0;
+	std::string name;
+	bool enabled = false;
+	double current = 0; // Amps
+	double power = 0; // Watts
+	bool overload = false;
+	bool voltageControl = false;
+	bool altBus = false;
+	bool locked = false;
+};
+
+struct Status {
+	std::string description; // "K7NVH PoE PDU"
+	std::string version;
+	std::string name;
+	double mainVoltage = 0;
+	double altVoltage = 0;
+	double temperature = 0; // C
+	double ext1Voltage = 0;
+	double ext2Voltage = 0;
+	double time = 0; // Seconds since boot, or the time set with SETTIME. 0 from older firmware.
+	std::vector<PortStatus> ports;
+};
+
+struct Event {
+	std::string type; // OVERLOAD, RETRY, VCTLOFF, VCTLON, CYCLE, LOCKOUT, SHED, RESTORE, TRIGGER, SCHEDULE, RULE, SCRIPT
+	int port = 0;
+	double time = 0; // When the event happened, in the PDU's clock. 0 from older firmware.
+};
+
+// Parse the lines of a PSTATUS response, without the terminating "." line.
+// Port names may themselves contain commas, so port lines are split from both ends.
+std::optional<Status> parseStatus(const std::vector<std::string>& lines);
+
+// Parse a "!EVENT,TYPE,PORT[,TIME]" line.
+std::optional<Event> parseEvent(const std::string& line);
+
+// Split a line on commas, keeping empty fields.
+std::vector<std::string> splitFields(const std::string& line);
+
+} // namespace k7nvh
+
+#endif
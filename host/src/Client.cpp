@@ -0,0 +1,225 @@
+/* (c) 2017 Nigel Vander Houwen */
+
+#include "k7nvh/Client.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace k7nvh {
+
+namespace {
+
+// Ctrl-C discards any partial command left by a previous session
+const char SYNC_COMMAND[] = "\x03QUIET ON\r";
+const char DELIMITER[] = ".";
+const char INVALID[] = "INVALID COMMAND";
+
+} // namespace
+
+constexpr std::chrono::milliseconds Client::SYNC_TIMEOUT;
+constexpr std::chrono::milliseconds Client::SYNC_SETTLE;
+constexpr std::chrono::milliseconds Client::RESPONSE_TIMEOUT;
+
+Client::Client(std::string path) : path_(std::move(path)) {}
+
+Client::~Client() {
+	close();
+}
+
+bool Client::open() {
+	if (fd_ >= 0) return true;
+
+	int fd = ::open(path_.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0) return false;
+
+	struct termios tio;
+	if (tcgetattr(fd, &tio) != 0) {
+		int saved = errno;
+		::close(fd);
+		errno = saved;
+		return false;
+	}
+	cfmakeraw(&tio);
+	tio.c_cflag |= CLOCAL | CREAD;
+	// With VMIN 0 an empty read returns 0, which we need to mean hangup
+	tio.c_cc[VMIN] = 1;
+	tio.c_cc[VTIME] = 0;
+	// The PDU switches to quiet mode when it sees this line coding
+	cfsetspeed(&tio, B57600);
+	if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+		int saved = errno;
+		::close(fd);
+		errno = saved;
+		return false;
+	}
+	tcflush(fd, TCIOFLUSH);
+
+	fd_ = fd;
+	state_ = State::Syncing;
+	error_.clear();
+	input_.clear();
+	output_ = SYNC_COMMAND;
+	opened_ = lastInput_ = Clock::now();
+	syncDelimiter_ = false;
+	return true;
+}
+
+void Client::close() {
+	if (fd_ >= 0) {
+		::close(fd_);
+		fd_ = -1;
+	}
+	state_ = State::Closed;
+	input_.clear();
+	output_.clear();
+
+	// Handlers may queue new requests, so take the lists before calling them
+	std::deque<Pending> failed;
+	failed.swap(inFlight_);
+	for (Pending& pending : queued_) failed.push_back(std::move(pending));
+	queued_.clear();
+	for (Pending& pending : failed) {
+		pending.response.ok = false;
+		if (pending.handler) pending.handler(pending.response);
+	}
+}
+
+void Client::fail(const std::string& why) {
+	close();
+	error_ = why;
+}
+
+bool Client::request(const std::string& command, ResponseHandler handler) {
+	if (fd_ < 0 || command.size() > MAX_COMMAND_LEN) return false;
+	if (command.find_first_of("\r\n\x03") != std::string::npos) return false;
+
+	Pending pending;
+	pending.handler = std::move(handler);
+	pending.response.command = command;
+	pending.response.ok = true;
+	queued_.push_back(std::move(pending));
+	pump();
+	return true;
+}
+
+// Move queued requests onto the wire while there is room in the pipeline
+void Client::pump() {
+	if (state_ != State::Ready) return;
+
+	Clock::time_point now = Clock::now();
+	while (!queued_.empty() && inFlight_.size() < MAX_IN_FLIGHT) {
+		Pending pending = std::move(queued_.front());
+		queued_.pop_front();
+		output_ += pending.response.command;
+		output_ += '\r';
+		pending.sent = now;
+		inFlight_.push_back(std::move(pending));
+	}
+}
+
+void Client::handleReadable() {
+	char buffer[512];
+
+	while (fd_ >= 0) {
+		ssize_t count = ::read(fd_, buffer, sizeof(buffer));
+		if (count < 0 && errno == EINTR) continue;
+		if (count < 0 && errno == EAGAIN) break;
+		if (count <= 0) {
+			fail(count == 0 ? "disconnected" : std::strerror(errno));
+			return;
+		}
+
+		lastInput_ = Clock::now();
+		input_.append(buffer, count);
+
+		size_t start = 0;
+		size_t newline;
+		while ((newline = input_.find('\n', start)) != std::string::npos) {
+			std::string line = input_.substr(start, newline - start);
+			start = newline + 1;
+			if (!line.empty() && line.back() == '\r') line.pop_back();
+			handleLine(line);
+			// A handler may have closed us
+			if (fd_ < 0) return;
+		}
+		input_.erase(0, start);
+	}
+}
+
+void Client::handleLine(const std::string& line) {
+	if (line.empty()) return;
+
+	if (line[0] == '!') {
+		std::optional<Event> event = parseEvent(line);
+		if (event && eventHandler_) eventHandler_(*event);
+		return;
+	}
+
+	// While synchronising, everything up to the QUIET ON response is stale
+	if (state_ == State::Syncing) {
+		if (line == DELIMITER) syncDelimiter_ = true;
+		return;
+	}
+
+	if (inFlight_.empty()) return;
+
+	Pending& pending = inFlight_.front();
+	if (line != DELIMITER) {
+		if (line == INVALID) pending.response.ok = false;
+		pending.response.lines.push_back(line);
+		return;
+	}
+
+	Pending done = std::move(pending);
+	inFlight_.pop_front();
+	pump();
+	if (done.handler) done.handler(done.response);
+}
+
+void Client::handleWritable() {
+	while (fd_ >= 0 && !output_.empty()) {
+		ssize_t count = ::write(fd_, output_.data(), output_.size());
+		if (count < 0 && errno == EINTR) continue;
+		if (count < 0 && errno == EAGAIN) break;
+		if (count < 0) {
+			fail(std::strerror(errno));
+			return;
+		}
+		output_.erase(0, count);
+	}
+}
+
+Client::Clock::time_point Client::tick(Clock::time_point now) {
+	switch (state_) {
+		case State::Closed:
+			return Clock::time_point::max();
+
+		case State::Syncing:
+			// Ready once the QUIET ON response is in and the line has gone idle
+			if (syncDelimiter_ && now - lastInput_ >= SYNC_SETTLE) {
+				state_ = State::Ready;
+				pump();
+				break;
+			}
+			if (now - opened_ >= SYNC_TIMEOUT) {
+				fail("no response from PDU");
+				return Clock::time_point::max();
+			}
+			return syncDelimiter_ ? lastInput_ + SYNC_SETTLE : opened_ + SYNC_TIMEOUT;
+
+		case State::Ready:
+			break;
+	}
+
+	if (inFlight_.empty()) return Clock::time_point::max();
+	if (now - inFlight_.front().sent >= RESPONSE_TIMEOUT) {
+		fail("response timeout");
+		return Clock::time_point::max();
+	}
+	return inFlight_.front().sent + RESPONSE_TIMEOUT;
+}
+
+} // namespace k7nvh
@@ -0,0 +1,48 @@
+/* (c) 2017 Nigel Vander Houwen */
+
+#include "k7nvh/Discovery.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <dirent.h>
+#include <fstream>
+
+namespace k7nvh {
+
+namespace {
+
+std::string readAttribute(const std::string& path) {
+	std::ifstream file(path);
+	std::string value;
+	std::getline(file, value);
+	return value;
+}
+
+} // namespace
+
+std::vector<Device> findDevices(const std::string& sysfs) {
+	std::vector<Device> devices;
+
+	DIR* dir = opendir(sysfs.c_str());
+	if (dir == nullptr) return devices;
+
+	while (struct dirent* entry = readdir(dir)) {
+		std::string name = entry->d_name;
+		if (name.compare(0, 6, "ttyACM") != 0) continue;
+
+		// device is the CDC control interface, and its parent the USB device with the IDs
+		std::string interface = sysfs + "/" + name + "/device";
+		std::string usb = interface + "/..";
+		unsigned vendor = std::strtoul(readAttribute(usb + "/idVendor").c_str(), nullptr, 16);
+		unsigned product = std::strtoul(readAttribute(usb + "/idProduct").c_str(), nullptr, 16);
+		if (vendor != PDU_VENDOR_ID || product != PDU_PRODUCT_ID) continue;
+
+		devices.push_back({"/dev/" + name, readAttribute(usb + "/serial"), readAttribute(interface + "/interface")});
+	}
+	closedir(dir);
+
+	std::sort(devices.begin(), devices.end(), [](const Device& a, const Device& b) { return a.path < b.path; });
+	return devices;
+}
+
+} // namespace k7nvh
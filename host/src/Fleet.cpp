@@ -0,0 +1,152 @@
+/* (c) 2017 Nigel Vander Houwen */
+
+#include "k7nvh/Fleet.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+namespace k7nvh {
+
+namespace {
+
+constexpr int MAX_EVENTS = 32;
+
+} // namespace
+
+Fleet::Fleet() {
+	epoll_ = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_ < 0) throw std::runtime_error("epoll_create1 failed");
+}
+
+Fleet::~Fleet() {
+	::close(epoll_);
+}
+
+void Fleet::add(Client& client) {
+	if (std::find(clients_.begin(), clients_.end(), &client) != clients_.end()) return;
+	clients_.push_back(&client);
+	sync(client);
+}
+
+void Fleet::remove(Client& client) {
+	auto registration = registered_.find(&client);
+	if (registration != registered_.end()) {
+		if (registration->second.fd >= 0 && registration->second.fd == client.fd()) {
+			epoll_ctl(epoll_, EPOLL_CTL_DEL, registration->second.fd, nullptr);
+		}
+		registered_.erase(registration);
+	}
+	clients_.erase(std::remove(clients_.begin(), clients_.end(), &client), clients_.end());
+}
+
+void Fleet::watch(int fd, uint32_t events, Handler handler) {
+	Registration& registration = watched_[fd];
+	struct epoll_event event = {};
+	event.events = events;
+	event.data.ptr = &registration;
+	if (epoll_ctl(epoll_, registration.fd < 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &event) != 0) {
+		watched_.erase(fd);
+		throw std::runtime_error("epoll_ctl failed");
+	}
+	registration.fd = fd;
+	registration.events = events;
+	registration.handler = std::move(handler);
+}
+
+void Fleet::unwatch(int fd) {
+	if (watched_.erase(fd) > 0) epoll_ctl(epoll_, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+// Bring the epoll registration in line with the client's descriptor and write interest.
+// A closed descriptor drops out of the epoll set by itself, so a descriptor number that
+// has been reused needs adding again rather than modifying.
+void Fleet::sync(Client& client) {
+	Registration& registration = registered_[&client];
+	uint32_t events = EPOLLIN;
+	if (client.wantsWrite()) events |= EPOLLOUT;
+
+	registration.client = &client;
+	if (client.fd() < 0) {
+		registration.fd = -1;
+		return;
+	}
+	if (registration.fd == client.fd() && registration.events == events) return;
+
+	struct epoll_event event = {};
+	event.events = events;
+	event.data.ptr = &registration;
+	if (registration.fd != client.fd() || epoll_ctl(epoll_, EPOLL_CTL_MOD, client.fd(), &event) != 0) {
+		if (epoll_ctl(epoll_, EPOLL_CTL_ADD, client.fd(), &event) != 0 && errno == EEXIST) {
+			epoll_ctl(epoll_, EPOLL_CTL_MOD, client.fd(), &event);
+		}
+	}
+	registration.fd = client.fd();
+	registration.events = events;
+}
+
+bool Fleet::poll(int timeoutMs) {
+	Client::Clock::time_point now = Client::Clock::now();
+	Client::Clock::time_point deadline = Client::Clock::time_point::max();
+	bool open = false;
+
+	for (Client* client : clients_) {
+		deadline = std::min(deadline, client->tick(now));
+		sync(*client);
+		open = open || client->isOpen();
+	}
+	if (!open && watched_.empty()) return false;
+
+	if (deadline != Client::Clock::time_point::max()) {
+		auto untilDeadline = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count() + 1;
+		if (timeoutMs < 0 || untilDeadline < timeoutMs) timeoutMs = static_cast<int>(std::max<long long>(untilDeadline, 0));
+	}
+
+	struct epoll_event events[MAX_EVENTS];
+	int count = epoll_wait(epoll_, events, MAX_EVENTS, timeoutMs);
+	if (count < 0 && errno != EINTR) throw std::runtime_error("epoll_wait failed");
+
+	// Handlers may unwatch other descriptors, so only follow entries that still exist
+	std::vector<std::pair<int, uint32_t>> ready;
+	for (int i = 0; i < count; i++) {
+		Registration* registration = static_cast<Registration*>(events[i].data.ptr);
+		if (registration->client) {
+			if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) registration->client->handleReadable();
+			if (events[i].events & EPOLLOUT) registration->client->handleWritable();
+		} else {
+			ready.emplace_back(registration->fd, static_cast<uint32_t>(events[i].events));
+		}
+	}
+	for (const std::pair<int, uint32_t>& entry : ready) {
+		auto watched = watched_.find(entry.first);
+		if (watched != watched_.end()) {
+			Handler handler = watched->second.handler;
+			handler(entry.second);
+		}
+	}
+
+	// Flush anything the handlers queued straight away rather than waiting for EPOLLOUT
+	now = Client::Clock::now();
+	for (Client* client : clients_) {
+		client->tick(now);
+		if (client->wantsWrite()) client->handleWritable();
+		sync(*client);
+	}
+	return true;
+}
+
+bool Fleet::runUntilIdle(int timeoutMs) {
+	Client::Clock::time_point end = Client::Clock::now() + std::chrono::milliseconds(timeoutMs);
+
+	while (true) {
+		bool busy = std::any_of(clients_.begin(), clients_.end(), [](Client* client) { return client->pending() > 0; });
+		if (!busy) return true;
+
+		auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(end - Client::Clock::now()).count();
+		if (remaining <= 0 || !poll(static_cast<int>(remaining))) return false;
+	}
+}
+
+} // namespace k7nvh
@@ -0,0 +1,419 @@
+/* (c) 2017 Nigel Vander Houwen */
+
+#include "k7nvh/Script.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <sstream>
+
+namespace k7nvh {
+
+namespace {
+
+// Must match the OP_*, ACTION_* and READ_* values in K7NVH_PoE_PDU.h
+enum Op : uint8_t {
+	OP_HALT = 0x00, OP_PUSH8, OP_PUSH16, OP_LOAD, OP_STORE, OP_DUP, OP_DROP, OP_ADD, OP_SUB, OP_MUL, OP_DIV,
+	OP_NEG, OP_EQ, OP_LT, OP_GT, OP_NOT, OP_AND, OP_OR, OP_JMP, OP_JZ, OP_PORTS, OP_READ, OP_STATE, OP_WAIT,
+	OP_YIELD,
+};
+enum Action : uint8_t { ACTION_OFF, ACTION_ON, ACTION_CYCLE };
+enum Reading : uint8_t { READ_CURRENT, READ_MAIN, READ_ALT, READ_EXT1, READ_EXT2, READ_TEMP };
+
+constexpr size_t VAR_CNT = 8;
+constexpr long PORT_CNT = 12;
+constexpr size_t SETSCRIPT_BYTES = 8; // Code bytes per SETSCRIPT, to fit the console's 31 characters
+
+struct CompileError {
+	std::string message;
+};
+
+struct Token {
+	enum Kind { End, Number, Name, Symbol } kind = End;
+	std::string text; // Names are lower case
+	long value = 0;
+};
+
+std::vector<Token> tokenize(const std::string& line) {
+	std::vector<Token> tokens;
+	size_t i = 0;
+	while (i < line.size()) {
+		char c = line[i];
+		if (c == '#') break;
+		if (std::isspace(static_cast<unsigned char>(c))) {
+			i++;
+			continue;
+		}
+
+		Token token;
+		if (std::isdigit(static_cast<unsigned char>(c))) {
+			size_t start = i;
+			while (i < line.size() && std::isdigit(static_cast<unsigned char>(line[i]))) i++;
+			token.kind = Token::Number;
+			token.text = line.substr(start, i - start);
+			if (token.text.size() > 6) throw CompileError{"number too large: " + token.text};
+			token.value = std::stol(token.text);
+		} else if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+			size_t start = i;
+			while (i < line.size() && (std::isalnum(static_cast<unsigned char>(line[i])) || line[i] == '_')) i++;
+			token.kind = Token::Name;
+			token.text = line.substr(start, i - start);
+			std::transform(token.text.begin(), token.text.end(), token.text.begin(),
+				[](unsigned char ch) { return std::tolower(ch); });
+		} else {
+			static const char* const pairs[] = {"==", "!=", "<=", ">=", "&&", "||"};
+			token.kind = Token::Symbol;
+			token.text = std::string(1, c);
+			for (const char* pair : pairs) {
+				if (line.compare(i, 2, pair) == 0) token.text = pair;
+			}
+			if (token.text.size() == 1 && std::string("()+-*/<>!=").find(c) == std::string::npos) {
+				throw CompileError{"unexpected '" + token.text + "'"};
+			}
+			i += token.text.size();
+		}
+		tokens.push_back(token);
+	}
+	tokens.push_back(Token{});
+	return tokens;
+}
+
+class Compiler {
+public:
+	std::vector<uint8_t> code;
+
+	void statement(const std::vector<Token>& tokens) {
+		tokens_ = &tokens;
+		pos_ = 0;
+		if (peek().kind == Token::End) return;
+
+		std::string keyword = expectName();
+		if (keyword == "on" || keyword == "off" || keyword == "cycle") {
+			pushConstant(portList());
+			emit(OP_PORTS, keyword == "on" ? ACTION_ON : (keyword == "off" ? ACTION_OFF : ACTION_CYCLE));
+		} else if (keyword == "wait") {
+			expression();
+			uint8_t seconds = 0;
+			if (peek().kind == Token::Name && (peek().text == "ms" || peek().text == "s")) {
+				seconds = (next().text == "s");
+			}
+			emit(OP_WAIT, seconds);
+		} else if (keyword == "let") {
+			std::string name = expectName();
+			if (isReserved(name)) throw CompileError{"'" + name + "' can't be a variable"};
+			expectSymbol("=");
+			expression();
+			emit(OP_STORE, variable(name, true));
+		} else if (keyword == "if") {
+			expression();
+			blocks_.push_back(Block{Block::If, 0, jump(OP_JZ)});
+		} else if (keyword == "else") {
+			if (blocks_.empty() || blocks_.back().kind != Block::If) throw CompileError{"else without if"};
+			size_t skip = jump(OP_JMP);
+			patch(blocks_.back().patch);
+			blocks_.back() = Block{Block::Else, 0, skip};
+		} else if (keyword == "while") {
+			size_t top = code.size();
+			expression();
+			blocks_.push_back(Block{Block::While, top, jump(OP_JZ)});
+		} else if (keyword == "end") {
+			if (blocks_.empty()) throw CompileError{"end without if or while"};
+			Block block = blocks_.back();
+			blocks_.pop_back();
+			if (block.kind == Block::While) emit(OP_JMP, address(block.top));
+			patch(block.patch);
+		} else if (keyword == "yield") {
+			emit(OP_YIELD);
+		} else if (keyword == "stop") {
+			emit(OP_HALT);
+		} else {
+			throw CompileError{"unknown statement '" + keyword + "'"};
+		}
+
+		if (peek().kind != Token::End) throw CompileError{"unexpected '" + peek().text + "'"};
+	}
+
+	void finish() {
+		if (!blocks_.empty()) throw CompileError{"missing end"};
+		emit(OP_HALT);
+		if (code.size() > SCRIPT_LEN) {
+			throw CompileError{"script is " + std::to_string(code.size()) + " bytes, the PDU holds " +
+				std::to_string(SCRIPT_LEN)};
+		}
+	}
+
+private:
+	struct Block {
+		enum Kind { If, Else, While } kind;
+		size_t top; // Start of a while's condition
+		size_t patch; // Jump operand to point past the block
+	};
+
+	const std::vector<Token>* tokens_ = nullptr;
+	size_t pos_ = 0;
+	std::vector<Block> blocks_;
+	std::vector<std::string> vars_;
+
+	const Token& peek() const { return (*tokens_)[pos_]; }
+	const Token& next() { return (*tokens_)[peek().kind == Token::End ? pos_ : pos_++]; }
+
+	bool acceptSymbol(const char* symbol) {
+		if (peek().kind != Token::Symbol || peek().text != symbol) return false;
+		pos_++;
+		return true;
+	}
+
+	bool acceptName(const char* name) {
+		if (peek().kind != Token::Name || peek().text != name) return false;
+		pos_++;
+		return true;
+	}
+
+	void expectSymbol(const char* symbol) {
+		if (!acceptSymbol(symbol)) throw CompileError{std::string("expected '") + symbol + "'"};
+	}
+
+	std::string expectName() {
+		if (peek().kind != Token::Name) throw CompileError{"expected a name"};
+		return next().text;
+	}
+
+	static bool isReserved(const std::string& name) {
+		static const char* const words[] = {"on", "off", "cycle", "wait", "let", "if", "else", "while", "end",
+			"yield", "stop", "and", "or", "not", "current", "state", "main", "alt", "ext1", "ext2", "temp", "ms",
+			"s", "a", "all"};
+		return std::find_if(std::begin(words), std::end(words),
+			[&name](const char* word) { return name == word; }) != std::end(words);
+	}
+
+	uint8_t variable(const std::string& name, bool create) {
+		auto found = std::find(vars_.begin(), vars_.end(), name);
+		if (found != vars_.end()) return static_cast<uint8_t>(found - vars_.begin());
+		if (!create) throw CompileError{"unknown variable '" + name + "'"};
+		if (vars_.size() >= VAR_CNT) throw CompileError{"more than " + std::to_string(VAR_CNT) + " variables"};
+		vars_.push_back(name);
+		return static_cast<uint8_t>(vars_.size() - 1);
+	}
+
+	long portList() {
+		long mask = 0;
+		while (peek().kind != Token::End) {
+			const Token& token = next();
+			if (token.kind == Token::Name && (token.text == "a" || token.text == "all")) {
+				mask = (1 << PORT_CNT) - 1;
+			} else if (token.kind == Token::Number && token.value >= 1 && token.value <= PORT_CNT) {
+				mask |= 1 << (token.value - 1);
+			} else {
+				throw CompileError{"bad port '" + token.text + "'"};
+			}
+		}
+		if (mask == 0) throw CompileError{"no ports"};
+		return mask;
+	}
+
+	void emit(uint8_t op) { code.push_back(op); }
+	void emit(uint8_t op, uint8_t operand) {
+		code.push_back(op);
+		code.push_back(operand);
+	}
+
+	void pushConstant(long value) {
+		if (value >= -128 && value <= 127) {
+			emit(OP_PUSH8, static_cast<uint8_t>(value));
+		} else if (value >= -32768 && value <= 65535) {
+			emit(OP_PUSH16, static_cast<uint8_t>(value & 0xFF));
+			code.push_back(static_cast<uint8_t>((value >> 8) & 0xFF));
+		} else {
+			throw CompileError{"number out of range: " + std::to_string(value)};
+		}
+	}
+
+	static uint8_t address(size_t at) {
+		if (at >= SCRIPT_LEN) throw CompileError{"script too long for a jump"};
+		return static_cast<uint8_t>(at);
+	}
+
+	// Emit a jump to be patched later, and return where its operand is
+	size_t jump(uint8_t op) {
+		emit(op, 0);
+		return code.size() - 1;
+	}
+
+	void patch(size_t operand) { code[operand] = address(code.size()); }
+
+	// Expressions, lowest precedence first
+	void expression() {
+		conjunction();
+		while (acceptSymbol("||") || acceptName("or")) {
+			conjunction();
+			emit(OP_OR);
+		}
+	}
+
+	void conjunction() {
+		equality();
+		while (acceptSymbol("&&") || acceptName("and")) {
+			equality();
+			emit(OP_AND);
+		}
+	}
+
+	void equality() {
+		relation();
+		while (true) {
+			if (acceptSymbol("==")) {
+				relation();
+				emit(OP_EQ);
+			} else if (acceptSymbol("!=")) {
+				relation();
+				emit(OP_EQ);
+				emit(OP_NOT);
+			} else {
+				return;
+			}
+		}
+	}
+
+	void relation() {
+		sum();
+		while (true) {
+			if (acceptSymbol("<")) {
+				sum();
+				emit(OP_LT);
+			} else if (acceptSymbol(">")) {
+				sum();
+				emit(OP_GT);
+			} else if (acceptSymbol("<=")) {
+				sum();
+				emit(OP_GT);
+				emit(OP_NOT);
+			} else if (acceptSymbol(">=")) {
+				sum();
+				emit(OP_LT);
+				emit(OP_NOT);
+			} else {
+				return;
+			}
+		}
+	}
+
+	void sum() {
+		product();
+		while (true) {
+			if (acceptSymbol("+")) {
+				product();
+				emit(OP_ADD);
+			} else if (acceptSymbol("-")) {
+				product();
+				emit(OP_SUB);
+			} else {
+				return;
+			}
+		}
+	}
+
+	void product() {
+		unary();
+		while (true) {
+			if (acceptSymbol("*")) {
+				unary();
+				emit(OP_MUL);
+			} else if (acceptSymbol("/")) {
+				unary();
+				emit(OP_DIV);
+			} else {
+				return;
+			}
+		}
+	}
+
+	void unary() {
+		if (acceptSymbol("-")) {
+			if (peek().kind == Token::Number) {
+				pushConstant(-next().value);
+			} else {
+				unary();
+				emit(OP_NEG);
+			}
+		} else if (acceptSymbol("!") || acceptName("not")) {
+			unary();
+			emit(OP_NOT);
+		} else {
+			primary();
+		}
+	}
+
+	void primary() {
+		const Token& token = next();
+		if (token.kind == Token::Number) {
+			pushConstant(token.value);
+		} else if (token.kind == Token::Symbol && token.text == "(") {
+			expression();
+			expectSymbol(")");
+		} else if (token.kind == Token::Name && (token.text == "current" || token.text == "state")) {
+			bool current = token.text == "current";
+			expectSymbol("(");
+			expression();
+			expectSymbol(")");
+			if (current) {
+				emit(OP_READ, READ_CURRENT);
+			} else {
+				emit(OP_STATE);
+			}
+		} else if (token.kind == Token::Name && token.text == "main") {
+			emit(OP_READ, READ_MAIN);
+		} else if (token.kind == Token::Name && token.text == "alt") {
+			emit(OP_READ, READ_ALT);
+		} else if (token.kind == Token::Name && token.text == "ext1") {
+			emit(OP_READ, READ_EXT1);
+		} else if (token.kind == Token::Name && token.text == "ext2") {
+			emit(OP_READ, READ_EXT2);
+		} else if (token.kind == Token::Name && token.text == "temp") {
+			emit(OP_READ, READ_TEMP);
+		} else if (token.kind == Token::Name && !isReserved(token.text)) {
+			emit(OP_LOAD, variable(token.text, false));
+		} else if (token.kind == Token::End) {
+			throw CompileError{"expected a value"};
+		} else {
+			throw CompileError{"unexpected '" + token.text + "'"};
+		}
+	}
+};
+
+} // namespace
+
+std::optional<std::vector<uint8_t>> compileScript(const std::string& source, std::string& error) {
+	Compiler compiler;
+	std::istringstream lines(source);
+	std::string line;
+	int number = 0;
+
+	try {
+		while (std::getline(lines, line)) {
+			number++;
+			compiler.statement(tokenize(line));
+		}
+		number = 0;
+		compiler.finish();
+	} catch (const CompileError& e) {
+		error = number ? "line " + std::to_string(number) + ": " + e.message : e.message;
+		return std::nullopt;
+	}
+	return compiler.code;
+}
+
+std::vector<std::string> scriptCommands(const std::vector<uint8_t>& code) {
+	std::vector<std::string> commands;
+	for (size_t offset = 0; offset < code.size(); offset += SETSCRIPT_BYTES) {
+		std::string command = "SETSCRIPT " + std::to_string(offset) + " ";
+		for (size_t i = offset; i < code.size() && i < offset + SETSCRIPT_BYTES; i++) {
+			char hex[3];
+			std::snprintf(hex, sizeof(hex), "%02X", code[i]);
+			command += hex;
+		}
+		commands.push_back(command);
+	}
+	return commands;
+}
+
+} // namespace k7nvh
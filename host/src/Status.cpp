@@ -0,0 +1,121 @@
+/* (c) 2017 Nigel Vander Houwen */
+
+#include "k7nvh/Status.h"
+
+#include <cstdlib>
+
+namespace k7nvh {
+
+namespace {
+
+// Number of fields following the name on a port line
+constexpr size_t PORT_TRAILING_FIELDS = 7;
+
+bool toDouble(const std::string& field, double& value) {
+	if (field.empty()) return false;
+	char* end = nullptr;
+	value = std::strtod(field.c_str(), &end);
+	return *end == 0;
+}
+
+bool toInt(const std::string& field, int& value) {
+	if (field.empty()) return false;
+	char* end = nullptr;
+	value = static_cast<int>(std::strtol(field.c_str(), &end, 10));
+	return *end == 0;
+}
+
+bool toFlag(const std::string& field, bool& value) {
+	int flag = 0;
+	if (!toInt(field, flag)) return false;
+	value = flag != 0;
+	return true;
+}
+
+std::string join(const std::vector<std::string>& fields, size_t first, size_t last) {
+	std::string joined;
+	for (size_t i = first; i < last; i++) {
+		if (i > first) joined += ',';
+		joined += fields[i];
+	}
+	return joined;
+}
+
+std::optional<PortStatus> parsePort(const std::string& line) {
+	std::vector<std::string> fields = splitFields(line);
+	if (fields.size() < PORT_TRAILING_FIELDS + 2) return std::nullopt;
+
+	PortStatus port;
+	size_t flags = fields.size() - PORT_TRAILING_FIELDS;
+	port.name = join(fields, 1, flags);
+	if (!toInt(fields[0], port.number) ||
+	    !toFlag(fields[flags], port.enabled) ||
+	    !toDouble(fields[flags + 1], port.current) ||
+	    !toDouble(fields[flags + 2], port.power) ||
+	    !toFlag(fields[flags + 3], port.overload) ||
+	    !toFlag(fields[flags + 4], port.voltageControl) ||
+	    !toFlag(fields[flags + 5], port.altBus) ||
+	    !toFlag(fields[flags + 6], port.locked)) {
+		return std::nullopt;
+	}
+	return port;
+}
+
+} // namespace
+
+std::vector<std::string> splitFields(const std::string& line) {
+	std::vector<std::string> fields;
+	size_t start = 0;
+	while (true) {
+		size_t comma = line.find(',', start);
+		fields.push_back(line.substr(start, comma - start));
+		if (comma == std::string::npos) break;
+		start = comma + 1;
+	}
+	return fields;
+}
+
+std::optional<Status> parseStatus(const std::vector<std::string>& lines) {
+	if (lines.size() < 2) return std::nullopt;
+
+	Status status;
+	std::vector<std::string> header = splitFields(lines[0]);
+	if (header.size() < 3) return std::nullopt;
+	status.description = header[0];
+	status.version = header[1];
+	status.name = join(header, 2, header.size());
+
+	// Older firmware stops after the temperature or the EXT inputs, so those are optional
+	std::vector<std::string> bus = splitFields(lines[1]);
+	if (bus.size() < 3 ||
+	    !toDouble(bus[0], status.mainVoltage) ||
+	    !toDouble(bus[1], status.altVoltage) ||
+	    !toDouble(bus[2], status.temperature)) {
+		return std::nullopt;
+	}
+	if (bus.size() >= 5 && (!toDouble(bus[3], status.ext1Voltage) || !toDouble(bus[4], status.ext2Voltage))) {
+		return std::nullopt;
+	}
+	if (bus.size() >= 6 && !toDouble(bus[5], status.time)) return std::nullopt;
+
+	for (size_t i = 2; i < lines.size(); i++) {
+		std::optional<PortStatus> port = parsePort(lines[i]);
+		if (!port) return std::nullopt;
+		status.ports.push_back(*port);
+	}
+	return status;
+}
+
+std::optional<Event> parseEvent(const std::string& line) {
+	static const std::string prefix = "!EVENT,";
+	if (line.compare(0, prefix.size(), prefix) != 0) return std::nullopt;
+
+	std::vector<std::string> fields = splitFields(line.substr(prefix.size()));
+	Event event;
+	if (fields.size() < 2 || fields.size() > 3 || fields[0].empty() || !toInt(fields[1], event.port)) return std::nullopt;
+	if (fields.size() == 3 && !toDouble(fields[2], event.time)) return std::nullopt;
+	event.type = fields[0];
+	return event;
+}
+
+} // namespace k7nvh
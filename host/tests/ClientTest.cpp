@@ -0,0 +1,198 @@
+/* (c) 2017 Nigel Vander Houwen */
+//
+// Client request pipelining, against a pty standing in for the PDU. The test plays the
+// PDU's side on the pty master, with canned quiet mode responses.
+
+#include "k7nvh/Client.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "Test.h"
+
+using k7nvh::Client;
+
+namespace {
+
+// The PDU's side of a pty
+class FakeLine {
+public:
+	FakeLine() {
+		master_ = posix_openpt(O_RDWR | O_NOCTTY);
+		if (master_ >= 0 && (grantpt(master_) != 0 || unlockpt(master_) != 0)) {
+			::close(master_);
+			master_ = -1;
+		}
+	}
+	~FakeLine() {
+		if (master_ >= 0) ::close(master_);
+	}
+
+	bool ok() const { return master_ >= 0; }
+	std::string path() const { return ptsname(master_); }
+
+	void send(const std::string& text) {
+		size_t written = 0;
+		while (written < text.size()) {
+			ssize_t count = ::write(master_, text.data() + written, text.size() - written);
+			if (count < 0 && errno == EINTR) continue;
+			if (count < 0) return;
+			written += count;
+		}
+	}
+
+	// Everything the client has written, once it has been quiet for a moment
+	std::string receive() {
+		std::string text;
+		char buffer[256];
+		struct pollfd pfd = {master_, POLLIN, 0};
+		while (poll(&pfd, 1, 50) > 0) {
+			ssize_t count = ::read(master_, buffer, sizeof(buffer));
+			if (count <= 0) break;
+			text.append(buffer, count);
+		}
+		return text;
+	}
+
+private:
+	int master_ = -1;
+};
+
+// Wait for the client's side of the pty to have input, and hand it to the client
+void deliver(Client& client) {
+	struct pollfd pfd = {client.fd(), POLLIN, 0};
+	if (poll(&pfd, 1, 1000) > 0) client.handleReadable();
+}
+
+// Open a client on the line and take it through synchronisation
+void connect(FakeLine& line, Client& client) {
+	REQUIRE(client.open());
+	client.handleWritable();
+	CHECK_EQ(line.receive(), std::string("\x03QUIET ON\r"));
+
+	// A stale response from before the sync, then the QUIET ON response
+	line.send("1,,1,0.00,0.0,0,0,0,0\r\n.\r\n");
+	deliver(client);
+	CHECK(!client.isReady());
+	client.tick(Client::Clock::now() + Client::SYNC_SETTLE);
+	REQUIRE(client.isReady());
+}
+
+} // namespace
+
+TEST(Client, Pipelined) {
+	FakeLine line;
+	REQUIRE(line.ok());
+	Client client(line.path());
+	connect(line, client);
+
+	std::vector<Client::Response> responses;
+	std::vector<k7nvh::Event> events;
+	client.setEventHandler([&events](const k7nvh::Event& event) { events.push_back(event); });
+	auto keep = [&responses](const Client::Response& response) { responses.push_back(response); };
+
+	// Only MAX_IN_FLIGHT commands go on the wire before responses come back
+	const char* commands[] = {"PSTATUS", "NOPE", "TIME", "PON 3", "POFF 3"};
+	for (const char* command : commands) CHECK(client.request(command, keep));
+	CHECK_EQ(client.pending(), 5u);
+	client.handleWritable();
+	CHECK_EQ(line.receive(), std::string("PSTATUS\rNOPE\rTIME\rPON 3\r"));
+
+	// Responses are matched to commands in order, with events passed through wherever
+	// they fall, even in the middle of a response
+	line.send(
+		"K7NVH PoE PDU,1.3,\r\n"
+		"!EVENT,OVERLOAD,3,12.500\r\n"
+		"23.99,12.00,25,0.00,0.00,12.510\r\n"
+		"3,,0,0.00,0.0,1,0,0,0\r\n"
+		".\r\n"
+		"INVALID COMMAND\r\n"
+		".\r\n"
+		"TIME: 12.520\r\n"
+		"UPTIME: 12520\r\n"
+		".\r\n");
+	deliver(client);
+	REQUIRE(responses.size() == 3);
+	CHECK_EQ(responses[0].command, "PSTATUS");
+	CHECK(responses[0].ok);
+	CHECK_EQ(responses[0].lines.size(), 3u);
+	std::optional<k7nvh::Status> status = k7nvh::parseStatus(responses[0].lines);
+	REQUIRE(status);
+	CHECK(status->ports[0].overload);
+
+	CHECK_EQ(responses[1].command, "NOPE");
+	CHECK(!responses[1].ok);
+
+	CHECK_EQ(responses[2].command, "TIME");
+	CHECK(responses[2].ok);
+	CHECK_EQ(responses[2].lines.size(), 2u);
+
+	REQUIRE(events.size() == 1);
+	CHECK_EQ(events[0].type, "OVERLOAD");
+	CHECK_EQ(events[0].port, 3);
+
+	// The completed responses made room for the last command
+	client.handleWritable();
+	CHECK_EQ(line.receive(), std::string("POFF 3\r"));
+	CHECK_EQ(client.pending(), 2u);
+
+	// A response split across reads is put back together
+	line.send("PORT 3 ENA");
+	deliver(client);
+	line.send("BLED\r\n.\r\nPORT 3 DISABLED\r\n.\r\n");
+	deliver(client);
+	REQUIRE(responses.size() == 5);
+	CHECK_EQ(responses[3].command, "PON 3");
+	REQUIRE(responses[3].lines.size() == 1);
+	CHECK_EQ(responses[3].lines[0], "PORT 3 ENABLED");
+	CHECK_EQ(responses[4].lines[0], "PORT 3 DISABLED");
+	CHECK_EQ(client.pending(), 0u);
+}
+
+TEST(Client, Rejects) {
+	FakeLine line;
+	REQUIRE(line.ok());
+	Client client(line.path());
+
+	auto ignore = [](const Client::Response&) {};
+	CHECK(!client.request("PSTATUS", ignore));
+	connect(line, client);
+
+	CHECK(!client.request(std::string(Client::MAX_COMMAND_LEN + 1, 'A'), ignore));
+	CHECK(!client.request("PON 1\rPOFF 1", ignore));
+	CHECK_EQ(client.pending(), 0u);
+}
+
+TEST(Client, CloseFailsPending) {
+	FakeLine line;
+	REQUIRE(line.ok());
+	Client client(line.path());
+	connect(line, client);
+
+	std::vector<Client::Response> responses;
+	auto keep = [&responses](const Client::Response& response) { responses.push_back(response); };
+	for (int i = 0; i < 6; i++) CHECK(client.request("PSTATUS", keep));
+	client.close();
+
+	// In flight and still queued alike
+	CHECK_EQ(responses.size(), 6u);
+	for (const Client::Response& response : responses) CHECK(!response.ok);
+}
+
+TEST(Client, ResponseTimeout) {
+	FakeLine line;
+	REQUIRE(line.ok());
+	Client client(line.path());
+	connect(line, client);
+
+	bool answered = false;
+	CHECK(client.request("PSTATUS", [&answered](const Client::Response& response) { answered = !response.ok; }));
+	client.handleWritable();
+	client.tick(Client::Clock::now() + Client::RESPONSE_TIMEOUT);
+	CHECK(answered);
+	CHECK(!client.isOpen());
+	CHECK_EQ(client.error(), "response timeout");
+}
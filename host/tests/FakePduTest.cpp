@@ -0,0 +1,402 @@
+/* (c) 2017 Nigel Vander Houwen */
+//
+// End to end tests, running the firmware under fakepdu and driving it with the client
+// library as pductl and pduscript do, or sampling it with pdu_exporter.
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <functional>
+#include <netinet/in.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+#include "k7nvh/Client.h"
+#include "k7nvh/Fleet.h"
+#include "k7nvh/Script.h"
+#include "k7nvh/Status.h"
+
+#include "Test.h"
+
+using k7nvh::Client;
+
+namespace {
+
+// A fakepdu process, with its EEPROM, control file and pty link in a scratch directory
+class FakePdu {
+public:
+	FakePdu() {
+		char dir[] = "/tmp/k7nvh_testXXXXXX";
+		if (mkdtemp(dir) == nullptr) return;
+		dir_ = dir;
+		control("load=0.5,0.5,0,0,0,0,0,0,0,0,0,0");
+
+		pid_ = fork();
+		if (pid_ == 0) {
+			int null = ::open("/dev/null", O_WRONLY);
+			dup2(null, STDOUT_FILENO);
+			dup2(null, STDERR_FILENO);
+			setenv("FAKEPDU_EEPROM", (dir_ + "/eeprom").c_str(), 1);
+			setenv("FAKEPDU_CONTROL", (dir_ + "/control").c_str(), 1);
+			setenv("FAKEPDU_LINK", link().c_str(), 1);
+			execl(FAKEPDU_PATH, "fakepdu", static_cast<char*>(nullptr));
+			_exit(127);
+		}
+
+		// Ready once the pty link is in place
+		struct stat st;
+		for (int i = 0; i < 100 && lstat(link().c_str(), &st) != 0; i++) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		}
+	}
+
+	~FakePdu() {
+		if (pid_ > 0) {
+			kill(pid_, SIGTERM);
+			waitpid(pid_, nullptr, 0);
+		}
+		if (dir_.empty()) return;
+		unlink(link().c_str());
+		unlink((dir_ + "/eeprom").c_str());
+		unlink((dir_ + "/control").c_str());
+		rmdir(dir_.c_str());
+	}
+
+	std::string link() const { return dir_ + "/pdu"; }
+
+	bool ok() const {
+		struct stat st;
+		return pid_ > 0 && lstat(link().c_str(), &st) == 0;
+	}
+
+	// Replace the simulated loads and voltages
+	void control(const std::string& settings) {
+		std::string path = dir_ + "/control";
+		std::string temp = path + ".new";
+		FILE* f = std::fopen(temp.c_str(), "w");
+		if (f == nullptr) return;
+		std::fprintf(f, "%s\n", settings.c_str());
+		std::fclose(f);
+		std::rename(temp.c_str(), path.c_str());
+	}
+
+private:
+	std::string dir_;
+	pid_t pid_ = -1;
+};
+
+// A client on a FakePdu, run to completion a batch of commands at a time
+class Session {
+public:
+	explicit Session(const FakePdu& pdu) : client_(pdu.link()) {
+		client_.setEventHandler([this](const k7nvh::Event& event) { events.push_back(event); });
+		if (client_.open()) fleet_.add(client_);
+	}
+	~Session() {
+		if (client_.isOpen()) fleet_.remove(client_);
+	}
+
+	bool ok() const { return client_.isOpen(); }
+
+	// Send commands pipelined, and wait for their responses
+	std::vector<Client::Response> run(const std::vector<std::string>& commands) {
+		std::vector<Client::Response> responses;
+		for (const std::string& command : commands) {
+			client_.request(command, [&responses](const Client::Response& response) { responses.push_back(response); });
+		}
+		fleet_.runUntilIdle(5000);
+		return responses;
+	}
+
+	// Poll until an event of this type arrives, or the timeout passes
+	bool waitForEvent(const std::string& type, int timeoutMs) {
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+		while (std::chrono::steady_clock::now() < deadline) {
+			for (const k7nvh::Event& event : events) {
+				if (event.type == type) return true;
+			}
+			fleet_.poll(50);
+		}
+		return false;
+	}
+
+	std::vector<k7nvh::Event> events;
+
+private:
+	k7nvh::Fleet fleet_;
+	Client client_;
+};
+
+// A pdu_exporter process sampling one PDU, serving metrics on a free loopback port
+class Exporter {
+public:
+	explicit Exporter(const std::string& device) {
+		// Let the kernel pick a port, and hand it to the exporter
+		int fd = socket(AF_INET, SOCK_STREAM, 0);
+		struct sockaddr_in addr = {};
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		socklen_t len = sizeof(addr);
+		if (bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0 &&
+			getsockname(fd, reinterpret_cast<struct sockaddr*>(&addr), &len) == 0) {
+			port_ = ntohs(addr.sin_port);
+		}
+		::close(fd);
+		if (port_ == 0) return;
+
+		std::string listen = "127.0.0.1:" + std::to_string(port_);
+		pid_ = fork();
+		if (pid_ == 0) {
+			int null = ::open("/dev/null", O_WRONLY);
+			dup2(null, STDOUT_FILENO);
+			dup2(null, STDERR_FILENO);
+			execl(EXPORTER_PATH, "pdu_exporter", "-l", listen.c_str(), "-i", "100", "-d", device.c_str(),
+				static_cast<char*>(nullptr));
+			_exit(127);
+		}
+	}
+
+	~Exporter() {
+		if (pid_ > 0) {
+			kill(pid_, SIGTERM);
+			waitpid(pid_, nullptr, 0);
+		}
+	}
+
+	bool ok() const { return pid_ > 0; }
+
+	// GET /metrics, returning the body of a 200 response, or nothing
+	std::string scrape() const {
+		int fd = socket(AF_INET, SOCK_STREAM, 0);
+		struct sockaddr_in addr = {};
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = htons(port_);
+		std::string response;
+		if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0) {
+			const char request[] = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n";
+			if (send(fd, request, sizeof(request) - 1, MSG_NOSIGNAL) == sizeof(request) - 1) {
+				char buffer[4096];
+				ssize_t count;
+				while ((count = ::read(fd, buffer, sizeof(buffer))) > 0) response.append(buffer, count);
+			}
+		}
+		::close(fd);
+
+		size_t body = response.find("\r\n\r\n");
+		if (response.compare(0, 15, "HTTP/1.1 200 OK") != 0 || body == std::string::npos) return "";
+		return response.substr(body + 4);
+	}
+
+	// Scrape until the metrics pass the check, or the timeout does
+	std::string waitFor(const std::function<bool(const std::string&)>& check, int timeoutMs) const {
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+		std::string metrics;
+		while (std::chrono::steady_clock::now() < deadline) {
+			metrics = scrape();
+			if (check(metrics)) break;
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		}
+		return metrics;
+	}
+
+private:
+	uint16_t port_ = 0;
+	pid_t pid_ = -1;
+};
+
+// The value of the first sample of a metric that has all of these labels, or NaN
+double metricValue(const std::string& metrics, const std::string& name, const std::vector<std::string>& labels = {}) {
+	std::istringstream lines(metrics);
+	std::string line;
+	while (std::getline(lines, line)) {
+		if (line.compare(0, name.size() + 1, name + "{") != 0) continue;
+		bool match = true;
+		for (const std::string& label : labels) {
+			if (line.find(label) == std::string::npos) match = false;
+		}
+		if (match) return std::strtod(line.c_str() + line.rfind(' ') + 1, nullptr);
+	}
+	return NAN;
+}
+
+// The number after "key": in a JSON document, or -1
+double jsonNumber(const std::string& json, const std::string& key, size_t from = 0) {
+	size_t at = json.find("\"" + key + "\":", from);
+	if (at == std::string::npos) return -1;
+	return std::strtod(json.c_str() + at + key.size() + 3, nullptr);
+}
+
+size_t countOf(const std::string& text, const std::string& what) {
+	size_t count = 0;
+	for (size_t at = text.find(what); at != std::string::npos; at = text.find(what, at + 1)) count++;
+	return count;
+}
+
+} // namespace
+
+TEST(FakePdu, StatusAndEvents) {
+	FakePdu pdu;
+	REQUIRE(pdu.ok());
+	Session session(pdu);
+	REQUIRE(session.ok());
+
+	std::vector<Client::Response> responses = session.run({"PSTATUS", "JSTATUS", "SETLIMIT 2 1000"});
+	REQUIRE(responses.size() == 3);
+	for (const Client::Response& response : responses) CHECK(response.ok);
+
+	std::optional<k7nvh::Status> status = k7nvh::parseStatus(responses[0].lines);
+	REQUIRE(status);
+	CHECK_EQ(status->description, "K7NVH PoE PDU");
+	REQUIRE(status->ports.size() == 12);
+	CHECK(status->mainVoltage > 23 && status->mainVoltage < 25);
+	CHECK(status->ports[1].enabled);
+	CHECK(status->ports[1].current > 0.45 && status->ports[1].current < 0.55);
+
+	// JSTATUS is one line reporting the same ports
+	REQUIRE(responses[1].lines.size() == 1);
+	const std::string& json = responses[1].lines[0];
+	CHECK(json.front() == '{' && json.back() == '}');
+	CHECK_EQ(countOf(json, "{"), countOf(json, "}"));
+	CHECK_EQ(countOf(json, "\"port\":"), 12u);
+	CHECK(jsonNumber(json, "main") > 23 && jsonNumber(json, "main") < 25);
+	double current = jsonNumber(json, "current", json.find("\"port\":2,"));
+	CHECK(current > 0.45 && current < 0.55);
+
+	// Going past the 1A limit set on port 2 trips it, with an event
+	pdu.control("load=0.5,3,0,0,0,0,0,0,0,0,0,0");
+	REQUIRE(session.waitForEvent("OVERLOAD", 3000));
+	for (const k7nvh::Event& event : session.events) {
+		if (event.type == "OVERLOAD") CHECK_EQ(event.port, 2);
+	}
+
+	responses = session.run({"PSTATUS"});
+	REQUIRE(responses.size() == 1);
+	status = k7nvh::parseStatus(responses[0].lines);
+	REQUIRE(status && status->ports.size() == 12);
+	CHECK(!status->ports[1].enabled);
+	CHECK(status->ports[1].overload);
+	CHECK(status->ports[0].enabled);
+}
+
+TEST(FakePdu, Script) {
+	FakePdu pdu;
+	REQUIRE(pdu.ok());
+	Session session(pdu);
+	REQUIRE(session.ok());
+
+	// Once the current limit check has read port 1 drawing its 0.5A, the script turns
+	// port 2 off and stops
+	std::string error;
+	std::optional<std::vector<uint8_t>> code = k7nvh::compileScript(
+		"while current(1) < 400 or current(1) > 600\n"
+		"  yield\n"
+		"end\n"
+		"wait 100\n"
+		"off 2\n", error);
+	REQUIRE(code);
+
+	std::vector<std::string> commands = k7nvh::scriptCommands(*code);
+	commands.push_back("SCRIPT RUN");
+	std::vector<Client::Response> responses = session.run(commands);
+	REQUIRE(responses.size() == commands.size());
+	for (const Client::Response& response : responses) CHECK(response.ok);
+
+	REQUIRE(session.waitForEvent("SCRIPT", 3000));
+	for (const k7nvh::Event& event : session.events) {
+		if (event.type == "SCRIPT") CHECK_EQ(event.port, 2);
+	}
+
+	responses = session.run({"PSTATUS", "SCRIPT"});
+	REQUIRE(responses.size() == 2);
+	std::optional<k7nvh::Status> status = k7nvh::parseStatus(responses[0].lines);
+	REQUIRE(status && status->ports.size() == 12);
+	CHECK(status->ports[0].enabled);
+	CHECK(!status->ports[1].enabled);
+	REQUIRE(responses[1].lines.size() == 1);
+	CHECK_EQ(responses[1].lines[0].compare(0, 16, "SCRIPT: STOPPED,"), 0);
+}
+
+TEST(FakePdu, ScriptRunsOffEnd) {
+	FakePdu pdu;
+	REQUIRE(pdu.ok());
+	Session session(pdu);
+	REQUIRE(session.ok());
+
+	// Code with no HALT runs off the end of its 255 bytes, which faults rather than stops
+	std::vector<uint8_t> code(255, 0x18); // YIELD
+	std::vector<std::string> commands = k7nvh::scriptCommands(code);
+	CHECK_EQ(commands.size(), size_t(32));
+	commands.push_back("SCRIPT RUN");
+	std::vector<Client::Response> responses = session.run(commands);
+	REQUIRE(responses.size() == commands.size());
+	for (const Client::Response& response : responses) CHECK(response.ok);
+
+	// One YIELD runs each tick
+	std::string state;
+	for (int i = 0; i < 100; i++) {
+		responses = session.run({"SCRIPT"});
+		REQUIRE(responses.size() == 1 && responses[0].lines.size() == 1);
+		state = responses[0].lines[0];
+		if (state.compare(0, 16, "SCRIPT: RUNNING,") != 0) break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+	CHECK_EQ(state.compare(0, 18, "SCRIPT: FAULT,255,"), 0);
+}
+
+TEST(Exporter, Metrics) {
+	FakePdu pdu;
+	REQUIRE(pdu.ok());
+	{
+		Session session(pdu);
+		REQUIRE(session.ok());
+		std::vector<Client::Response> responses = session.run({"SETLIMIT 2 1000"});
+		REQUIRE(responses.size() == 1 && responses[0].ok);
+	}
+
+	Exporter exporter(pdu.link());
+	REQUIRE(exporter.ok());
+	const std::string device = "pdu=\"" + pdu.link() + "\"";
+
+	// Up once it has connected, and sampled twice so there is energy to integrate
+	std::string metrics = exporter.waitFor([&](const std::string& m) {
+		return metricValue(m, "k7nvh_pdu_up", {device}) == 1 && metricValue(m, "k7nvh_pdu_samples_total", {device}) >= 2;
+	}, 5000);
+	REQUIRE(metricValue(metrics, "k7nvh_pdu_up", {device}) == 1);
+	CHECK_EQ(metrics.compare(0, 26, "# TYPE k7nvh_pdu_up gauge\n"), 0);
+	CHECK_EQ(metrics.substr(metrics.size() - 6), "# EOF\n");
+	CHECK_EQ(countOf(metrics, "k7nvh_port_current_amperes{"), 12u);
+	CHECK_EQ(countOf(metrics, "# UNIT k7nvh_port_current_amperes amperes\n"), 1u);
+
+	double main = metricValue(metrics, "k7nvh_bus_voltage_volts", {device, "bus=\"main\""});
+	CHECK(main > 23 && main < 25);
+	double current = metricValue(metrics, "k7nvh_port_current_amperes", {device, "port=\"1\""});
+	CHECK(current > 0.45 && current < 0.55);
+	double power = metricValue(metrics, "k7nvh_port_power_watts", {device, "port=\"1\""});
+	CHECK(power > 11 && power < 13);
+	CHECK_EQ(metricValue(metrics, "k7nvh_port_current_amperes", {device, "port=\"3\""}), 0.0);
+	CHECK_EQ(metricValue(metrics, "k7nvh_port_enabled", {device, "port=\"2\""}), 1.0);
+	CHECK_EQ(metricValue(metrics, "k7nvh_port_overload", {device, "port=\"2\""}), 0.0);
+	CHECK(metricValue(metrics, "k7nvh_port_energy_joules_total", {device, "port=\"1\""}) > 0);
+	CHECK_EQ(metricValue(metrics, "k7nvh_port_energy_joules_total", {device, "port=\"3\""}), 0.0);
+
+	// Going past the 1A limit on port 2 trips it. The event is counted, and the port's
+	// state follows on the next sample.
+	pdu.control("load=0.5,3,0,0,0,0,0,0,0,0,0,0");
+	const std::vector<std::string> port2 = {device, "port=\"2\""};
+	metrics = exporter.waitFor([&](const std::string& m) {
+		return metricValue(m, "k7nvh_port_overload", port2) == 1;
+	}, 5000);
+	CHECK_EQ(metricValue(metrics, "k7nvh_port_overload", port2), 1.0);
+	CHECK_EQ(metricValue(metrics, "k7nvh_port_enabled", port2), 0.0);
+	CHECK_EQ(metricValue(metrics, "k7nvh_port_events_total", {device, "port=\"2\"", "type=\"OVERLOAD\""}), 1.0);
+	CHECK_EQ(metricValue(metrics, "k7nvh_port_enabled", {device, "port=\"1\""}), 1.0);
+}
@@ -0,0 +1,164 @@
+/* (c) 2017 Nigel Vander Houwen */
+//
+// Script compiler output, byte for byte. The expected code is written with the opcode
+// values below, which are checked against the firmware's VM definitions.
+
+#include "k7nvh/Script.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <map>
+
+#include "Test.h"
+
+namespace {
+
+enum : uint8_t {
+	HALT = 0x00, PUSH8 = 0x01, PUSH16 = 0x02, LOAD = 0x03, STORE = 0x04, ADD = 0x07, SUB = 0x08, MUL = 0x09,
+	DIV = 0x0A, NEG = 0x0B, EQ = 0x0C, LT = 0x0D, GT = 0x0E, NOT = 0x0F, AND = 0x10, OR = 0x11, JMP = 0x12, JZ = 0x13,
+	PORTS = 0x14, READ = 0x15, STATE = 0x16, WAIT = 0x17, YIELD = 0x18,
+};
+enum : uint8_t { OFF = 0, ON = 1, CYCLE = 2 };
+enum : uint8_t { CURRENT = 0, MAIN = 1, ALT = 2, EXT1 = 3, EXT2 = 4, TEMP = 5 };
+
+using Code = std::vector<uint8_t>;
+
+std::string hex(const Code& code) {
+	static const char digits[] = "0123456789ABCDEF";
+	std::string text;
+	for (uint8_t byte : code) {
+		text += digits[byte >> 4];
+		text += digits[byte & 0x0F];
+		text += ' ';
+	}
+	return text;
+}
+
+Code compile(const std::string& source) {
+	std::string error;
+	std::optional<Code> code = k7nvh::compileScript(source, error);
+	if (!code) {
+		::k7nvh::test::fail(__FILE__, __LINE__, "compile failed: " + error);
+		return {};
+	}
+	return *code;
+}
+
+std::string compileError(const std::string& source) {
+	std::string error;
+	if (k7nvh::compileScript(source, error)) return "compiled";
+	return error;
+}
+
+// The #define values in the firmware header, by name
+std::map<std::string, long> firmwareDefines() {
+	std::map<std::string, long> defines;
+	std::ifstream header(FIRMWARE_HEADER);
+	std::string directive, name, value;
+	while (header >> directive) {
+		if (directive != "#define" || !(header >> name >> value)) continue;
+		char* end = nullptr;
+		long number = std::strtol(value.c_str(), &end, 0);
+		if (*end == 0) defines[name] = number;
+	}
+	return defines;
+}
+
+} // namespace
+
+#define CHECK_CODE(actual, expected) CHECK_EQ(hex(actual), hex(expected))
+
+TEST(Script, MatchesFirmware) {
+	std::map<std::string, long> defines = firmwareDefines();
+	REQUIRE(!defines.empty());
+
+	const std::pair<const char*, uint8_t> values[] = {
+		{"OP_HALT", HALT}, {"OP_PUSH8", PUSH8}, {"OP_PUSH16", PUSH16}, {"OP_LOAD", LOAD}, {"OP_STORE", STORE},
+		{"OP_ADD", ADD}, {"OP_SUB", SUB}, {"OP_MUL", MUL}, {"OP_DIV", DIV}, {"OP_NEG", NEG}, {"OP_EQ", EQ}, {"OP_LT", LT},
+		{"OP_GT", GT}, {"OP_NOT", NOT}, {"OP_AND", AND}, {"OP_OR", OR}, {"OP_JMP", JMP}, {"OP_JZ", JZ},
+		{"OP_PORTS", PORTS}, {"OP_READ", READ}, {"OP_STATE", STATE}, {"OP_WAIT", WAIT}, {"OP_YIELD", YIELD},
+		{"ACTION_OFF", OFF}, {"ACTION_ON", ON}, {"ACTION_CYCLE", CYCLE},
+		{"READ_CURRENT", CURRENT}, {"READ_MAIN", MAIN}, {"READ_ALT", ALT}, {"READ_EXT1", EXT1},
+		{"READ_EXT2", EXT2}, {"READ_TEMP", TEMP},
+	};
+	for (const auto& value : values) {
+		REQUIRE(defines.count(value.first));
+		if (defines[value.first] != value.second) {
+			::k7nvh::test::fail(__FILE__, __LINE__, std::string(value.first) + " differs from the firmware");
+		}
+	}
+	CHECK_EQ(defines["SCRIPT_LEN"], static_cast<long>(k7nvh::SCRIPT_LEN));
+}
+
+TEST(Script, Ports) {
+	CHECK_CODE(compile("on 1\noff 1"), (Code{PUSH8, 0x01, PORTS, ON, PUSH8, 0x01, PORTS, OFF, HALT}));
+	// Port bitmaps past 0x7F take two bytes
+	CHECK_CODE(compile("cycle 1 12"), (Code{PUSH16, 0x01, 0x08, PORTS, CYCLE, HALT}));
+	CHECK_CODE(compile("on a"), (Code{PUSH16, 0xFF, 0x0F, PORTS, ON, HALT}));
+	CHECK_CODE(compile("OFF 3 # comment\n\n# only a comment"), (Code{PUSH8, 0x04, PORTS, OFF, HALT}));
+}
+
+TEST(Script, Wait) {
+	CHECK_CODE(compile("wait 500"), (Code{PUSH16, 0xF4, 0x01, WAIT, 0, HALT}));
+	CHECK_CODE(compile("wait 2 s"), (Code{PUSH8, 0x02, WAIT, 1, HALT}));
+	CHECK_CODE(compile("wait 20 ms\nyield\nstop"), (Code{PUSH8, 20, WAIT, 0, YIELD, HALT, HALT}));
+}
+
+TEST(Script, Expressions) {
+	// Precedence, negative constants, and variables numbered as they're first set
+	CHECK_CODE(compile("let x = 1 + 2 * 3\nlet y = -5 - x"),
+		(Code{PUSH8, 1, PUSH8, 2, PUSH8, 3, MUL, ADD, STORE, 0, PUSH8, 0xFB, LOAD, 0, SUB, STORE, 1, HALT}));
+	CHECK_CODE(compile("let x = -(temp) != 3 || ext2 / 1000"),
+		(Code{READ, TEMP, NEG, PUSH8, 3, EQ, NOT, READ, EXT2, PUSH16, 0xE8, 0x03, DIV, OR, STORE, 0, HALT}));
+	CHECK_CODE(compile("let x = not alt <= 1200 and ext1 >= 0"),
+		(Code{READ, ALT, NOT, PUSH16, 0xB0, 0x04, GT, NOT, READ, EXT1, PUSH8, 0, LT, NOT, AND, STORE, 0, HALT}));
+}
+
+TEST(Script, IfElse) {
+	CHECK_CODE(compile("if state(2)\non 3\nelse\noff 3\nend"),
+		(Code{PUSH8, 2, STATE, JZ, 11, PUSH8, 0x04, PORTS, ON, JMP, 15, PUSH8, 0x04, PORTS, OFF, HALT}));
+	CHECK_CODE(compile("if state(2)\nstop\nend"), (Code{PUSH8, 2, STATE, JZ, 6, HALT, HALT}));
+}
+
+TEST(Script, While) {
+	CHECK_CODE(compile("while current(1) > 100 and main >= 2400\nyield\nend"),
+		(Code{PUSH8, 1, READ, CURRENT, PUSH8, 100, GT, READ, MAIN, PUSH16, 0x60, 0x09, LT, NOT, AND, JZ, 20,
+			YIELD, JMP, 0, HALT}));
+}
+
+TEST(Script, Errors) {
+	CHECK_EQ(compileError("on 13"), "line 1: bad port '13'");
+	CHECK_EQ(compileError("on"), "line 1: no ports");
+	CHECK_EQ(compileError("on 1\nelse"), "line 2: else without if");
+	CHECK_EQ(compileError("end"), "line 1: end without if or while");
+	CHECK_EQ(compileError("while 1\nyield"), "missing end");
+	CHECK_EQ(compileError("let x = y"), "line 1: unknown variable 'y'");
+	CHECK_EQ(compileError("let main = 1"), "line 1: 'main' can't be a variable");
+	CHECK_EQ(compileError("let x = (1"), "line 1: expected ')'");
+	CHECK_EQ(compileError("wait 1 h"), "line 1: unexpected 'h'");
+	CHECK_EQ(compileError("let x = 70000"), "line 1: number out of range: 70000");
+	CHECK_EQ(compileError("let x = 1 % 2"), "line 1: unexpected '%'");
+	CHECK_EQ(compileError("jump 1"), "line 1: unknown statement 'jump'");
+
+	std::string vars;
+	for (char name = 'a'; name <= 'i'; name++) vars += std::string("let v") + name + " = 0\n";
+	CHECK_EQ(compileError(vars), "line 9: more than 8 variables");
+
+	// 4 bytes a line, and the closing HALT, is one more than the PDU holds
+	std::string longScript;
+	for (int i = 0; i < 64; i++) longScript += "on 1\n";
+	CHECK_EQ(compileError(longScript), "script is 257 bytes, the PDU holds 255");
+}
+
+TEST(Script, Commands) {
+	std::vector<std::string> commands = k7nvh::scriptCommands(compile("on 1\noff 1"));
+	REQUIRE(commands.size() == 2);
+	CHECK_EQ(commands[0], "SETSCRIPT 0 0101140101011400");
+	CHECK_EQ(commands[1], "SETSCRIPT 8 00");
+
+	// Every command fits the console, even at the end of a full script
+	commands = k7nvh::scriptCommands(Code(k7nvh::SCRIPT_LEN, 0xAB));
+	CHECK_EQ(commands.size(), 32u);
+	for (const std::string& command : commands) CHECK(command.size() <= 31);
+	CHECK_EQ(commands.back(), "SETSCRIPT 248 ABABABABABABAB");
+}
@@ -0,0 +1,115 @@
+/* (c) 2017 Nigel Vander Houwen */
+//
+// PSTATUS and !EVENT parsing, against output captured from the firmware.
+
+#include "k7nvh/Status.h"
+
+#include "Test.h"
+
+using k7nvh::Event;
+using k7nvh::Status;
+
+namespace {
+
+// PSTATUS from current firmware, with names set on two ports, one of them holding a comma
+const std::vector<std::string> PSTATUS = {
+	"K7NVH PoE PDU,1.3,RACK,2",
+	"23.99,12.00,25,0.00,1.50,5231.250",
+	"1,CAMERA,1,0.50,12.0,0,0,0,0",
+	"2,AP, NORTH,1,3.00,71.9,1,1,1,1",
+	"3,,0,0.00,0.0,0,0,0,0",
+};
+
+} // namespace
+
+TEST(Status, Header) {
+	std::optional<Status> status = k7nvh::parseStatus(PSTATUS);
+	REQUIRE(status);
+	CHECK_EQ(status->description, "K7NVH PoE PDU");
+	CHECK_EQ(status->version, "1.3");
+	CHECK_EQ(status->name, "RACK,2");
+	CHECK_EQ(status->mainVoltage, 23.99);
+	CHECK_EQ(status->altVoltage, 12.0);
+	CHECK_EQ(status->temperature, 25.0);
+	CHECK_EQ(status->ext2Voltage, 1.5);
+	CHECK_EQ(status->time, 5231.25);
+}
+
+TEST(Status, Ports) {
+	std::optional<Status> status = k7nvh::parseStatus(PSTATUS);
+	REQUIRE(status);
+	REQUIRE(status->ports.size() == 3);
+
+	CHECK_EQ(status->ports[0].number, 1);
+	CHECK_EQ(status->ports[0].name, "CAMERA");
+	CHECK(status->ports[0].enabled);
+	CHECK_EQ(status->ports[0].current, 0.5);
+	CHECK_EQ(status->ports[0].power, 12.0);
+	CHECK(!status->ports[0].overload && !status->ports[0].locked);
+
+	CHECK_EQ(status->ports[1].name, "AP, NORTH");
+	CHECK_EQ(status->ports[1].current, 3.0);
+	CHECK(status->ports[1].overload && status->ports[1].voltageControl);
+	CHECK(status->ports[1].altBus && status->ports[1].locked);
+
+	CHECK_EQ(status->ports[2].name, "");
+	CHECK(!status->ports[2].enabled);
+}
+
+TEST(Status, OlderFirmware) {
+	// Before the EXT inputs and the clock were added
+	std::optional<Status> status = k7nvh::parseStatus({
+		"K7NVH PoE PDU,1.2,",
+		"24.10,0.00,31",
+		"1,,1,0.25,6.0,0,0,0,0",
+	});
+	REQUIRE(status);
+	CHECK_EQ(status->name, "");
+	CHECK_EQ(status->temperature, 31.0);
+	CHECK_EQ(status->ext1Voltage, 0.0);
+	CHECK_EQ(status->time, 0.0);
+	CHECK_EQ(status->ports.size(), 1u);
+}
+
+TEST(Status, Malformed) {
+	CHECK(!k7nvh::parseStatus({}));
+	CHECK(!k7nvh::parseStatus({"K7NVH PoE PDU,1.3,"}));
+	CHECK(!k7nvh::parseStatus({"K7NVH PoE PDU,1.3,", "23.99,12.00"}));
+	CHECK(!k7nvh::parseStatus({"K7NVH PoE PDU,1.3,", "23.99,12.00,25", "1,,1,0.50"}));
+	CHECK(!k7nvh::parseStatus({"K7NVH PoE PDU,1.3,", "23.99,12.00,25", "1,,1,0.50,X,0,0,0,0"}));
+	CHECK(!k7nvh::parseStatus({"INVALID COMMAND"}));
+}
+
+TEST(Event, Parse) {
+	std::optional<Event> event = k7nvh::parseEvent("!EVENT,OVERLOAD,3,1612.340");
+	REQUIRE(event);
+	CHECK_EQ(event->type, "OVERLOAD");
+	CHECK_EQ(event->port, 3);
+	CHECK_EQ(event->time, 1612.34);
+
+	// Older firmware has no timestamp
+	event = k7nvh::parseEvent("!EVENT,VCTLOFF,12");
+	REQUIRE(event);
+	CHECK_EQ(event->type, "VCTLOFF");
+	CHECK_EQ(event->port, 12);
+	CHECK_EQ(event->time, 0.0);
+}
+
+TEST(Event, Malformed) {
+	CHECK(!k7nvh::parseEvent("EVENT,OVERLOAD,3"));
+	CHECK(!k7nvh::parseEvent("!EVENT,OVERLOAD"));
+	CHECK(!k7nvh::parseEvent("!EVENT,,3"));
+	CHECK(!k7nvh::parseEvent("!EVENT,OVERLOAD,X"));
+	CHECK(!k7nvh::parseEvent("!EVENT,OVERLOAD,3,1.0,4"));
+	CHECK(!k7nvh::parseEvent("!EVENT,OVERLOAD,3,NOW"));
+}
+
+TEST(Status, SplitFields) {
+	std::vector<std::string> fields = k7nvh::splitFields(",a,,b,");
+	REQUIRE(fields.size() == 5);
+	CHECK_EQ(fields[0], "");
+	CHECK_EQ(fields[1], "a");
+	CHECK_EQ(fields[2], "");
+	CHECK_EQ(fields[3], "b");
+	CHECK_EQ(fields[4], "");
+}
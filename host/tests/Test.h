@@ -0,0 +1,59 @@
+/* (c) 2017 Nigel Vander Houwen */
+//
+// A minimal test harness for the host tools, so the tests build with nothing but the
+// compiler. TEST(Group, Name) registers a test, and CHECK/CHECK_EQ record failures
+// without stopping it. REQUIRE stops the test at the first failure.
+
+#ifndef K7NVH_TEST_H
+#define K7NVH_TEST_H
+
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace k7nvh {
+namespace test {
+
+struct Case {
+	std::string name; // "Group.Name"
+	std::function<void()> run;
+};
+
+std::vector<Case>& cases();
+void fail(const char* file, int line, const std::string& what);
+
+struct Registration {
+	Registration(const char* name, std::function<void()> run) { cases().push_back({name, std::move(run)}); }
+};
+
+// Thrown by REQUIRE to end the test
+struct Abort {};
+
+template <typename A, typename B>
+bool checkEqual(const A& actual, const B& expected, const char* file, int line, const char* text) {
+	if (actual == expected) return true;
+	std::ostringstream what;
+	what << text << ": got " << actual << ", expected " << expected;
+	fail(file, line, what.str());
+	return false;
+}
+
+} // namespace test
+} // namespace k7nvh
+
+#define TEST(group, name) \
+	static void test_##group##_##name(); \
+	static ::k7nvh::test::Registration register_##group##_##name(#group "." #name, test_##group##_##name); \
+	static void test_##group##_##name()
+
+#define CHECK(expr) \
+	do { if (!(expr)) ::k7nvh::test::fail(__FILE__, __LINE__, #expr); } while (0)
+
+#define CHECK_EQ(actual, expected) \
+	::k7nvh::test::checkEqual((actual), (expected), __FILE__, __LINE__, #actual)
+
+#define REQUIRE(expr) \
+	do { if (!(expr)) { ::k7nvh::test::fail(__FILE__, __LINE__, #expr); throw ::k7nvh::test::Abort(); } } while (0)
+
+#endif
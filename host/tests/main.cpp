@@ -0,0 +1,60 @@
+/* (c) 2017 Nigel Vander Houwen */
+//
+// Runs the registered tests, or those whose "Group.Name" starts with the argument.
+//
+//   k7nvh_tests [PREFIX]
+
+#include <cstdio>
+#include <exception>
+
+#include "Test.h"
+
+namespace k7nvh {
+namespace test {
+
+namespace {
+
+bool failed = false;
+
+} // namespace
+
+std::vector<Case>& cases() {
+	static std::vector<Case> all;
+	return all;
+}
+
+void fail(const char* file, int line, const std::string& what) {
+	std::fprintf(stderr, "%s:%d: %s\n", file, line, what.c_str());
+	failed = true;
+}
+
+} // namespace test
+} // namespace k7nvh
+
+int main(int argc, char** argv) {
+	std::string prefix = argc > 1 ? argv[1] : "";
+	int run = 0;
+	int failures = 0;
+
+	for (const k7nvh::test::Case& test : k7nvh::test::cases()) {
+		if (test.name.compare(0, prefix.size(), prefix) != 0) continue;
+
+		k7nvh::test::failed = false;
+		try {
+			test.run();
+		} catch (const k7nvh::test::Abort&) {
+		} catch (const std::exception& e) {
+			k7nvh::test::fail(__FILE__, __LINE__, std::string("exception: ") + e.what());
+		}
+		std::printf("%s %s\n", k7nvh::test::failed ? "FAIL" : "ok  ", test.name.c_str());
+		run++;
+		if (k7nvh::test::failed) failures++;
+	}
+
+	if (run == 0) {
+		std::fprintf(stderr, "no tests match \"%s\"\n", prefix.c_str());
+		return 1;
+	}
+	std::printf("%d/%d passed\n", run - failures, run);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,551 @@
+/* (c) 2017 Nigel Vander Houwen */
+//
+// OpenMetrics exporter for PDU telemetry.
+//
+//   pdu_exporter [-l ADDRESS:PORT] [-i MS] [-d DEVICE ...]
+//
+//   -l ADDRESS:PORT  Where to serve /metrics, default 127.0.0.1:9712
+//   -i MS            Sampling interval per PDU, default 1000
+//   -d DEVICE        Serial device to sample. May be repeated. Without any, attached
+//                    PDUs are found by USB ID and rescanned for as they come and go.
+//
+// Each PDU is held open and sampled with PSTATUS continuously, and scrapes are answered
+// from the latest cached sample without touching the PDUs. Port energy is integrated
+// from every sample, so nothing is lost between scrapes, and events reported by the
+// PDU are counted as they arrive. The PDU's clock is set to Unix time on connecting.
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <netdb.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+#include "k7nvh/Client.h"
+#include "k7nvh/Discovery.h"
+#include "k7nvh/Fleet.h"
+#include "k7nvh/Status.h"
+
+namespace {
+
+using Clock = k7nvh::Client::Clock;
+using Labels = std::vector<std::pair<std::string, std::string>>;
+
+constexpr std::chrono::seconds RECONNECT_DELAY{5};
+constexpr std::chrono::seconds DISCOVERY_INTERVAL{10};
+constexpr std::chrono::seconds HTTP_TIMEOUT{10};
+constexpr size_t HTTP_MAX_REQUEST = 8192;
+// Gaps longer than this many intervals aren't integrated into the energy totals
+constexpr int ENERGY_MAX_GAP = 5;
+
+volatile sig_atomic_t stopping = 0;
+
+struct Pdu {
+	std::string device;
+	std::string id; // Serial number if known, otherwise the device path
+	bool discovered = false;
+	bool connected = false;
+	std::string lastError;
+	std::unique_ptr<k7nvh::Client> client;
+
+	std::optional<k7nvh::Status> status;
+	Clock::time_point sampled; // When status was taken
+	double sampledUnix = 0;
+	Clock::time_point nextSample;
+	Clock::time_point nextConnect;
+
+	uint64_t samples = 0;
+	uint64_t errors = 0;
+	uint64_t connects = 0;
+	std::map<int, double> energy; // Port number to joules
+	std::map<std::pair<int, std::string>, uint64_t> events; // (Port, type) to count
+};
+
+struct Connection {
+	int fd = -1;
+	std::string input;
+	std::string output;
+	Clock::time_point opened;
+	bool done = false;
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~ Metrics
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+class MetricWriter {
+public:
+	void family(const char* name, const char* type, const char* unit, const char* help) {
+		out_ += "# TYPE ";
+		out_ += name;
+		out_ += ' ';
+		out_ += type;
+		out_ += '\n';
+		if (unit) {
+			out_ += "# UNIT ";
+			out_ += name;
+			out_ += ' ';
+			out_ += unit;
+			out_ += '\n';
+		}
+		out_ += "# HELP ";
+		out_ += name;
+		out_ += ' ';
+		out_ += help;
+		out_ += '\n';
+	}
+
+	void sample(const std::string& name, const Labels& labels, double value) {
+		char number[32];
+		std::snprintf(number, sizeof(number), "%.15g", value);
+
+		out_ += name;
+		if (!labels.empty()) {
+			out_ += '{';
+			for (size_t i = 0; i < labels.size(); i++) {
+				if (i > 0) out_ += ',';
+				out_ += labels[i].first;
+				out_ += "=\"";
+				escape(labels[i].second);
+				out_ += '"';
+			}
+			out_ += '}';
+		}
+		out_ += ' ';
+		out_ += number;
+		out_ += '\n';
+	}
+
+	std::string finish() {
+		out_ += "# EOF\n";
+		return std::move(out_);
+	}
+
+private:
+	void escape(const std::string& value) {
+		for (char c : value) {
+			if (c == '\\') out_ += "\\\\";
+			else if (c == '"') out_ += "\\\"";
+			else if (c == '\n') out_ += "\\n";
+			else out_ += c;
+		}
+	}
+
+	std::string out_;
+};
+
+bool isUp(const Pdu& pdu, std::chrono::milliseconds interval) {
+	std::chrono::milliseconds fresh = std::max<std::chrono::milliseconds>(interval * 3, std::chrono::seconds(5));
+	return pdu.client->isReady() && pdu.status && Clock::now() - pdu.sampled <= fresh;
+}
+
+// Emit one gauge family with a value per port of every PDU that is up
+template <typename Value>
+void portGauge(MetricWriter& writer, const std::vector<const Pdu*>& up, const char* name, const char* unit,
+		const char* help, Value value) {
+	writer.family(name, "gauge", unit, help);
+	for (const Pdu* pdu : up) {
+		for (const k7nvh::PortStatus& port : pdu->status->ports) {
+			writer.sample(name, {{"pdu", pdu->id}, {"port", std::to_string(port.number)}, {"name", port.name}}, value(port));
+		}
+	}
+}
+
+std::string renderMetrics(const std::vector<std::unique_ptr<Pdu>>& pdus, std::chrono::milliseconds interval) {
+	MetricWriter writer;
+	std::vector<const Pdu*> up;
+
+	for (const auto& pdu : pdus) {
+		if (isUp(*pdu, interval)) up.push_back(pdu.get());
+	}
+
+	writer.family("k7nvh_pdu_up", "gauge", nullptr, "Whether the PDU is connected and being sampled.");
+	for (const auto& pdu : pdus) writer.sample("k7nvh_pdu_up", {{"pdu", pdu->id}, {"device", pdu->device}}, isUp(*pdu, interval) ? 1 : 0);
+
+	writer.family("k7nvh_pdu", "info", nullptr, "PDU identity.");
+	for (const Pdu* pdu : up) {
+		writer.sample("k7nvh_pdu_info", {{"pdu", pdu->id}, {"name", pdu->status->name}, {"version", pdu->status->version}}, 1);
+	}
+
+	writer.family("k7nvh_pdu_samples", "counter", nullptr, "PSTATUS samples taken.");
+	for (const auto& pdu : pdus) writer.sample("k7nvh_pdu_samples_total", {{"pdu", pdu->id}}, pdu->samples);
+
+	writer.family("k7nvh_pdu_sample_errors", "counter", nullptr, "PSTATUS requests that failed or could not be parsed.");
+	for (const auto& pdu : pdus) writer.sample("k7nvh_pdu_sample_errors_total", {{"pdu", pdu->id}}, pdu->errors);
+
+	writer.family("k7nvh_pdu_connects", "counter", nullptr, "Connections made to the PDU.");
+	for (const auto& pdu : pdus) writer.sample("k7nvh_pdu_connects_total", {{"pdu", pdu->id}}, pdu->connects);
+
+	writer.family("k7nvh_pdu_last_sample_timestamp_seconds", "gauge", "seconds", "When the cached values were sampled.");
+	for (const Pdu* pdu : up) writer.sample("k7nvh_pdu_last_sample_timestamp_seconds", {{"pdu", pdu->id}}, pdu->sampledUnix);
+
+	writer.family("k7nvh_bus_voltage_volts", "gauge", "volts", "Bus input voltage.");
+	for (const Pdu* pdu : up) {
+		writer.sample("k7nvh_bus_voltage_volts", {{"pdu", pdu->id}, {"bus", "main"}}, pdu->status->mainVoltage);
+		writer.sample("k7nvh_bus_voltage_volts", {{"pdu", pdu->id}, {"bus", "alt"}}, pdu->status->altVoltage);
+	}
+
+	writer.family("k7nvh_ext_voltage_volts", "gauge", "volts", "EXT input voltage.");
+	for (const Pdu* pdu : up) {
+		writer.sample("k7nvh_ext_voltage_volts", {{"pdu", pdu->id}, {"input", "ext1"}}, pdu->status->ext1Voltage);
+		writer.sample("k7nvh_ext_voltage_volts", {{"pdu", pdu->id}, {"input", "ext2"}}, pdu->status->ext2Voltage);
+	}
+
+	writer.family("k7nvh_temperature_celsius", "gauge", "celsius", "CPU temperature.");
+	for (const Pdu* pdu : up) writer.sample("k7nvh_temperature_celsius", {{"pdu", pdu->id}}, pdu->status->temperature);
+
+	portGauge(writer, up, "k7nvh_port_current_amperes", "amperes", "Port current.",
+		[](const k7nvh::PortStatus& port) { return port.current; });
+	portGauge(writer, up, "k7nvh_port_power_watts", "watts", "Port power, from the current and the port's bus voltage.",
+		[](const k7nvh::PortStatus& port) { return port.power; });
+	portGauge(writer, up, "k7nvh_port_enabled", nullptr, "Whether the port is switched on.",
+		[](const k7nvh::PortStatus& port) { return port.enabled ? 1 : 0; });
+	portGauge(writer, up, "k7nvh_port_overload", nullptr, "Whether the port was switched off for exceeding its limit.",
+		[](const k7nvh::PortStatus& port) { return port.overload ? 1 : 0; });
+	portGauge(writer, up, "k7nvh_port_voltage_control", nullptr, "Whether the port is under automatic voltage control.",
+		[](const k7nvh::PortStatus& port) { return port.voltageControl ? 1 : 0; });
+	portGauge(writer, up, "k7nvh_port_alt_bus", nullptr, "Whether the port is on the ALT bus rather than MAIN.",
+		[](const k7nvh::PortStatus& port) { return port.altBus ? 1 : 0; });
+	portGauge(writer, up, "k7nvh_port_locked", nullptr, "Whether the port is locked against changes.",
+		[](const k7nvh::PortStatus& port) { return port.locked ? 1 : 0; });
+
+	writer.family("k7nvh_port_energy_joules", "counter", "joules", "Port energy integrated over every sample since the exporter started.");
+	for (const auto& pdu : pdus) {
+		for (const auto& [port, joules] : pdu->energy) {
+			writer.sample("k7nvh_port_energy_joules_total", {{"pdu", pdu->id}, {"port", std::to_string(port)}}, joules);
+		}
+	}
+
+	writer.family("k7nvh_port_events", "counter", nullptr, "Events reported by the PDU, by type.");
+	for (const auto& pdu : pdus) {
+		for (const auto& [key, count] : pdu->events) {
+			writer.sample("k7nvh_port_events_total", {{"pdu", pdu->id}, {"port", std::to_string(key.first)}, {"type", key.second}}, count);
+		}
+	}
+
+	return writer.finish();
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~ Sampling
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+void recordSample(Pdu& pdu, const k7nvh::Client::Response& response, std::chrono::milliseconds interval) {
+	std::optional<k7nvh::Status> status = response.ok ? k7nvh::parseStatus(response.lines) : std::nullopt;
+	if (!status) {
+		pdu.errors++;
+		return;
+	}
+
+	Clock::time_point now = Clock::now();
+	double seconds = std::chrono::duration<double>(now - pdu.sampled).count();
+
+	// Trapezoidal integration between consecutive samples
+	if (pdu.status && now - pdu.sampled <= interval * ENERGY_MAX_GAP) {
+		for (const k7nvh::PortStatus& port : status->ports) {
+			double previous = 0;
+			for (const k7nvh::PortStatus& before : pdu.status->ports) {
+				if (before.number == port.number) previous = before.power;
+			}
+			pdu.energy[port.number] += (previous + port.power) / 2 * seconds;
+		}
+	} else {
+		for (const k7nvh::PortStatus& port : status->ports) pdu.energy.emplace(port.number, 0);
+	}
+
+	pdu.status = std::move(status);
+	pdu.sampled = now;
+	pdu.sampledUnix = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+	pdu.samples++;
+}
+
+void connect(Pdu& pdu, Clock::time_point now) {
+	pdu.nextConnect = now + RECONNECT_DELAY;
+	pdu.status.reset();
+	if (!pdu.client->open()) {
+		// Only log when the reason changes, not on every retry
+		std::string error = std::strerror(errno);
+		if (error != pdu.lastError) std::fprintf(stderr, "%s: %s\n", pdu.device.c_str(), error.c_str());
+		pdu.lastError = error;
+		return;
+	}
+	pdu.lastError.clear();
+	std::fprintf(stderr, "%s: connected\n", pdu.device.c_str());
+	pdu.connected = true;
+	pdu.connects++;
+	pdu.nextSample = now;
+
+	// Put the PDU's clock on Unix time, so its event times line up with other logs
+	char command[32];
+	double unixTime = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+	std::snprintf(command, sizeof(command), "SETTIME %.3f", unixTime);
+	pdu.client->request(command, [](const k7nvh::Client::Response&) {});
+}
+
+std::unique_ptr<Pdu> makePdu(const std::string& device, const std::string& serial, bool discovered) {
+	auto pdu = std::make_unique<Pdu>();
+	pdu->device = device;
+	pdu->id = serial.empty() ? device : serial;
+	pdu->discovered = discovered;
+	pdu->client = std::make_unique<k7nvh::Client>(device);
+
+	Pdu* raw = pdu.get();
+	pdu->client->setEventHandler([raw](const k7nvh::Event& event) {
+		raw->events[{event.port, event.type}]++;
+		// Show the change on the next scrape rather than an interval later
+		raw->nextSample = Clock::now();
+	});
+	return pdu;
+}
+
+// Pick up newly attached PDUs and drop ones that have gone and disconnected
+void discover(k7nvh::Fleet& fleet, std::vector<std::unique_ptr<Pdu>>& pdus) {
+	std::vector<k7nvh::Device> devices = k7nvh::findDevices();
+
+	for (auto it = pdus.begin(); it != pdus.end();) {
+		Pdu& pdu = **it;
+		bool present = std::any_of(devices.begin(), devices.end(), [&](const k7nvh::Device& device) { return device.path == pdu.device; });
+		if (pdu.discovered && !present && !pdu.client->isOpen()) {
+			std::fprintf(stderr, "%s: removed\n", pdu.device.c_str());
+			fleet.remove(*pdu.client);
+			it = pdus.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	for (const k7nvh::Device& device : devices) {
+		bool known = std::any_of(pdus.begin(), pdus.end(), [&](const std::unique_ptr<Pdu>& pdu) { return pdu->device == device.path; });
+		if (known) continue;
+		std::fprintf(stderr, "%s: found PDU %s\n", device.path.c_str(), device.serial.c_str());
+		pdus.push_back(makePdu(device.path, device.serial, true));
+		fleet.add(*pdus.back()->client);
+	}
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~ HTTP
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+int listenOn(const std::string& address) {
+	size_t colon = address.rfind(':');
+	if (colon == std::string::npos) return -1;
+	std::string host = address.substr(0, colon);
+	std::string port = address.substr(colon + 1);
+	if (host.size() >= 2 && host.front() == '[' && host.back() == ']') host = host.substr(1, host.size() - 2);
+
+	struct addrinfo hints = {};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	struct addrinfo* result = nullptr;
+	if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result) != 0) return -1;
+
+	int fd = -1;
+	for (struct addrinfo* ai = result; ai != nullptr; ai = ai->ai_next) {
+		fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+		if (fd < 0) continue;
+		int yes = 1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+		if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, 16) == 0) break;
+		::close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(result);
+	return fd;
+}
+
+std::string httpResponse(const char* status, const char* type, const std::string& body, bool head) {
+	std::string response = "HTTP/1.1 ";
+	response += status;
+	response += "\r\nContent-Type: ";
+	response += type;
+	response += "\r\nContent-Length: " + std::to_string(body.size());
+	response += "\r\nConnection: close\r\n\r\n";
+	if (!head) response += body;
+	return response;
+}
+
+class HttpServer {
+public:
+	HttpServer(k7nvh::Fleet& fleet, int listener, std::function<std::string()> metrics)
+		: fleet_(fleet), listener_(listener), metrics_(std::move(metrics)) {
+		fleet_.watch(listener_, EPOLLIN, [this](uint32_t) { accept(); });
+	}
+
+	// Drop connections that have stalled, and any that have finished
+	void expire(Clock::time_point now) {
+		for (auto it = connections_.begin(); it != connections_.end();) {
+			if (it->second->done || now - it->second->opened >= HTTP_TIMEOUT) {
+				fleet_.unwatch(it->first);
+				::close(it->first);
+				it = connections_.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+
+private:
+	void accept() {
+		while (true) {
+			int fd = accept4(listener_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+			if (fd < 0) return;
+			auto connection = std::make_unique<Connection>();
+			connection->fd = fd;
+			connection->opened = Clock::now();
+			Connection* raw = connection.get();
+			connections_[fd] = std::move(connection);
+			fleet_.watch(fd, EPOLLIN, [this, raw](uint32_t events) { service(*raw, events); });
+		}
+	}
+
+	void service(Connection& connection, uint32_t events) {
+		if (connection.done) return;
+
+		if (connection.output.empty()) {
+			char buffer[1024];
+			ssize_t count;
+			while ((count = ::read(connection.fd, buffer, sizeof(buffer))) > 0) connection.input.append(buffer, count);
+			if (count == 0 || (count < 0 && errno != EAGAIN) || connection.input.size() > HTTP_MAX_REQUEST) {
+				connection.done = true;
+				return;
+			}
+			if (connection.input.find("\r\n\r\n") == std::string::npos) return;
+			connection.output = respond(connection.input);
+			fleet_.watch(connection.fd, EPOLLOUT, [this, &connection](uint32_t ready) { service(connection, ready); });
+			events |= EPOLLOUT;
+		}
+
+		if (events & EPOLLOUT) {
+			ssize_t count = send(connection.fd, connection.output.data(), connection.output.size(), MSG_NOSIGNAL);
+			if (count > 0) connection.output.erase(0, count);
+			if (connection.output.empty() || (count < 0 && errno != EAGAIN)) {
+				shutdown(connection.fd, SHUT_WR);
+				connection.done = true;
+			}
+		}
+	}
+
+	std::string respond(const std::string& request) {
+		size_t methodEnd = request.find(' ');
+		size_t pathEnd = request.find(' ', methodEnd + 1);
+		if (methodEnd == std::string::npos || pathEnd == std::string::npos) {
+			return httpResponse("400 Bad Request", "text/plain", "Bad request\n", false);
+		}
+		std::string method = request.substr(0, methodEnd);
+		std::string path = request.substr(methodEnd + 1, pathEnd - methodEnd - 1);
+		bool head = method == "HEAD";
+
+		if (method != "GET" && !head) {
+			return httpResponse("405 Method Not Allowed", "text/plain", "Method not allowed\n", false);
+		}
+		if (path == "/metrics") {
+			return httpResponse("200 OK", "application/openmetrics-text; version=1.0.0; charset=utf-8", metrics_(), head);
+		}
+		if (path == "/") {
+			return httpResponse("200 OK", "text/html", "<html><body><a href=\"/metrics\">Metrics</a></body></html>\n", head);
+		}
+		return httpResponse("404 Not Found", "text/plain", "Not found\n", head);
+	}
+
+	k7nvh::Fleet& fleet_;
+	int listener_;
+	std::function<std::string()> metrics_;
+	std::map<int, std::unique_ptr<Connection>> connections_;
+};
+
+void usage() {
+	std::fprintf(stderr, "usage: pdu_exporter [-l ADDRESS:PORT] [-i MS] [-d DEVICE ...]\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	std::string address = "127.0.0.1:9712";
+	std::chrono::milliseconds interval{1000};
+	std::vector<std::string> devices;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "l:i:d:")) != -1) {
+		switch (opt) {
+			case 'l': address = optarg; break;
+			case 'i': interval = std::chrono::milliseconds(std::max(100, std::atoi(optarg))); break;
+			case 'd': devices.push_back(optarg); break;
+			default: usage(); return 2;
+		}
+	}
+	if (optind != argc) {
+		usage();
+		return 2;
+	}
+
+	struct sigaction action = {};
+	action.sa_handler = [](int) { stopping = 1; };
+	sigaction(SIGINT, &action, nullptr);
+	sigaction(SIGTERM, &action, nullptr);
+	signal(SIGPIPE, SIG_IGN);
+
+	int listener = listenOn(address);
+	if (listener < 0) {
+		std::fprintf(stderr, "pdu_exporter: can't listen on %s\n", address.c_str());
+		return 1;
+	}
+
+	k7nvh::Fleet fleet;
+	std::vector<std::unique_ptr<Pdu>> pdus;
+	for (const std::string& device : devices) {
+		pdus.push_back(makePdu(device, "", false));
+		fleet.add(*pdus.back()->client);
+	}
+
+	HttpServer server(fleet, listener, [&pdus, interval]() { return renderMetrics(pdus, interval); });
+	Clock::time_point nextDiscovery = Clock::now();
+
+	while (!stopping) {
+		Clock::time_point now = Clock::now();
+		Clock::time_point wake = now + DISCOVERY_INTERVAL;
+
+		if (devices.empty() && now >= nextDiscovery) {
+			discover(fleet, pdus);
+			nextDiscovery = now + DISCOVERY_INTERVAL;
+		}
+		if (devices.empty()) wake = std::min(wake, nextDiscovery);
+
+		for (const auto& pdu : pdus) {
+			k7nvh::Client& client = *pdu->client;
+			if (!client.isOpen()) {
+				if (pdu->connected) {
+					std::fprintf(stderr, "%s: %s\n", pdu->device.c_str(), client.error().c_str());
+					pdu->connected = false;
+				}
+				if (now >= pdu->nextConnect) connect(*pdu, now);
+				wake = std::min(wake, pdu->nextConnect);
+				continue;
+			}
+			if (client.pending() == 0 && now >= pdu->nextSample) {
+				pdu->nextSample = now + interval;
+				Pdu* raw = pdu.get();
+				client.request("PSTATUS", [raw, interval](const k7nvh::Client::Response& response) {
+					recordSample(*raw, response, interval);
+				});
+			}
+			wake = std::min(wake, pdu->nextSample);
+		}
+
+		server.expire(now);
+		auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(wake - now).count() + 1;
+		fleet.poll(static_cast<int>(std::max<long long>(timeout, 0)));
+	}
+
+	return 0;
+}
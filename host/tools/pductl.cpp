@@ -0,0 +1,135 @@
+/* (c) 2017 Nigel Vander Houwen */
+//
+// Send commands to one or more PDUs and print the responses.
+//
+//   pductl [-s] [-w] [-t MS] [-d DEVICE ...] [-n NAME ...] [COMMAND ...]
+//
+//   -d DEVICE  Serial device of a PDU, may be repeated to address several at once.
+//   -n NAME    Attached PDU with this name or USB serial number, may be repeated.
+//              Without -d or -n, every attached PDU is addressed.
+//   -s         Print a parsed PSTATUS summary after the commands
+//   -w         Keep running and print events until interrupted
+//   -t MS      Give up if the commands haven't completed in MS milliseconds
+//
+// Commands are pipelined to each PDU, and all PDUs are served concurrently.
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "k7nvh/Client.h"
+#include "k7nvh/Discovery.h"
+#include "k7nvh/Fleet.h"
+
+namespace {
+
+void usage() {
+	std::fprintf(stderr, "usage: pductl [-s] [-w] [-t MS] [-d DEVICE ...] [-n NAME ...] [COMMAND ...]\n");
+}
+
+void printSummary(const std::string& prefix, const k7nvh::Status& status) {
+	std::printf("%s%s \"%s\" v%s  MAIN %.2fV  ALT %.2fV  %.0fC\n", prefix.c_str(), status.description.c_str(),
+		status.name.c_str(), status.version.c_str(), status.mainVoltage, status.altVoltage, status.temperature);
+	for (const k7nvh::PortStatus& port : status.ports) {
+		std::printf("%s%2d %-16s %-3s %5.2fA %5.1fW%s%s%s%s\n", prefix.c_str(), port.number, port.name.c_str(),
+			port.enabled ? "ON" : "OFF", port.current, port.power, port.altBus ? " ALT" : "",
+			port.overload ? " OVERLOAD" : "", port.voltageControl ? " VCTL" : "", port.locked ? " LOCKED" : "");
+	}
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	std::vector<std::string> devices;
+	std::vector<std::string> names;
+	bool summary = false;
+	bool watch = false;
+	int timeout = 30000;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:n:swt:")) != -1) {
+		switch (opt) {
+			case 'd': devices.push_back(optarg); break;
+			case 'n': names.push_back(optarg); break;
+			case 's': summary = true; break;
+			case 'w': watch = true; break;
+			case 't': timeout = std::atoi(optarg); break;
+			default: usage(); return 2;
+		}
+	}
+	// Names are matched against the USB strings, without opening anything
+	if (devices.empty() || !names.empty()) {
+		for (const k7nvh::Device& device : k7nvh::findDevices()) {
+			bool named = std::find(names.begin(), names.end(), device.name) != names.end() ||
+				std::find(names.begin(), names.end(), device.serial) != names.end();
+			if (names.empty() || named) devices.push_back(device.path);
+		}
+	}
+	if (devices.empty()) {
+		std::fprintf(stderr, "pductl: no PDUs found\n");
+		return 1;
+	}
+
+	k7nvh::Fleet fleet;
+	std::vector<std::unique_ptr<k7nvh::Client>> clients;
+	bool failed = false;
+
+	for (const std::string& device : devices) {
+		auto client = std::make_unique<k7nvh::Client>(device);
+		std::string prefix = devices.size() > 1 ? device + ": " : "";
+		if (!client->open()) {
+			std::fprintf(stderr, "%s: %s\n", device.c_str(), std::strerror(errno));
+			return 1;
+		}
+
+		client->setEventHandler([prefix](const k7nvh::Event& event) {
+			std::printf("%s!%s %d %.3f\n", prefix.c_str(), event.type.c_str(), event.port, event.time);
+			std::fflush(stdout);
+		});
+
+		for (int i = optind; i < argc; i++) {
+			bool queued = client->request(argv[i], [prefix, &failed](const k7nvh::Client::Response& response) {
+				for (const std::string& line : response.lines) std::printf("%s%s\n", prefix.c_str(), line.c_str());
+				if (!response.ok) {
+					std::fprintf(stderr, "%s%s: failed\n", prefix.c_str(), response.command.c_str());
+					failed = true;
+				}
+			});
+			if (!queued) {
+				std::fprintf(stderr, "%s: command too long: %s\n", device.c_str(), argv[i]);
+				return 2;
+			}
+		}
+
+		if (summary) {
+			client->request("PSTATUS", [prefix, &failed](const k7nvh::Client::Response& response) {
+				std::optional<k7nvh::Status> status = k7nvh::parseStatus(response.lines);
+				if (response.ok && status) {
+					printSummary(prefix, *status);
+				} else {
+					std::fprintf(stderr, "%sPSTATUS: unparseable response\n", prefix.c_str());
+					failed = true;
+				}
+			});
+		}
+
+		fleet.add(*client);
+		clients.push_back(std::move(client));
+	}
+
+	if (!fleet.runUntilIdle(timeout)) failed = true;
+	for (const auto& client : clients) {
+		if (!client->error().empty()) std::fprintf(stderr, "%s: %s\n", client->path().c_str(), client->error().c_str());
+	}
+
+	std::fflush(stdout);
+	while (watch && fleet.poll(-1)) {}
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,100 @@
+/* (c) 2017 Nigel Vander Houwen */
+//
+// Compile an automation script, and write it to a PDU. See k7nvh/Script.h for the language.
+//
+//   pduscript [-r] [-b] [-d DEVICE] FILE
+//
+//   -d DEVICE  Write the script to this PDU. Without it, print the SETSCRIPT commands.
+//   -r         Run the script once written
+//   -b         Have the PDU run the script at boot
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "k7nvh/Client.h"
+#include "k7nvh/Fleet.h"
+#include "k7nvh/Script.h"
+
+namespace {
+
+void usage() {
+	std::fprintf(stderr, "usage: pduscript [-r] [-b] [-d DEVICE] FILE\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	std::string device;
+	bool run = false;
+	bool boot = false;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:rb")) != -1) {
+		switch (opt) {
+			case 'd': device = optarg; break;
+			case 'r': run = true; break;
+			case 'b': boot = true; break;
+			default: usage(); return 2;
+		}
+	}
+	if (optind != argc - 1) {
+		usage();
+		return 2;
+	}
+
+	std::ifstream file(argv[optind]);
+	if (!file) {
+		std::fprintf(stderr, "%s: %s\n", argv[optind], std::strerror(errno));
+		return 1;
+	}
+	std::stringstream source;
+	source << file.rdbuf();
+
+	std::string error;
+	std::optional<std::vector<uint8_t>> code = k7nvh::compileScript(source.str(), error);
+	if (!code) {
+		std::fprintf(stderr, "%s: %s\n", argv[optind], error.c_str());
+		return 1;
+	}
+
+	std::vector<std::string> commands = k7nvh::scriptCommands(*code);
+	if (boot) commands.push_back("SCRIPT BOOT ON");
+	if (run) commands.push_back("SCRIPT RUN");
+	if (device.empty()) {
+		for (const std::string& command : commands) std::printf("%s\n", command.c_str());
+		return 0;
+	}
+
+	k7nvh::Client client(device);
+	if (!client.open()) {
+		std::fprintf(stderr, "%s: %s\n", device.c_str(), std::strerror(errno));
+		return 1;
+	}
+
+	bool failed = false;
+	commands.push_back("SCRIPT");
+	for (const std::string& command : commands) {
+		client.request(command, [&failed](const k7nvh::Client::Response& response) {
+			if (!response.ok) {
+				std::fprintf(stderr, "%s: failed\n", response.command.c_str());
+				failed = true;
+			} else if (response.command == "SCRIPT") {
+				for (const std::string& line : response.lines) std::printf("%s\n", line.c_str());
+			}
+		});
+	}
+
+	k7nvh::Fleet fleet;
+	fleet.add(client);
+	if (!fleet.runUntilIdle(30000)) failed = true;
+	if (!client.error().empty()) std::fprintf(stderr, "%s: %s\n", device.c_str(), client.error().c_str());
+	std::printf("%zu bytes\n", code->size());
+
+	return failed ? 1 : 0;
+}